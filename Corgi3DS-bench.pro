@@ -0,0 +1,73 @@
+TEMPLATE = app
+CONFIG += console c++14 thread
+CONFIG -= app_bundle qt
+
+QMAKE_CFLAGS_RELEASE -= -O
+QMAKE_CFLAGS_RELEASE -= -O1
+QMAKE_CFLAGS_RELEASE *= -O2
+QMAKE_CFLAGS_RELEASE -= -O3
+
+SOURCES += src/bench/main.cpp \
+    src/core/emulator.cpp \
+    src/core/cpu/arm.cpp \
+    src/core/cpu/arm_interpret.cpp \
+    src/core/cpu/arm_disasm.cpp \
+    src/core/cpu/cp15.cpp \
+    src/core/cpu/thumb_disasm.cpp \
+    src/core/cpu/thumb_interpret.cpp \
+    src/core/cpu/arm_jit.cpp \
+    src/core/cpu/x64_emitter.cpp \
+    src/core/arm9/rsa.cpp \
+    src/core/timers.cpp \
+    src/core/arm9/dma9.cpp \
+    src/core/pxi.cpp \
+    src/core/arm11/mpcore_pmr.cpp \
+    src/core/arm11/gpu.cpp \
+    src/core/arm9/aes.cpp \
+    src/core/arm9/sha.cpp \
+    src/core/common/bswp.cpp \
+    src/core/common/rotr.cpp \
+    src/core/arm9/aes_lib.c \
+    src/core/arm9/emmc.cpp \
+    src/core/arm9/interrupt9.cpp \
+    src/core/i2c.cpp \
+    src/core/common/exceptions.cpp \
+    src/core/core_thread.cpp \
+    src/core/memmap.cpp \
+    src/core/fastmem.cpp \
+    src/core/mmio.cpp
+
+HEADERS += \
+    src/core/emulator.hpp \
+    src/core/cpu/arm.hpp \
+    src/core/cpu/arm_disasm.hpp \
+    src/core/cpu/arm_interpret.hpp \
+    src/core/cpu/arm_jit.hpp \
+    src/core/cpu/arm_timing.hpp \
+    src/core/cpu/x64_emitter.hpp \
+    src/core/common/rotr.hpp \
+    src/core/cpu/cp15.hpp \
+    src/core/arm9/rsa.hpp \
+    src/core/timers.hpp \
+    src/core/arm9/dma9.hpp \
+    src/core/pxi.hpp \
+    src/core/arm11/mpcore_pmr.hpp \
+    src/core/arm11/gpu.hpp \
+    src/core/arm9/aes.hpp \
+    src/core/arm9/sha.hpp \
+    src/core/common/bswp.hpp \
+    src/core/arm9/aes_lib.hpp \
+    src/core/arm9/aes_lib.h \
+    src/core/arm9/emmc.hpp \
+    src/core/arm9/interrupt9.hpp \
+    src/core/i2c.hpp \
+    src/core/common/common.hpp \
+    src/core/common/exceptions.hpp \
+    src/core/core_thread.hpp \
+    src/core/memmap.hpp \
+    src/core/fastmem.hpp \
+    src/core/mmio.hpp
+
+INCLUDEPATH += /usr/local/include
+
+LIBS += -L/usr/local/lib -lgmpxx -lgmp
@@ -2,7 +2,7 @@ QT += core gui multimedia
 greaterThan(QT_MAJOR_VERSION, 4) : QT += widgets
 
 TEMPLATE = app
-CONFIG += console c++11
+CONFIG += console c++14 thread
 CONFIG -= app_bundle
 
 QMAKE_CFLAGS_RELEASE -= -O
@@ -18,6 +18,8 @@ SOURCES += src/qt/main.cpp \
     src/core/cpu/cp15.cpp \
     src/core/cpu/thumb_disasm.cpp \
     src/core/cpu/thumb_interpret.cpp \
+    src/core/cpu/arm_jit.cpp \
+    src/core/cpu/x64_emitter.cpp \
     src/core/arm9/rsa.cpp \
     src/core/timers.cpp \
     src/core/arm9/dma9.cpp \
@@ -33,13 +35,20 @@ SOURCES += src/qt/main.cpp \
     src/core/arm9/interrupt9.cpp \
     src/qt/emuwindow.cpp \
     src/core/i2c.cpp \
-    src/core/common/exceptions.cpp
+    src/core/common/exceptions.cpp \
+    src/core/core_thread.cpp \
+    src/core/memmap.cpp \
+    src/core/fastmem.cpp \
+    src/core/mmio.cpp
 
 HEADERS += \
     src/core/emulator.hpp \
     src/core/cpu/arm.hpp \
     src/core/cpu/arm_disasm.hpp \
     src/core/cpu/arm_interpret.hpp \
+    src/core/cpu/arm_jit.hpp \
+    src/core/cpu/arm_timing.hpp \
+    src/core/cpu/x64_emitter.hpp \
     src/core/common/rotr.hpp \
     src/core/cpu/cp15.hpp \
     src/core/arm9/rsa.hpp \
@@ -58,7 +67,11 @@ HEADERS += \
     src/qt/emuwindow.hpp \
     src/core/i2c.hpp \
     src/core/common/common.hpp \
-    src/core/common/exceptions.hpp
+    src/core/common/exceptions.hpp \
+    src/core/core_thread.hpp \
+    src/core/memmap.hpp \
+    src/core/fastmem.hpp \
+    src/core/mmio.hpp
 
 INCLUDEPATH += /usr/local/include
 
@@ -0,0 +1,114 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include "../core/emulator.hpp"
+#include "../core/common/exceptions.hpp"
+
+using namespace std;
+
+//Where the programs in roms/ leave their results in ARM9 RAM
+#define RESULT_ADDR 0x08004000
+#define RESULT_SIZE 0x1000
+
+//Runs a boot ROM for a fixed number of frames, several times over, and reports the fastest run along with
+//what the program left in ARM9 RAM, so timings can be compared between builds that behave the same.
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Args: [boot9] [boot11] [--frames=count] [--runs=count] [--interpreter] [--no-fastmem] [--threaded] [--quantum=cycles]\n");
+        return 1;
+    }
+
+    uint8_t boot9_rom[1024 * 64], boot11_rom[1024 * 64], otp_rom[256], cid_rom[16];
+    memset(boot9_rom, 0, sizeof(boot9_rom));
+    memset(boot11_rom, 0, sizeof(boot11_rom));
+    memset(otp_rom, 0, sizeof(otp_rom));
+    memset(cid_rom, 0, sizeof(cid_rom));
+
+    ifstream boot9(argv[1]);
+    if (!boot9.is_open())
+    {
+        printf("Failed to open %s\n", argv[1]);
+        return 1;
+    }
+
+    boot9.read((char*)&boot9_rom, sizeof(boot9_rom));
+
+    boot9.close();
+
+    //Without an ARM11 program, it spins on a branch to itself
+    int first_option = 2;
+    if (argc > 2 && strncmp(argv[2], "--", 2))
+    {
+        ifstream boot11(argv[2]);
+        if (!boot11.is_open())
+        {
+            printf("Failed to open %s\n", argv[2]);
+            return 1;
+        }
+
+        boot11.read((char*)&boot11_rom, sizeof(boot11_rom));
+
+        boot11.close();
+        first_option = 3;
+    }
+    else
+    {
+        uint32_t branch_to_self = 0xEAFFFFFE;
+        memcpy(boot11_rom, &branch_to_self, sizeof(branch_to_self));
+    }
+
+    int frames = 300;
+    int runs = 5;
+    Emulator e;
+    for (int i = first_option; i < argc; i++)
+    {
+        if (!strncmp(argv[i], "--frames=", 9))
+            frames = atoi(argv[i] + 9);
+        else if (!strncmp(argv[i], "--runs=", 7))
+            runs = atoi(argv[i] + 7);
+        else if (!strcmp(argv[i], "--interpreter"))
+            e.set_jit_enabled(false);
+        else if (!strcmp(argv[i], "--no-fastmem"))
+            e.set_fastmem_enabled(false);
+        else if (!strcmp(argv[i], "--threaded"))
+            e.set_threaded(true);
+        else if (!strncmp(argv[i], "--quantum=", 10))
+            e.set_sync_quantum(atoi(argv[i] + 10));
+    }
+
+    e.load_roms(boot9_rom, boot11_rom, otp_rom, cid_rom);
+
+    double best = 0.0;
+    for (int run = 0; run < runs; run++)
+    {
+        e.reset();
+        auto start = chrono::steady_clock::now();
+        try
+        {
+            for (int i = 0; i < frames; i++)
+                e.run();
+        }
+        catch (EmuException::FatalError& error)
+        {
+            e.print_state();
+            printf("Fatal emulation error occurred!\n%s\n", error.what());
+            return 1;
+        }
+        chrono::duration<double, milli> time = chrono::steady_clock::now() - start;
+        if (!run || time.count() < best)
+            best = time.count();
+    }
+
+    uint32_t sum = 0;
+    for (uint32_t addr = RESULT_ADDR; addr < RESULT_ADDR + RESULT_SIZE; addr += 4)
+        sum = sum * 31 + e.arm9_read32(addr);
+
+    printf("%d frames, best of %d runs: %.1f ms\n", frames, runs, best);
+    printf("Result: $%08X $%08X $%08X $%08X, sum $%08X\n", e.arm9_read32(RESULT_ADDR),
+           e.arm9_read32(RESULT_ADDR + 4), e.arm9_read32(RESULT_ADDR + 8), e.arm9_read32(RESULT_ADDR + 12), sum);
+    return 0;
+}
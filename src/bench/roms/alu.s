@@ -0,0 +1,72 @@
+@ ALU-heavy ARM9 loop for timing the data processing handlers. Every ARM operand form (immediate, shift by
+@ immediate, shift by register, RRX) is mixed with flag-setting and conditional ops, followed by a loop of
+@ Thumb format 4 and 5 ALU ops. Registers are stored at $08004000 after each pass.
+.syntax unified
+.arm
+start:
+    ldr r12, =0x08004000
+    ldr r0, =0x12345678
+    ldr r1, =0x9ABCDEF1
+    mov r2, #3
+    mov r3, #0
+    mov r4, #0
+loop:
+    adds r3, r3, r0
+    adcs r4, r4, r1, lsl #3
+    eors r0, r0, r1, ror #7
+    subs r5, r0, r1, lsr #1
+    rsbs r6, r5, r4, asr #5
+    sbcs r6, r6, #0x3F0
+    movs r7, r1, rrx
+    orrs r8, r7, r2, lsl r2
+    bics r9, r8, r0, lsr r2
+    mvns r10, r9, asr r2
+    ands r11, r10, r1, ror r2
+    tst r11, r0, lsl #1
+    teq r11, r1, lsr #32
+    cmp r3, r4
+    cmn r5, r6, asr #32
+    addcs r3, r3, #1
+    subcc r4, r4, #1
+    add r1, r1, r11
+    add r0, r0, r9
+    eor r2, r8, r10
+    and r2, r2, #15
+    add r2, r2, #1
+    stmia r12, {r0-r11}
+    adr r7, thumb_part + 1
+    bx r7
+.thumb
+thumb_part:
+    movs r7, #64
+tloop:
+    ands r0, r1
+    eors r1, r3
+    lsls r3, r2
+    lsrs r4, r2
+    asrs r5, r2
+    adcs r6, r0
+    sbcs r0, r4
+    rors r1, r2
+    tst r5, r6
+    negs r3, r3
+    cmp r4, r5
+    cmn r0, r1
+    orrs r5, r0
+    muls r6, r1
+    bics r4, r3
+    mvns r3, r4
+    add r8, r0
+    mov r9, r8
+    cmp r9, r1
+    add r1, r9
+    subs r7, #1
+    bne tloop
+    ldr r7, =0x08004030
+    stmia r7!, {r0-r6}
+    .align 2
+    bx pc
+    nop
+.arm
+    b loop
+.ltorg
@@ -0,0 +1,187 @@
+@ Checks LDM/STM, PUSH/POP and Thumb LDMIA/STMIA against the per-word path they bypass when a range is plain
+@ RAM. Covers transfers spanning a page, straddling the end of ITCM and wrapping its mirror, writeback with
+@ the base in the list, the S bit (user bank and exception return) and PC loads that switch between ARM and
+@ Thumb. When done, $08004000 holds the number of failed checks, $08004004 the first one that failed and
+@ $08004008 is $600DF00D.
+.syntax unified
+.arm
+
+.equ RESULT, 0x08004000
+.equ DATA, 0x08006000
+
+@ Registers r10-r12 are reserved for this. The return address is taken by hand, as BL needs linking.
+.macro check reg, value, id
+    ldr r12, =\value
+    cmp \reg, r12
+    movne r10, #\id
+    addne r11, pc, #0
+    bne fail
+.endm
+
+start:
+    ldr sp, =0x08010000
+    ldr r12, =RESULT
+    mov r0, #0
+    str r0, [r12]
+    str r0, [r12, #4]
+    str r0, [r12, #8]
+
+    ldr r0, =0x11111111
+    ldr r1, =0x22222222
+    ldr r2, =0x33333333
+    ldr r3, =0x44444444
+
+    @ Spanning a page, in each direction
+    ldr r8, =0x08000FF8
+    stmia r8, {r0-r3}
+    ldmia r8, {r4-r7}
+    check r4, 0x11111111, 1
+    check r7, 0x44444444, 2
+    ldr r4, [r8, #12]
+    check r4, 0x44444444, 3
+    ldr r8, =0x08002008
+    stmdb r8!, {r0-r3}
+    check r8, 0x08001FF8, 4
+    ldr r4, [r8]
+    check r4, 0x11111111, 5
+    ldmib r8!, {r4-r6}
+    check r4, 0x22222222, 6
+    check r6, 0x44444444, 7
+    check r8, 0x08002004, 8
+    ldr r8, =0x08003004
+    ldmda r8!, {r4-r7}
+    check r8, 0x08002FF4, 9
+
+    @ Straddling the end of ITCM into ARM9 RAM, then wrapping the ITCM mirror
+    ldr r8, =0x07FFFFF8
+    stmia r8, {r0-r3}
+    ldmia r8, {r4-r7}
+    check r4, 0x11111111, 10
+    check r6, 0x33333333, 11
+    ldr r9, =0x08000000
+    ldr r4, [r9]
+    check r4, 0x33333333, 12
+    ldr r9, =0x00007FF8
+    ldr r4, [r9]
+    check r4, 0x11111111, 13
+    stmia r9, {r0-r3}
+    mov r9, #0
+    ldr r4, [r9]
+    check r4, 0x33333333, 14
+    ldr r9, =0x00007FF8
+    ldmia r9, {r4-r7}
+    check r5, 0x22222222, 15
+    check r7, 0x44444444, 16
+
+    @ Writeback with the base in the list: a loaded base wins, and a stored one is its old value
+    ldr r8, =DATA
+    stmia r8, {r0-r3}
+    ldmia r8!, {r7, r8, r9}
+    check r8, 0x22222222, 17
+    ldr r8, =DATA
+    ldmia r8!, {r8, r9}
+    check r8, 0x11111111, 18
+    ldr r8, =DATA
+    stmia r8!, {r8, r9}
+    check r8, DATA + 8, 19
+    ldr r4, =DATA
+    ldr r4, [r4]
+    check r4, DATA, 20
+
+    @ S bit without the PC: the user bank's SP and LR
+    msr cpsr_c, #0xDF
+    ldr sp, =0xAAAA0000
+    ldr lr, =0xBBBB0000
+    msr cpsr_c, #0xD3
+    ldr r8, =DATA
+    stmia r8, {sp, lr}^
+    ldr r4, [r8]
+    check r4, 0xAAAA0000, 21
+    ldr r4, [r8, #4]
+    check r4, 0xBBBB0000, 22
+    mov r4, sp
+    check r4, 0x08010000, 23
+    ldr r4, =0xCCCC0000
+    ldr r5, =0xDDDD0000
+    stmia r8, {r4, r5}
+    ldmia r8, {sp, lr}^
+    mov r4, sp
+    check r4, 0x08010000, 24
+    msr cpsr_c, #0xDF
+    mov r4, sp
+    mov r5, lr
+    msr cpsr_c, #0xD3
+    check r4, 0xCCCC0000, 25
+    check r5, 0xDDDD0000, 26
+
+    @ S bit with the PC: an exception return restores CPSR from SPSR
+    ldr r4, =0x600000D3
+    msr spsr_fsxc, r4
+    adr r4, returned
+    push {r4}
+    movs r4, #1
+    ldmia sp!, {pc}^
+returned:
+    mrs r4, cpsr
+    check r4, 0x600000D3, 27
+    mov r4, sp
+    check r4, 0x08010000, 28
+
+    @ Popping a Thumb address switches to Thumb, and a Thumb POP of an ARM address switches back.
+    @ The stack straddles a page on the way.
+    ldr sp, =0x08003004
+    adr r4, thumb_part + 1
+    push {r4}
+    adr lr, back_to_arm
+    pop {pc}
+.thumb
+.align 2
+thumb_part:
+    push {lr}
+    ldr r0, =0x08000FFC
+    movs r1, #1
+    movs r2, #2
+    movs r3, #3
+    stmia r0!, {r1-r3}
+    subs r0, #12
+    ldmia r0!, {r4-r6}
+    push {r4-r6}
+    movs r1, #0
+    movs r3, #0
+    pop {r1-r3}
+    pop {pc}
+.ltorg
+
+.arm
+.align 2
+back_to_arm:
+    mov r7, sp
+    ldr sp, =0x08010000
+    check r7, 0x08003004, 29
+    check r1, 1, 30
+    check r3, 3, 31
+    check r4, 1, 32
+    check r6, 3, 33
+    ldr r8, =0x08001004
+    ldr r4, [r8]
+    check r4, 3, 34
+
+    ldr r12, =RESULT
+    ldr r0, =0x600DF00D
+    str r0, [r12, #8]
+done:
+    b done
+
+@ r10 is the failed check and r11 the return address
+fail:
+    push {r0, r1}
+    ldr r12, =RESULT
+    ldr r0, [r12]
+    add r0, r0, #1
+    str r0, [r12]
+    ldr r1, [r12, #4]
+    cmp r1, #0
+    streq r10, [r12, #4]
+    pop {r0, r1}
+    bx r11
+.ltorg
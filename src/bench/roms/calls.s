@@ -0,0 +1,70 @@
+@ Call-heavy ARM9 loop for timing block transfers: LDM/STM in every addressing mode, PUSH/POP around an ARM
+@ call and a Thumb one, and Thumb LDMIA/STMIA. Registers are stored at $08004000 and $080040F0 after each pass.
+.syntax unified
+.arm
+start:
+    ldr sp, =0x08008000
+    ldr r12, =0x08004000
+    mov r11, #0
+outer:
+    mov r0, #1
+    mov r1, #2
+    add r2, r11, #3
+    mov r3, #4
+    mov r4, #5
+    mov r5, #6
+    add r6, r11, r11
+    mov r7, #8
+    mov r8, r12
+    stmia r8!, {r0-r7}
+    stmib r8!, {r0, r2, r4, r6}
+    stmda r8!, {r1, r3, r5, r7}
+    stmdb r8!, {r0-r3}
+    stmdb r8, {r4-r7, r11}
+    ldmia r8, {r0-r3}
+    ldmib r8!, {r4-r7}
+    ldmda r8!, {r0, r2}
+    ldmdb r8!, {r1, r3}
+    add r11, r11, r0
+    add r11, r11, r7
+    ldmia r12, {r0-r7}
+    push {r0-r7, lr}
+    .word 0xEB000008 @ bl func, encoded by hand as BL needs linking
+    pop {r0-r7, lr}
+    add r11, r11, r9
+    adr r10, thumb_code + 1
+    mov lr, pc
+    bx r10
+    add r11, r11, r9
+    ldr r10, =0x080040F0
+    stmia r10, {r0-r11}
+    b outer
+func:
+    push {r4-r6, lr}
+    mov r4, #0x10
+    add r9, r4, r0
+    adr r5, ret_pc
+    str r5, [sp, #-4]!
+    ldmia sp!, {pc}
+ret_pc:
+    pop {r4-r6, pc}
+.thumb
+.align 2
+thumb_code:
+    push {r4-r7, lr}
+    movs r4, #9
+    movs r5, #10
+    push {r4, r5}
+    pop {r6, r7}
+    adds r4, r6, r7
+    ldr r0, =0x08004100
+    stmia r0!, {r4-r7}
+    subs r0, #16
+    ldmia r0!, {r1, r2, r3}
+    adds r1, r2
+    adds r1, r3
+    mov r9, r1
+    pop {r4-r7}
+    pop {r0}
+    bx r0
+.ltorg
@@ -2,26 +2,23 @@
 #include <cstring>
 #include "gpu.hpp"
 #include "../common/common.hpp"
+#include "../mmio.hpp"
 
-GPU::GPU()
+//VRAM belongs to the emulator's guest memory, so the buses can map it directly
+GPU::GPU(uint8_t* vram, Shared_Memory* memory) : vram(vram), memory(memory)
 {
-    vram = nullptr;
     top_screen = nullptr;
     bottom_screen = nullptr;
 }
 
 GPU::~GPU()
 {
-    delete[] vram;
     delete[] top_screen;
     delete[] bottom_screen;
 }
 
 void GPU::reset()
 {
-    if (!vram)
-        vram = new uint8_t[0x00600000];
-
     if (!top_screen)
         top_screen = new uint8_t[240 * 400 * 4];
 
@@ -34,6 +31,12 @@ void GPU::reset()
     memset(bottom_screen, 0, 240 * 320 * 4);
 }
 
+void GPU::register_mmio(MMIO_Bus& bus)
+{
+    bus.on_read<uint32_t>(0x10400000, 0x2000, [this](uint32_t addr) { return read32(addr); });
+    bus.on_write<uint32_t>(0x10400000, 0x2000, [this](uint32_t addr, uint32_t value) { write32(addr, value); });
+}
+
 void GPU::render_frame()
 {
     for (int y = 0; y < 400; y++)
@@ -208,6 +211,11 @@ void GPU::write32_fb(int index, uint32_t addr, uint32_t value)
     }
 }
 
+uint8_t* GPU::get_vram()
+{
+    return vram;
+}
+
 uint8_t* GPU::get_top_buffer()
 {
     return top_screen;
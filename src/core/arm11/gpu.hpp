@@ -1,6 +1,7 @@
 #ifndef GPU_HPP
 #define GPU_HPP
 #include <cstdint>
+#include "../fastmem.hpp"
 
 struct FrameBuffer
 {
@@ -21,11 +22,16 @@ struct MemoryFill
     bool finished;
 };
 
+class MMIO_Bus;
+
 class GPU
 {
     private:
         uint8_t* vram;
 
+        //The guest memory vram lives in, to mark what fills write
+        Shared_Memory* memory;
+
         uint8_t* top_screen, *bottom_screen;
 
         FrameBuffer framebuffers[2];
@@ -37,10 +43,11 @@ class GPU
 
         void render_fb_pixel(uint8_t* screen, int fb_index, int x, int y);
     public:
-        GPU();
+        GPU(uint8_t* vram, Shared_Memory* memory);
         ~GPU();
 
         void reset();
+        void register_mmio(MMIO_Bus& bus);
         void render_frame();
 
         template <typename T> T read_vram(uint32_t addr);
@@ -49,6 +56,7 @@ class GPU
         uint32_t read32(uint32_t addr);
         void write32(uint32_t addr, uint32_t value);
 
+        uint8_t* get_vram();
         uint8_t* get_top_buffer();
         uint8_t* get_bottom_buffer();
 };
@@ -62,7 +70,10 @@ inline T GPU::read_vram(uint32_t addr)
 template <typename T>
 inline void GPU::write_vram(uint32_t addr, T value)
 {
-    *(T*)&vram[addr % 0x00600000] = value;
+    uint8_t* ptr = &vram[addr % 0x00600000];
+    *(T*)ptr = value;
+    memory->mark_dirty(ptr);
+    memory->mark_dirty(ptr + sizeof(T) - 1);
 }
 
 #endif // GPU_HPP
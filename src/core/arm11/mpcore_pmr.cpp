@@ -1,5 +1,6 @@
 #include <cstdio>
 #include "../cpu/arm.hpp"
+#include "../mmio.hpp"
 #include "mpcore_pmr.hpp"
 
 MPCore_PMR::MPCore_PMR(ARM_CPU* appcore) : appcore(appcore)
@@ -13,6 +14,15 @@ void MPCore_PMR::reset()
     irq_cause = 0x3FF;
 }
 
+void MPCore_PMR::register_mmio(MMIO_Bus& bus)
+{
+    bus.on_read<uint8_t>(0x17E00000, 0x2000, [this](uint32_t addr) { return read8(addr); });
+    bus.on_read<uint32_t>(0x17E00000, 0x2000, [this](uint32_t addr) { return read32(addr); });
+    bus.on_write<uint8_t>(0x17E00000, 0x2000, [this](uint32_t addr, uint32_t value) { write8(addr, value); });
+    bus.on_write<uint16_t>(0x17E00000, 0x2000, [this](uint32_t addr, uint32_t value) { write16(addr, value); });
+    bus.on_write<uint32_t>(0x17E00000, 0x2000, [this](uint32_t addr, uint32_t value) { write32(addr, value); });
+}
+
 void MPCore_PMR::assert_hw_irq(int id)
 {
     int index = id / 32;
@@ -3,6 +3,7 @@
 #include <cstdint>
 
 class ARM_CPU;
+class MMIO_Bus;
 
 class MPCore_PMR
 {
@@ -16,6 +17,7 @@ class MPCore_PMR
         MPCore_PMR(ARM_CPU* appcore);
 
         void reset();
+        void register_mmio(MMIO_Bus& bus);
         void assert_hw_irq(int id);
 
         uint8_t read8(uint32_t addr);
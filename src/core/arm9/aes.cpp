@@ -2,6 +2,7 @@
 #include <cstring>
 #include "aes.hpp"
 #include "../common/common.hpp"
+#include "../mmio.hpp"
 
 const static uint8_t key_const[] = {0x1F, 0xF9, 0xE9, 0xAA, 0xC5, 0xFE, 0x04, 0x08, 0x02, 0x45,
                                      0x91, 0xDC, 0x5D, 0x52, 0x76, 0x8A};
@@ -98,6 +99,16 @@ void AES::reset()
     AES_init_ctx(&lib_aes_ctx, (uint8_t*)keys[0x3F].normal);
 }
 
+void AES::register_mmio(MMIO_Bus& bus)
+{
+    bus.on_read<uint8_t>(0x10009011, 1, [this](uint32_t) { return read_keycnt(); });
+    bus.on_read<uint32_t>(0x10009000, 0x1000, [this](uint32_t addr) { return read32(addr); });
+    bus.on_write<uint8_t>(0x10009010, 1, [this](uint32_t, uint32_t value) { write_keysel(value); });
+    bus.on_write<uint8_t>(0x10009011, 1, [this](uint32_t, uint32_t value) { write_keycnt(value); });
+    bus.on_write<uint16_t>(0x10009006, 2, [this](uint32_t, uint32_t value) { write_block_count(value); });
+    bus.on_write<uint32_t>(0x10009000, 0x1000, [this](uint32_t addr, uint32_t value) { write32(addr, value); });
+}
+
 void AES::gen_normal_key(int slot)
 {
     uint8_t normal[16];
@@ -27,6 +27,8 @@ struct AES_KeySlot
     uint8_t y[16];
 };
 
+class MMIO_Bus;
+
 class AES
 {
     private:
@@ -70,6 +72,7 @@ class AES
         AES();
 
         void reset();
+        void register_mmio(MMIO_Bus& bus);
         void write_input_fifo(uint32_t value);
 
         uint8_t read_keycnt();
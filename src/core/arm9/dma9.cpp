@@ -3,6 +3,7 @@
 #include "dma9.hpp"
 #include "../common/common.hpp"
 #include "../emulator.hpp"
+#include "../mmio.hpp"
 
 DMA9::DMA9(Emulator* e) : e(e)
 {
@@ -19,6 +20,14 @@ void DMA9::reset()
     xdma_params_needed = 0;
 }
 
+void DMA9::register_mmio(MMIO_Bus& bus)
+{
+    bus.on_read<uint32_t>(0x10002000, 0x1000, [this](uint32_t addr) { return read32_ndma(addr); });
+    bus.on_read<uint32_t>(0x1000C000, 0x1000, [this](uint32_t addr) { return read32_xdma(addr); });
+    bus.on_write<uint32_t>(0x10002000, 0x1000, [this](uint32_t addr, uint32_t value) { write32_ndma(addr, value); });
+    bus.on_write<uint32_t>(0x1000C000, 0x1000, [this](uint32_t addr, uint32_t value) { write32_xdma(addr, value); });
+}
+
 void DMA9::run_xdma()
 {
     //TODO: can the DMA manager thread run on its own? This code assumes it can't
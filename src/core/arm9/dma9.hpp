@@ -34,6 +34,7 @@ struct XDMA_Chan
 };
 
 class Emulator;
+class MMIO_Bus;
 
 class DMA9
 {
@@ -63,6 +64,7 @@ class DMA9
         DMA9(Emulator* e);
 
         void reset();
+        void register_mmio(MMIO_Bus& bus);
         void run_xdma();
 
         uint32_t read32_ndma(uint32_t addr);
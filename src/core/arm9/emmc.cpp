@@ -3,6 +3,7 @@
 #include "../common/common.hpp"
 #include "emmc.hpp"
 #include "interrupt9.hpp"
+#include "../mmio.hpp"
 
 #define ISTAT_CMDEND 0x1
 #define ISTAT_DATAEND 0x4
@@ -54,6 +55,14 @@ void EMMC::reset()
     *(uint32_t*)&regscr[1] = 0x012a0000;
 }
 
+void EMMC::register_mmio(MMIO_Bus& bus)
+{
+    bus.on_read<uint16_t>(0x10006000, 0x1000, [this](uint32_t addr) { return read16(addr); });
+    bus.on_read<uint32_t>(0x10006000, 0x1000, [this](uint32_t addr) { return read32(addr); });
+    bus.on_write<uint16_t>(0x10006000, 0x1000, [this](uint32_t addr, uint32_t value) { write16(addr, value); });
+    bus.on_write<uint32_t>(0x10006000, 0x1000, [this](uint32_t addr, uint32_t value) { write32(addr, value); });
+}
+
 bool EMMC::mount_nand(std::string file_name)
 {
     nand.open(file_name, std::ios::binary | std::ios::in | std::ios::out);
@@ -4,6 +4,7 @@
 #include <fstream>
 
 class Interrupt9;
+class MMIO_Bus;
 
 struct SD_DATA32_IRQ
 {
@@ -93,6 +94,7 @@ class EMMC
         bool mount_sd(std::string file_name);
         void load_cid(uint8_t* cid);
         void reset();
+        void register_mmio(MMIO_Bus& bus);
 
         uint16_t read16(uint32_t addr);
         uint32_t read32(uint32_t addr);
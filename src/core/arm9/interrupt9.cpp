@@ -1,5 +1,6 @@
 #include <cstdio>
 #include "../cpu/arm.hpp"
+#include "../mmio.hpp"
 #include "interrupt9.hpp"
 
 Interrupt9::Interrupt9(ARM_CPU* arm9) : arm9(arm9)
@@ -7,6 +8,18 @@ Interrupt9::Interrupt9(ARM_CPU* arm9) : arm9(arm9)
 
 }
 
+void Interrupt9::register_mmio(MMIO_Bus& bus)
+{
+    bus.on_read<uint32_t>(0x10001000, 4, [this](uint32_t) { return read_ie(); });
+    bus.on_read<uint32_t>(0x10001004, 4, [this](uint32_t) { return read_if(); });
+    bus.on_write<uint32_t>(0x10001000, 4, [this](uint32_t, uint32_t value)
+    {
+        printf("[ARM9] Set IE: $%08X\n", value);
+        write_ie(value);
+    });
+    bus.on_write<uint32_t>(0x10001004, 4, [this](uint32_t, uint32_t value) { write_if(value); });
+}
+
 uint32_t Interrupt9::read_ie()
 {
     return IE;
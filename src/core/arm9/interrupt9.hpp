@@ -3,6 +3,7 @@
 #include <cstdint>
 
 class ARM_CPU;
+class MMIO_Bus;
 
 class Interrupt9
 {
@@ -11,6 +12,7 @@ class Interrupt9
         uint32_t IE, IF;
     public:
         Interrupt9(ARM_CPU* arm9);
+        void register_mmio(MMIO_Bus& bus);
 
         uint32_t read_ie();
         uint32_t read_if();
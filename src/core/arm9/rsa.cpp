@@ -2,6 +2,7 @@
 #include <cstring>
 #include <sstream>
 #include "../common/common.hpp"
+#include "../mmio.hpp"
 #include "rsa.hpp"
 
 RSA::RSA()
@@ -14,6 +15,14 @@ void RSA::reset()
     memset(keys, 0, sizeof(keys));
 }
 
+void RSA::register_mmio(MMIO_Bus& bus)
+{
+    bus.on_read<uint8_t>(0x1000B000, 0x1000, [this](uint32_t addr) { return read8(addr); });
+    bus.on_read<uint32_t>(0x1000B000, 0x1000, [this](uint32_t addr) { return read32(addr); });
+    bus.on_write<uint8_t>(0x1000B000, 0x1000, [this](uint32_t addr, uint32_t value) { write8(addr, value); });
+    bus.on_write<uint32_t>(0x1000B000, 0x1000, [this](uint32_t addr, uint32_t value) { write32(addr, value); });
+}
+
 uint8_t RSA::read8(uint32_t addr)
 {
     if (addr >= 0x1000B800 && addr < 0x1000B900)
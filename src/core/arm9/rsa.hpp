@@ -22,6 +22,8 @@ struct RSA_KeySlot
     int exp_ctr, mod_ctr;
 };
 
+class MMIO_Bus;
+
 class RSA
 {
     private:
@@ -38,6 +40,7 @@ class RSA
         RSA();
 
         void reset();
+        void register_mmio(MMIO_Bus& bus);
 
         uint8_t read8(uint32_t addr);
         uint32_t read32(uint32_t addr);
@@ -1,6 +1,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include "../common/common.hpp"
+#include "../mmio.hpp"
 #include "sha.hpp"
 
 const static uint32_t k_1[4] =
@@ -32,6 +33,13 @@ void SHA::reset()
     message_len = 0;
 }
 
+void SHA::register_mmio(MMIO_Bus& bus)
+{
+    bus.on_read<uint8_t>(0x1000A040, 0x40, [this](uint32_t addr) { return read_hash(addr); });
+    bus.on_read<uint32_t>(0x1000A000, 0x1000, [this](uint32_t addr) { return read32(addr); });
+    bus.on_write<uint32_t>(0x1000A000, 0x1000, [this](uint32_t addr, uint32_t value) { write32(addr, value); });
+}
+
 void SHA::reset_hash()
 {
     switch (SHA_CNT.mode)
@@ -14,6 +14,8 @@ struct SHA_CNT_REG
     bool irq1_enable;
 };
 
+class MMIO_Bus;
+
 class SHA
 {
     private:
@@ -39,6 +41,7 @@ class SHA
         SHA();
 
         void reset();
+        void register_mmio(MMIO_Bus& bus);
 
         uint8_t read_hash(uint32_t addr);
         uint32_t read32(uint32_t addr);
@@ -0,0 +1,75 @@
+#include "core_thread.hpp"
+#include "cpu/arm.hpp"
+
+//Yields before falling back to the condition variables
+#define CORE_THREAD_SPINS 20000
+
+Core_Thread::Core_Thread(ARM_CPU* cpu) : cpu(cpu), slice(0), quitting(false)
+{
+    thread = std::thread(&Core_Thread::loop, this);
+}
+
+Core_Thread::~Core_Thread()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quitting = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void Core_Thread::start(int cycles)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    slice = cycles;
+    wake.notify_one();
+}
+
+//Returns once the slice is over, rethrowing anything the core threw, such as a fatal error or a reboot
+void Core_Thread::wait()
+{
+    for (int i = 0; i < CORE_THREAD_SPINS && slice; i++)
+        std::this_thread::yield();
+
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [this] { return !slice; });
+    if (error)
+    {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+//Returns 0 when the thread should exit
+int Core_Thread::wait_for_slice()
+{
+    for (int i = 0; i < CORE_THREAD_SPINS && !slice && !quitting; i++)
+        std::this_thread::yield();
+
+    std::unique_lock<std::mutex> guard(lock);
+    wake.wait(guard, [this] { return slice || quitting; });
+    return quitting ? 0 : slice.load();
+}
+
+void Core_Thread::loop()
+{
+    while (int cycles = wait_for_slice())
+    {
+        try
+        {
+            cpu->run(cycles);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            slice = 0;
+        }
+        done.notify_one();
+    }
+}
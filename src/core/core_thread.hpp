@@ -0,0 +1,40 @@
+#ifndef CORE_THREAD_HPP
+#define CORE_THREAD_HPP
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+class ARM_CPU;
+
+//Runs a CPU on its own host thread, one slice at a time. Nothing the core may touch outside the bus lock
+//is safe to use between start() and the matching wait().
+class Core_Thread
+{
+    private:
+        ARM_CPU* cpu;
+        std::thread thread;
+
+        //Both sides spin briefly before sleeping on these, as slices are usually over within microseconds
+        std::mutex lock;
+        std::condition_variable wake, done;
+
+        //Cycles of the slice being run, or 0 when the thread is waiting for one
+        std::atomic<int> slice;
+        std::atomic<bool> quitting;
+
+        //Thrown by the core during the last slice, passed on to whoever waits for it
+        std::exception_ptr error;
+
+        int wait_for_slice();
+        void loop();
+    public:
+        Core_Thread(ARM_CPU* cpu);
+        ~Core_Thread();
+
+        void start(int cycles);
+        void wait();
+};
+
+#endif // CORE_THREAD_HPP
@@ -1,17 +1,18 @@
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 #include "arm.hpp"
 #include "arm_disasm.hpp"
 #include "arm_interpret.hpp"
 #include "../common/common.hpp"
 #include "../emulator.hpp"
+#include "../memmap.hpp"
 
 uint32_t PSR_Flags::get()
 {
+    resolve_flags();
     uint32_t reg = 0;
-    reg |= negative << 31;
-    reg |= zero << 30;
-    reg |= carry << 29;
-    reg |= overflow << 28;
+    reg |= nzcv << 28;
     reg |= q_overflow << 27;
 
     reg |= irq_disable << 7;
@@ -24,10 +25,7 @@ uint32_t PSR_Flags::get()
 
 void PSR_Flags::set(uint32_t value)
 {
-    negative = value & (1 << 31);
-    zero = value & (1 << 30);
-    carry = value & (1 << 29);
-    overflow = value & (1 << 28);
+    nzcv = value >> 28;
     q_overflow = value & (1 << 27);
 
     irq_disable = value & (1 << 7);
@@ -35,11 +33,69 @@ void PSR_Flags::set(uint32_t value)
     thumb = value & (1 << 5);
 
     mode = (PSR_MODE)(value & 0x1F);
+    flag_op = FLAGS_READY;
+}
+
+//Carry and overflow code here from melonDS's ALU core (my original implementation was incorrect in many ways)
+void PSR_Flags::compute_flags()
+{
+    uint8_t flags = (flag_result >> 28) & NZCV_N;
+    if (!flag_result)
+        flags |= NZCV_Z;
+    if (flag_op == FLAGS_ADD)
+    {
+        if (CARRY_ADD(flag_a, flag_b))
+            flags |= NZCV_C;
+        if (ADD_OVERFLOW(flag_a, flag_b, flag_result))
+            flags |= NZCV_V;
+    }
+    else if (flag_op == FLAGS_SUB)
+    {
+        if (CARRY_SUB(flag_a, flag_b))
+            flags |= NZCV_C;
+        if (SUB_OVERFLOW(flag_a, flag_b, flag_result))
+            flags |= NZCV_V;
+    }
+    else
+        flags |= nzcv & (NZCV_C | NZCV_V);
+    nzcv = flags;
+    flag_op = FLAGS_READY;
 }
 
 ARM_CPU::ARM_CPU(Emulator* e, int id, CP15* cp15) : e(e), id(id), cp15(cp15)
 {
+    blocks = nullptr;
+    code_pages = nullptr;
+    other_core = nullptr;
+    clean_pages = nullptr;
+    jit = nullptr;
+    fast_ram.mem = nullptr;
+    fastmem = nullptr;
+    map = nullptr;
+    bus_map = nullptr;
+    tcm_map = nullptr;
+    mpu_pages = nullptr;
+    mpu_user_pages = nullptr;
+    mpu_allows_bus = true;
+    itcm_size = 0;
+    dtcm_base = 0;
+    dtcm_size = 0;
+    mmu_enabled = false;
+    tlb = nullptr;
+    deferred_cycles = 0;
+    threaded = false;
+    cycle_table = (id == 9) ? &ARM_Timing::arm9_cycle_table : &ARM_Timing::arm11_cycle_table;
+    set_tracing(false);
+}
 
+ARM_CPU::~ARM_CPU()
+{
+    delete[] blocks;
+    delete[] code_pages;
+    delete[] clean_pages;
+    delete[] tlb;
+    delete jit;
+    delete tcm_map;
 }
 
 std::string ARM_CPU::get_reg_name(int id)
@@ -73,7 +129,28 @@ std::string ARM_CPU::get_reg_name(int id)
 
 void ARM_CPU::reset()
 {
+    if (!blocks)
+        blocks = new ARM_Block[ARM_BLOCK_ENTRIES];
+    if (!code_pages)
+        code_pages = new uint8_t[(1 << 20) / 8];
+    if (!clean_pages)
+        clean_pages = new uint8_t[(1 << 20) / 8];
+    reset_clean_pages();
+    if (!tlb)
+        tlb = new ARM_TLB_Entry[ARM_TLB_ENTRIES];
+    mmu_enabled = false;
+    flush_tlb();
+    flush_code_cache();
+
+    //Saved PSRs are copied into CPSR as they are, so they never hold a pending flag op
+    for (int i = 0; i < 0x20; i++)
+        SPSR[i].flag_op = FLAGS_READY;
+
+    halted = false;
+    int_pending = false;
+
     CPSR.mode = PSR_SUPERVISOR;
+    CPSR.flag_op = FLAGS_READY;
     CPSR.fiq_disable = true;
     CPSR.irq_disable = true;
     if (id == 9)
@@ -81,35 +158,1125 @@ void ARM_CPU::reset()
     else
         jp(0x0, true);
 
-    can_disassemble = false;
+    set_tracing(false);
+    deferred_cycles = 0;
+    cycles_left = 0;
+    cycle_count = 0;
+    spinning = false;
+    idle = false;
 }
 
-void ARM_CPU::run()
+void ARM_CPU::run(int cycles)
 {
-    if (halted)
-        return;
+    //Blocks are never interrupted, so any overrun is paid back in the next slice
+    cycles_left += cycles;
+    int slice = cycles_left;
+    idle = false;
+    (this->*run_slice)();
+
+    //A trace trigger cut the untraced loop short, so finish the slice on the traced one
+    if (deferred_cycles)
+    {
+        cycles_left += deferred_cycles;
+        deferred_cycles = 0;
+        (this->*run_slice)();
+    }
+    cycle_count += slice - cycles_left;
+}
+
+template <bool trace>
+void ARM_CPU::run_cycles()
+{
+    while (cycles_left > 0)
+    {
+        if (halted)
+        {
+            cycles_left = 0;
+            idle = true;
+            return;
+        }
+
+        try
+        {
+            if (trace)
+                cycles_left -= step();
+            else if (jit)
+                jit->run();
+            else
+                cycles_left -= run_block();
+        }
+        catch (ARM_Abort&)
+        {
+            //The rest of the aborted block never runs, so only the exception entry is paid for here
+            cycles_left -= 3;
+        }
+
+        if (spinning)
+        {
+            spinning = false;
+            cycles_left = 0;
+            idle = true;
+        }
+
+        //Blocks end at anything that can unmask interrupts, so checking here is enough
+        if (int_pending)
+            int_check();
+    }
+}
+
+int ARM_CPU::run_block()
+{
+    bool thumb = CPSR.thumb;
+    uint32_t addr = gpr[15] - (thumb ? 2 : 4);
+    ARM_Block* block = get_block(addr, thumb);
+    if (block->privileged && CPSR.mode == PSR_USER)
+        prefetch_abort(addr);
+
+    code_written = false;
+    ARM_Predecoded* end = block->instrs + block->length;
+    if (thumb)
+        end = run_thumb_instrs(block->instrs, end);
+    else
+        end = run_arm_instrs(block->instrs, end);
+
+    if (block->idle_loop && gpr[15] == addr + (thumb ? 2 : 4) && !code_written)
+        spinning = true;
+    return block->cycles[end - block->instrs];
+}
+
+//With GCC and Clang, the block loops below are threaded with computed goto: each common instruction kind
+//gets its own copy of the dispatch jump, so the predictor can learn what tends to follow it.
+//Other compilers get a switch over the same kinds. Either way, rarer kinds go through the predecoded handler.
+#if defined(__GNUC__)
+#define BLOCK_OP(kind) op_##kind:
+#define BLOCK_OP_GENERIC op_generic:
+#define BLOCK_OP_END(next) next
+#else
+#define BLOCK_OP(kind) case kind:
+#define BLOCK_OP_GENERIC default:
+#define BLOCK_OP_END(next) break;
+#endif
+
+//Stop if the instruction branched, took an interrupt or overwrote cached code
+#define BLOCK_STOP(instr, end) (gpr[15] != next_pc || code_written || instr == end)
+
+#define ARM_ENTER() \
+    gpr[15] += 4; \
+    next_pc = gpr[15]; \
+    if (!meets_condition(instr->cond)) \
+        goto skipped; \
+    goto *arm_ops[instr->dispatch];
+
+#define ARM_NEXT() \
+    instr++; \
+    if (BLOCK_STOP(instr, end)) \
+        return instr; \
+    ARM_ENTER()
+
+//Returns the entry after the last one executed
+ARM_Predecoded* ARM_CPU::run_arm_instrs(ARM_Predecoded* instr, ARM_Predecoded* end)
+{
+    using namespace ARM_Interpreter;
+    uint32_t next_pc;
+
+#if defined(__GNUC__)
+    static void* const arm_ops[] =
+    {
+        &&op_generic, &&op_ARM_B, &&op_ARM_BL, &&op_ARM_BX,
+        &&op_generic, &&op_generic, &&op_generic, &&op_generic,
+        &&op_ARM_DATA_PROCESSING, &&op_ARM_MULTIPLY, &&op_generic, &&op_generic,
+        &&op_generic, &&op_ARM_LOAD_HALFWORD, &&op_ARM_STORE_HALFWORD, &&op_generic,
+        &&op_generic, &&op_generic, &&op_generic,
+        &&op_ARM_STORE_WORD, &&op_ARM_LOAD_WORD, &&op_ARM_STORE_BYTE, &&op_ARM_LOAD_BYTE,
+        &&op_ARM_STORE_BLOCK, &&op_ARM_LOAD_BLOCK,
+        &&op_generic, &&op_generic, &&op_generic, &&op_generic, &&op_generic, &&op_generic
+    };
+    static_assert(sizeof(arm_ops) / sizeof(arm_ops[0]) == ARM_RFE + 1, "ARM dispatch table doesn't cover every kind");
+
+    ARM_ENTER();
+skipped:
+    ARM_NEXT();
+#else
+    while (true)
+    {
+        gpr[15] += 4;
+        next_pc = gpr[15];
+        if (meets_condition(instr->cond))
+        {
+            switch (instr->dispatch)
+            {
+#endif
+                BLOCK_OP(ARM_DATA_PROCESSING)
+                    //Already specialized on the opcode and operand form, and run from the predecoded fields
+                    instr->op_handler(*this, *instr);
+                    BLOCK_OP_END(ARM_NEXT());
+                BLOCK_OP(ARM_LOAD_WORD)
+                    arm_load_word(*this, *instr);
+                    BLOCK_OP_END(ARM_NEXT());
+                BLOCK_OP(ARM_STORE_WORD)
+                    arm_store_word(*this, *instr);
+                    BLOCK_OP_END(ARM_NEXT());
+                BLOCK_OP(ARM_LOAD_BYTE)
+                    arm_load_byte(*this, *instr);
+                    BLOCK_OP_END(ARM_NEXT());
+                BLOCK_OP(ARM_STORE_BYTE)
+                    arm_store_byte(*this, *instr);
+                    BLOCK_OP_END(ARM_NEXT());
+                BLOCK_OP(ARM_LOAD_HALFWORD)
+                    arm_load_halfword(*this, instr->instr);
+                    BLOCK_OP_END(ARM_NEXT());
+                BLOCK_OP(ARM_STORE_HALFWORD)
+                    arm_store_halfword(*this, instr->instr);
+                    BLOCK_OP_END(ARM_NEXT());
+                BLOCK_OP(ARM_LOAD_BLOCK)
+                    arm_load_block(*this, instr->instr);
+                    BLOCK_OP_END(ARM_NEXT());
+                BLOCK_OP(ARM_STORE_BLOCK)
+                    arm_store_block(*this, instr->instr);
+                    BLOCK_OP_END(ARM_NEXT());
+                BLOCK_OP(ARM_MULTIPLY)
+                    arm_mul(*this, instr->instr);
+                    BLOCK_OP_END(ARM_NEXT());
+                BLOCK_OP(ARM_B)
+                BLOCK_OP(ARM_BL)
+                    arm_b(*this, instr->instr);
+                    BLOCK_OP_END(ARM_NEXT());
+                BLOCK_OP(ARM_BX)
+                    arm_bx(*this, instr->instr);
+                    BLOCK_OP_END(ARM_NEXT());
+                BLOCK_OP_GENERIC
+                    instr->handler(*this, instr->instr);
+                    BLOCK_OP_END(ARM_NEXT());
+#if !defined(__GNUC__)
+            }
+        }
+        instr++;
+        if (BLOCK_STOP(instr, end))
+            return instr;
+    }
+#endif
+}
+
+#define THUMB_ENTER() \
+    gpr[15] += 2; \
+    next_pc = gpr[15]; \
+    goto *thumb_ops[instr->dispatch];
+
+#define THUMB_NEXT() \
+    instr++; \
+    if (BLOCK_STOP(instr, end)) \
+        return instr; \
+    THUMB_ENTER()
+
+ARM_Predecoded* ARM_CPU::run_thumb_instrs(ARM_Predecoded* instr, ARM_Predecoded* end)
+{
+    using namespace ARM_Interpreter;
+    uint32_t next_pc;
+
+#if defined(__GNUC__)
+    static void* const thumb_ops[] =
+    {
+        &&op_generic, &&op_THUMB_MOV_SHIFT, &&op_THUMB_ADD_REG, &&op_THUMB_SUB_REG,
+        &&op_THUMB_MOV_IMM, &&op_THUMB_CMP_IMM, &&op_THUMB_ADD_IMM, &&op_THUMB_SUB_IMM,
+        &&op_THUMB_ALU_OP, &&op_THUMB_HI_REG_OP, &&op_THUMB_PC_REL_LOAD,
+        &&op_THUMB_STORE_REG_OFFSET, &&op_THUMB_LOAD_REG_OFFSET, &&op_generic,
+        &&op_THUMB_STORE_HALFWORD, &&op_THUMB_LOAD_HALFWORD,
+        &&op_THUMB_STORE_IMM_OFFSET, &&op_THUMB_LOAD_IMM_OFFSET,
+        &&op_THUMB_SP_REL_STORE, &&op_THUMB_SP_REL_LOAD, &&op_generic,
+        &&op_generic, &&op_generic, &&op_generic, &&op_generic, &&op_generic,
+        &&op_THUMB_POP, &&op_THUMB_PUSH, &&op_generic, &&op_generic,
+        &&op_THUMB_BRANCH, &&op_THUMB_COND_BRANCH, &&op_THUMB_LONG_BRANCH_PREP, &&op_THUMB_LONG_BRANCH,
+        &&op_generic, &&op_generic
+    };
+    static_assert(sizeof(thumb_ops) / sizeof(thumb_ops[0]) == THUMB_SWI + 1, "Thumb dispatch table doesn't cover every kind");
+
+    THUMB_ENTER();
+#else
+    while (true)
+    {
+        gpr[15] += 2;
+        next_pc = gpr[15];
+        switch (instr->dispatch)
+        {
+#endif
+            BLOCK_OP(THUMB_ALU_OP)
+                instr->thumb_handler(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_HI_REG_OP)
+                instr->thumb_handler(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_MOV_SHIFT)
+                thumb_move_shift(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_ADD_REG)
+                thumb_add_reg(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_SUB_REG)
+                thumb_sub_reg(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_MOV_IMM)
+                thumb_mov(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_CMP_IMM)
+                thumb_cmp(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_ADD_IMM)
+                thumb_add(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_SUB_IMM)
+                thumb_sub(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_PC_REL_LOAD)
+                thumb_pc_rel_load(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_LOAD_REG_OFFSET)
+                thumb_load_reg(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_STORE_REG_OFFSET)
+                thumb_store_reg(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_LOAD_HALFWORD)
+                thumb_load_halfword(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_STORE_HALFWORD)
+                thumb_store_halfword(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_LOAD_IMM_OFFSET)
+                thumb_load_imm(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_STORE_IMM_OFFSET)
+                thumb_store_imm(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_SP_REL_LOAD)
+                thumb_sp_rel_load(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_SP_REL_STORE)
+                thumb_sp_rel_store(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_PUSH)
+                thumb_push(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_POP)
+                thumb_pop(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_BRANCH)
+                thumb_branch(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_COND_BRANCH)
+                thumb_cond_branch(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_LONG_BRANCH_PREP)
+                thumb_long_branch_prep(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP(THUMB_LONG_BRANCH)
+                thumb_long_branch(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+            BLOCK_OP_GENERIC
+                instr->thumb_handler(*this, instr->instr);
+                BLOCK_OP_END(THUMB_NEXT());
+#if !defined(__GNUC__)
+        }
+        instr++;
+        if (BLOCK_STOP(instr, end))
+            return instr;
+    }
+#endif
+}
+
+//Prints and interprets one instruction. Only the traced loop steps, so there's nothing to check here.
+int ARM_CPU::step()
+{
+    ARM_Predecoded entry;
     if (CPSR.thumb)
     {
-        uint16_t instr = read16(gpr[15] - 2);
+        uint16_t instr = fetch16(gpr[15] - 2);
         gpr[15] += 2;
-        if (can_disassemble)
-            printf("[$%08X] $%04X  %s\n", gpr[15] - 4, instr, ARM_Disasm::disasm_thumb(*this, instr).c_str());
+        printf("[$%08X] $%04X  %s\n", gpr[15] - 4, instr, ARM_Disasm::disasm_thumb(*this, instr).c_str());
+        ARM_Interpreter::predecode_thumb(*this, instr, entry);
         ARM_Interpreter::interpret_thumb(*this, instr);
     }
     else
     {
-        uint32_t instr = read32(gpr[15] - 4);
+        uint32_t instr = fetch32(gpr[15] - 4);
         gpr[15] += 4;
-        if (can_disassemble)
+        printf("[$%08X] $%08X  %s\n", gpr[15] - 8, instr, ARM_Disasm::disasm_arm(*this, instr).c_str());
+        //print_state();
+        ARM_Interpreter::predecode_arm(*this, instr, entry);
+        ARM_Interpreter::interpret_arm(*this, instr);
+    }
+    return entry.cycles;
+}
+
+ARM_Block* ARM_CPU::get_block(uint32_t addr, bool thumb)
+{
+    ARM_Block* block = &blocks[((addr >> 1) ^ (addr >> 13)) & (ARM_BLOCK_ENTRIES - 1)];
+    if (block->addr != addr || block->thumb != thumb)
+        build_block(block, addr, thumb);
+    return block;
+}
+
+//The slot is only tagged once the block is built, so a prefetch abort leaves it empty
+void ARM_CPU::build_block(ARM_Block* block, uint32_t addr, bool thumb)
+{
+    block->addr = 0xFFFFFFFF;
+    block->thumb = thumb;
+    block->length = 0;
+    block->privileged = mpu_user_pages && !(mpu_user_pages[addr >> 12] & MPU_EXEC);
+
+    //A block at a trace trigger is a single pseudo-instruction that switches to the traced loop
+    if (is_trace_trigger(addr))
+    {
+        ARM_Predecoded* instr = &block->instrs[0];
+        instr->instr = 0;
+        instr->cond = 0xE;
+        instr->dispatch = 0;
+        instr->cycles = 0;
+        instr->ends_block = true;
+        if (thumb)
+            instr->thumb_handler = trace_trigger_thumb;
+        else
+            instr->handler = trace_trigger_arm;
+        block->length = 1;
+        block->idle_loop = false;
+        sum_block_cycles(block->instrs, block->length, block->cycles);
+        mark_code_page(addr);
+        block->addr = addr;
+        return;
+    }
+
+    uint32_t page = addr >> 12;
+    uint32_t instr_addr = addr;
+    while (block->length < ARM_BLOCK_MAX_INSTRS && (instr_addr >> 12) == page)
+    {
+        if (block->length && is_trace_trigger(instr_addr))
+            break;
+
+        ARM_Predecoded* instr = &block->instrs[block->length];
+        if (thumb)
         {
-            printf("[$%08X] $%08X  %s\n", gpr[15] - 8, instr, ARM_Disasm::disasm_arm(*this, instr).c_str());
-            //print_state();
+            ARM_Interpreter::predecode_thumb(*this, fetch16(instr_addr), *instr);
+            instr_addr += 2;
         }
-        ARM_Interpreter::interpret_arm(*this, instr);
+        else
+        {
+            ARM_Interpreter::predecode_arm(*this, fetch32(instr_addr), *instr);
+            instr_addr += 4;
+        }
+        block->length++;
+        if (instr->ends_block)
+            break;
     }
 
-    if (int_pending)
-        int_check();
+    block->idle_loop = is_idle_loop(block->instrs, block->length, addr, thumb);
+    sum_block_cycles(block->instrs, block->length, block->cycles);
+    mark_code_page(addr);
+    block->addr = addr;
+}
+
+void ARM_CPU::sum_block_cycles(ARM_Predecoded* instrs, int length, uint16_t* cycles)
+{
+    cycles[0] = 0;
+    for (int i = 0; i < length; i++)
+        cycles[i + 1] = cycles[i] + instrs[i].cycles;
+}
+
+#define FLAG_N (1 << 16)
+#define FLAG_Z (1 << 17)
+#define FLAG_C (1 << 18)
+#define FLAG_V (1 << 19)
+
+//Registers, and flags as bits 16-19, an instruction reads, always writes, and may write
+struct Idle_Operands
+{
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t clobbers;
+};
+
+static uint32_t condition_reads(int cond)
+{
+    switch (cond >> 1)
+    {
+        case 0x0:
+            return FLAG_Z;
+        case 0x1:
+            return FLAG_C;
+        case 0x2:
+            return FLAG_N;
+        case 0x3:
+            return FLAG_V;
+        case 0x4:
+            return FLAG_C | FLAG_Z;
+        case 0x5:
+            return FLAG_N | FLAG_V;
+        case 0x6:
+            return FLAG_N | FLAG_Z | FLAG_V;
+        default:
+            return 0;
+    }
+}
+
+//Only loads without writeback and ALU ops that leave PC alone are allowed
+static bool arm_idle_operands(ARM_Predecoded& instr, Idle_Operands& ops)
+{
+    uint32_t op = instr.instr;
+    int rn = (op >> 16) & 0xF;
+    int rd = (op >> 12) & 0xF;
+    if (instr.cond != 0xE || rd == REG_PC)
+        return false;
+
+    switch (instr.kind)
+    {
+        case ARM_LOAD_WORD:
+        case ARM_LOAD_BYTE:
+            if (!(op & (1 << 24)) || (op & (1 << 21)))
+                return false;
+            ops.reads |= 1 << rn;
+            if (op & (1 << 25))
+                ops.reads |= 1 << (op & 0xF);
+            ops.writes |= 1 << rd;
+            return true;
+        case ARM_LOAD_HALFWORD:
+        case ARM_LOAD_SIGNED_BYTE:
+        case ARM_LOAD_SIGNED_HALFWORD:
+            if (!(op & (1 << 24)) || (op & (1 << 21)))
+                return false;
+            ops.reads |= 1 << rn;
+            if (!(op & (1 << 22)))
+                ops.reads |= 1 << (op & 0xF);
+            ops.writes |= 1 << rd;
+            return true;
+        case ARM_DATA_PROCESSING:
+        {
+            int opcode = (op >> 21) & 0xF;
+            bool set_flags = op & (1 << 20);
+            bool is_test = opcode >= 0x8 && opcode <= 0xB;
+            bool is_imm = op & (1 << 25);
+            if (is_test && !set_flags)
+                return false;
+            if (!is_imm && (op & (1 << 4)))
+                return false;
+
+            if (opcode != 0xD && opcode != 0xF)
+                ops.reads |= 1 << rn;
+            if (!is_test)
+                ops.writes |= 1 << rd;
+            if (opcode >= 0x5 && opcode <= 0x7)
+                ops.reads |= FLAG_C;
+
+            bool shifter_carry;
+            if (is_imm)
+                shifter_carry = op & 0xF00;
+            else
+            {
+                ops.reads |= 1 << (op & 0xF);
+                int shift = (op >> 7) & 0x1F;
+                int type = (op >> 5) & 0x3;
+                if (type == 3 && !shift)
+                    ops.reads |= FLAG_C;
+                shifter_carry = type || shift;
+            }
+
+            if (set_flags)
+            {
+                ops.writes |= FLAG_N | FLAG_Z;
+                switch (opcode)
+                {
+                    case 0x2:
+                    case 0x3:
+                    case 0x4:
+                    case 0x5:
+                    case 0x6:
+                    case 0x7:
+                    case 0xA:
+                    case 0xB:
+                        ops.writes |= FLAG_C | FLAG_V;
+                        break;
+                    default:
+                        if (shifter_carry)
+                            ops.writes |= FLAG_C;
+                        break;
+                }
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static bool thumb_idle_operands(ARM_Predecoded& instr, Idle_Operands& ops)
+{
+    uint16_t op = instr.instr;
+    int rd = op & 0x7;
+    int rs = (op >> 3) & 0x7;
+    switch (instr.thumb_kind)
+    {
+        case THUMB_MOV_SHIFT:
+            ops.reads |= 1 << rs;
+            ops.writes |= (1 << rd) | FLAG_N | FLAG_Z;
+            if (op & 0x1FC0)
+                ops.writes |= FLAG_C;
+            return true;
+        case THUMB_ADD_REG:
+        case THUMB_SUB_REG:
+            ops.reads |= 1 << rs;
+            if (!(op & (1 << 10)))
+                ops.reads |= 1 << ((op >> 6) & 0x7);
+            ops.writes |= (1 << rd) | FLAG_N | FLAG_Z | FLAG_C | FLAG_V;
+            return true;
+        case THUMB_MOV_IMM:
+            ops.writes |= (1 << ((op >> 8) & 0x7)) | FLAG_N | FLAG_Z;
+            return true;
+        case THUMB_CMP_IMM:
+            ops.reads |= 1 << ((op >> 8) & 0x7);
+            ops.writes |= FLAG_N | FLAG_Z | FLAG_C | FLAG_V;
+            return true;
+        case THUMB_ADD_IMM:
+        case THUMB_SUB_IMM:
+            ops.reads |= 1 << ((op >> 8) & 0x7);
+            ops.writes |= (1 << ((op >> 8) & 0x7)) | FLAG_N | FLAG_Z | FLAG_C | FLAG_V;
+            return true;
+        case THUMB_ALU_OP:
+        {
+            int opcode = (op >> 6) & 0xF;
+            ops.reads |= 1 << rs;
+            if (opcode != 0x9 && opcode != 0xF)
+                ops.reads |= 1 << rd;
+            if (opcode < 0x8 || opcode > 0xB || opcode == 0x9)
+                ops.writes |= 1 << rd;
+            ops.writes |= FLAG_N | FLAG_Z;
+            switch (opcode)
+            {
+                case 0x2:
+                case 0x3:
+                case 0x4:
+                case 0x7:
+                    //Register shifts by 0 leave C alone
+                    ops.clobbers |= FLAG_C;
+                    break;
+                case 0x5:
+                case 0x6:
+                    ops.reads |= FLAG_C;
+                    ops.writes |= FLAG_C | FLAG_V;
+                    break;
+                case 0x9:
+                case 0xA:
+                case 0xB:
+                    ops.writes |= FLAG_C | FLAG_V;
+                    break;
+                default:
+                    break;
+            }
+            return true;
+        }
+        case THUMB_HI_REG_OP:
+        {
+            int opcode = (op >> 8) & 0x3;
+            int source = ((op >> 3) & 0x7) | ((op >> 3) & 0x8);
+            int destination = (op & 0x7) | ((op >> 4) & 0x8);
+            if (opcode == 0x3 || destination == REG_PC)
+                return false;
+            ops.reads |= 1 << source;
+            if (opcode != 0x2)
+                ops.reads |= 1 << destination;
+            if (opcode == 0x1)
+                ops.writes |= FLAG_N | FLAG_Z | FLAG_C | FLAG_V;
+            else
+                ops.writes |= 1 << destination;
+            return true;
+        }
+        case THUMB_LOAD_IMM_OFFSET:
+        case THUMB_LOAD_HALFWORD:
+            ops.reads |= 1 << rs;
+            ops.writes |= 1 << rd;
+            return true;
+        case THUMB_LOAD_REG_OFFSET:
+            ops.reads |= (1 << rs) | (1 << ((op >> 6) & 0x7));
+            ops.writes |= 1 << rd;
+            return true;
+        case THUMB_PC_REL_LOAD:
+            ops.writes |= 1 << ((op >> 8) & 0x7);
+            return true;
+        case THUMB_SP_REL_LOAD:
+            ops.reads |= 1 << REG_SP;
+            ops.writes |= 1 << ((op >> 8) & 0x7);
+            return true;
+        default:
+            return false;
+    }
+}
+
+//Whether the block ends with a branch back to its start
+static bool branches_to(ARM_Predecoded& instr, uint32_t instr_addr, uint32_t target, bool thumb, Idle_Operands& ops)
+{
+    uint32_t op = instr.instr;
+    if (thumb)
+    {
+        if (instr.thumb_kind == THUMB_BRANCH)
+        {
+            int32_t offset = ((int32_t)(op << 21)) >> 20;
+            return instr_addr + 4 + offset == target;
+        }
+        if (instr.thumb_kind == THUMB_COND_BRANCH)
+        {
+            int32_t offset = ((int32_t)(op << 24)) >> 23;
+            ops.reads |= condition_reads((op >> 8) & 0xF);
+            return ((op >> 8) & 0xF) < 0xE && instr_addr + 4 + offset == target;
+        }
+        return false;
+    }
+    if (instr.kind != ARM_B || instr.cond == 0xF)
+        return false;
+    int32_t offset = ((int32_t)(op << 8)) >> 6;
+    ops.reads |= condition_reads(instr.cond);
+    return instr_addr + 8 + offset == target;
+}
+
+//Detects polling loops such as "ldr r0, [r1]; tst r0, #1; beq loop". Nothing may be read before
+//it's written in the same iteration, unless the loop never writes it, so every iteration computes
+//the same result until something outside the core changes the memory being polled.
+bool ARM_CPU::is_idle_loop(ARM_Predecoded *instrs, int length, uint32_t addr, bool thumb)
+{
+    const int MAX_IDLE_LOOP_LENGTH = 8;
+    if (length > MAX_IDLE_LOOP_LENGTH)
+        return false;
+
+    int instr_size = thumb ? 2 : 4;
+    Idle_Operands ops[MAX_IDLE_LOOP_LENGTH] = {};
+    uint32_t loop_writes = 0;
+    for (int i = 0; i < length; i++)
+    {
+        bool allowed;
+        if (i == length - 1)
+            allowed = branches_to(instrs[i], addr + i * instr_size, addr, thumb, ops[i]);
+        else if (thumb)
+            allowed = thumb_idle_operands(instrs[i], ops[i]);
+        else
+            allowed = arm_idle_operands(instrs[i], ops[i]);
+        if (!allowed)
+            return false;
+        loop_writes |= ops[i].writes | ops[i].clobbers;
+    }
+
+    //PC is constant for each instruction, so reading it is fine
+    uint32_t written = 0;
+    for (int i = 0; i < length; i++)
+    {
+        if (ops[i].reads & loop_writes & ~written & ~(1 << REG_PC))
+            return false;
+        written |= ops[i].writes;
+    }
+    return true;
+}
+
+void ARM_CPU::mark_code_page(uint32_t addr)
+{
+    uint32_t page = addr >> 12;
+    if (addr < itcm_size)
+        itcm_code_pages |= 1 << (page & 0x7);
+    else
+        code_pages[page >> 3] |= 1 << (page & 0x7);
+}
+
+void ARM_CPU::invalidate_code_page(uint32_t page)
+{
+    code_pages[page >> 3] &= ~(1 << (page & 0x7));
+    code_written = true;
+
+    for (int i = 0; i < ARM_BLOCK_ENTRIES; i++)
+    {
+        if ((blocks[i].addr >> 12) == page)
+            blocks[i].addr = 0xFFFFFFFF;
+    }
+    if (jit)
+        jit->invalidate_page(page);
+}
+
+void ARM_CPU::invalidate_itcm_page(uint32_t offset)
+{
+    itcm_code_pages &= ~(1 << offset);
+    code_written = true;
+
+    for (int i = 0; i < ARM_BLOCK_ENTRIES; i++)
+    {
+        uint32_t block_addr = blocks[i].addr;
+        if (block_addr < itcm_size && ((block_addr >> 12) & 0x7) == offset)
+            blocks[i].addr = 0xFFFFFFFF;
+    }
+    if (jit)
+        jit->invalidate_itcm_page(offset, itcm_size);
+}
+
+void ARM_CPU::flush_code_cache()
+{
+    //0xFFFFFFFF is never a valid fetch address, so it marks an empty slot.
+    //Only the tags are cleared, as the running block may still be reading its instructions.
+    for (int i = 0; i < ARM_BLOCK_ENTRIES; i++)
+        blocks[i].addr = 0xFFFFFFFF;
+    memset(code_pages, 0, (1 << 20) / 8);
+    itcm_code_pages = 0;
+    code_written = true;
+    if (jit)
+        jit->flush();
+}
+
+//Called whenever the dirty pages are taken, so each page's next store from generated code gets marked again
+void ARM_CPU::reset_clean_pages()
+{
+    memset(clean_pages, 0xFF, (1 << 20) / 8);
+}
+
+//Without JIT_SUPPORTED the interpreter is always used
+void ARM_CPU::set_tracing(bool enabled)
+{
+    tracing = enabled;
+    if (enabled)
+        run_slice = &ARM_CPU::run_cycles<true>;
+    else
+        run_slice = &ARM_CPU::run_cycles<false>;
+}
+
+//Cached blocks are rebuilt so they split at the new trigger
+void ARM_CPU::add_trace_trigger(uint32_t addr)
+{
+    if (!is_trace_trigger(addr))
+        trace_triggers.push_back(addr);
+    if (blocks)
+        flush_code_cache();
+}
+
+void ARM_CPU::clear_trace_triggers()
+{
+    trace_triggers.clear();
+    if (blocks)
+        flush_code_cache();
+}
+
+bool ARM_CPU::is_trace_trigger(uint32_t addr)
+{
+    if (trace_triggers.empty())
+        return false;
+    return std::find(trace_triggers.begin(), trace_triggers.end(), addr) != trace_triggers.end();
+}
+
+//Stops the untraced loop by taking its remaining cycles, which run() hands to the traced loop
+void ARM_CPU::trigger_trace()
+{
+    set_tracing(true);
+    deferred_cycles += cycles_left;
+    cycles_left = 0;
+}
+
+//The trigger hasn't executed anything, so PC is put back for the traced loop to start at the same instruction
+void ARM_CPU::trace_trigger_arm(ARM_CPU &cpu, uint32_t instr)
+{
+    (void)instr;
+    cpu.gpr[15] -= 4;
+    cpu.trigger_trace();
+}
+
+void ARM_CPU::trace_trigger_thumb(ARM_CPU &cpu, uint16_t instr)
+{
+    (void)instr;
+    cpu.gpr[15] -= 2;
+    cpu.trigger_trace();
+}
+
+void ARM_CPU::set_jit_enabled(bool enabled)
+{
+#ifdef JIT_SUPPORTED
+    if (enabled && !jit)
+        jit = new ARM_JIT(this);
+    else if (!enabled && jit)
+    {
+        delete jit;
+        jit = nullptr;
+    }
+#else
+    (void)enabled;
+#endif
+}
+
+void ARM_CPU::set_threaded(bool enabled)
+{
+    threaded = enabled;
+}
+
+void ARM_CPU::set_fast_ram(uint32_t base, uint32_t size, uint8_t* mem, bool writable)
+{
+    fast_ram.base = base;
+    fast_ram.size = size;
+    fast_ram.mem = mem;
+    fast_ram.writable = writable;
+    if (jit)
+        jit->flush();
+}
+
+void ARM_CPU::set_fastmem(Fastmem* fastmem)
+{
+    this->fastmem = fastmem;
+    if (jit)
+        jit->flush();
+}
+
+void ARM_CPU::set_other_core(ARM_CPU* core)
+{
+    other_core = core;
+    if (jit)
+        jit->flush();
+}
+
+void ARM_CPU::set_memory_map(Memory_Map* bus_map, bool has_tcm)
+{
+    this->bus_map = bus_map;
+    delete tcm_map;
+    tcm_map = has_tcm ? new Memory_Map() : nullptr;
+    map = has_tcm ? tcm_map : bus_map;
+    update_memory_map();
+}
+
+//Whoever changes the bus's mapping has to pass it on, as a core with TCM only sees a copy of it
+void ARM_CPU::update_memory_map()
+{
+    if (!tcm_map)
+        return;
+    tcm_map->copy(*bus_map);
+    map_tcm();
+    protect_pages(0, MEMMAP_PAGES);
+    check_mpu_bus();
+}
+
+void ARM_CPU::update_memory_map(uint32_t start, uint32_t size)
+{
+    if (!tcm_map)
+        return;
+    tcm_map->copy(*bus_map, start, size);
+    map_tcm();
+    protect_pages(start >> MEMMAP_PAGE_SHIFT, size >> MEMMAP_PAGE_SHIFT);
+    check_mpu_bus();
+}
+
+//Called by CP15 when the TCMs move, resize, or are switched on or off
+void ARM_CPU::update_tcm()
+{
+    if (!tcm_map)
+        return;
+
+    //Uncover what the old TCMs hid
+    tcm_map->copy(*bus_map, 0, itcm_size);
+    tcm_map->copy(*bus_map, dtcm_base, dtcm_size);
+    protect_pages(0, itcm_size >> MEMMAP_PAGE_SHIFT);
+    protect_pages(dtcm_base >> MEMMAP_PAGE_SHIFT, dtcm_size >> MEMMAP_PAGE_SHIFT);
+
+    itcm_size = cp15->itcm_size;
+    dtcm_base = cp15->dtcm_base;
+    dtcm_size = cp15->dtcm_size;
+    map_tcm();
+
+    //Cached code may have been fetched from either side of the change
+    flush_code_cache();
+}
+
+//The protection unit covers the TCMs as well
+void ARM_CPU::map_tcm()
+{
+    tcm_map->map(0, itcm_size, cp15->ITCM, CP15_ITCM_SIZE, false);
+    tcm_map->map(dtcm_base, dtcm_size, cp15->DTCM, CP15_DTCM_SIZE, true);
+    protect_pages(0, itcm_size >> MEMMAP_PAGE_SHIFT);
+    protect_pages(dtcm_base >> MEMMAP_PAGE_SHIFT, dtcm_size >> MEMMAP_PAGE_SHIFT);
+}
+
+//Called by CP15 whenever the protection unit's regions are recompiled
+void ARM_CPU::update_mpu()
+{
+    if (!tcm_map)
+        return;
+    mpu_pages = cp15->mpu_pages;
+    mpu_user_pages = cp15->mpu_user_pages;
+    update_memory_map();
+
+    //Cached blocks were only checked for execute access when they were built
+    flush_code_cache();
+}
+
+//The page table is shared by both modes, so it only keeps what user mode may access as well
+void ARM_CPU::protect_pages(uint32_t first, uint32_t count)
+{
+    if (!mpu_pages)
+        return;
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        uint8_t flags = mpu_pages[i] & mpu_user_pages[i];
+        if (!(flags & MPU_READ) || !(flags & MPU_WRITE))
+            tcm_map->protect(i << MEMMAP_PAGE_SHIFT, MEMMAP_PAGE_SIZE, flags & MPU_READ);
+    }
+}
+
+//Generated code compiled while the bus was fully allowed has to go once it no longer is.
+//Blocks may run in either mode, so user mode has to be allowed as well.
+void ARM_CPU::check_mpu_bus()
+{
+    bool allowed = true;
+    for (uint32_t i = 0; mpu_pages && i < MEMMAP_PAGES; i++)
+    {
+        uint32_t addr = i << MEMMAP_PAGE_SHIFT;
+        uint8_t flags = mpu_pages[i] & mpu_user_pages[i];
+        if ((bus_map->get_read_page(addr) && !(flags & MPU_READ)) ||
+            (bus_map->get_write_page(addr) && !(flags & MPU_WRITE)))
+        {
+            allowed = false;
+            break;
+        }
+    }
+    if (allowed != mpu_allows_bus)
+    {
+        mpu_allows_bus = allowed;
+        if (jit)
+            jit->flush();
+    }
+}
+
+//Slow path of an access on a core with a protection unit. Aborts if the current mode may not make it.
+//Otherwise returns the TCM behind addr, as tcm_map leaves out TCM pages user mode can't access, or null
+//for the bus. Writes to ITCM are left to the caller, as they have to drop cached code.
+uint8_t* ARM_CPU::check_mpu(uint32_t addr, bool write)
+{
+    if (!(get_mpu_pages()[addr >> 12] & (write ? MPU_WRITE : MPU_READ)))
+        data_abort(addr, write);
+    if (addr - dtcm_base < dtcm_size)
+        return &cp15->DTCM[(addr - dtcm_base) & (CP15_DTCM_SIZE - 1)];
+    if (!write && addr < itcm_size)
+        return &cp15->ITCM[addr & (CP15_ITCM_SIZE - 1)];
+    return nullptr;
+}
+
+//Entered like an interrupt, then the aborting instruction is cut short, leaving its base register as it was.
+//LR is 8 bytes past it for data aborts and 4 for prefetch aborts, in either state.
+void ARM_CPU::data_abort(uint32_t addr, bool write)
+{
+    printf("[ARM%d] Data abort %s $%08X\n", id, write ? "writing" : "reading", addr);
+
+    //PC is 8 bytes past the running instruction, or 4 in Thumb
+    enter_abort(gpr[15] + (CPSR.thumb ? 4 : 0), 0x10);
+}
+
+void ARM_CPU::prefetch_abort(uint32_t addr)
+{
+    printf("[ARM%d] Prefetch abort at $%08X\n", id, addr);
+    enter_abort(addr + 4, 0x0C);
+}
+
+void ARM_CPU::enter_abort(uint32_t return_addr, uint32_t vector)
+{
+    CPSR.resolve_flags();
+    SPSR[PSR_ABORT] = CPSR;
+
+    update_reg_mode(PSR_ABORT);
+    CPSR.mode = PSR_ABORT;
+    CPSR.irq_disable = true;
+    gpr[REG_LR] = return_addr;
+    jp(cp15->vector_base + vector, true);
+    throw ARM_Abort();
+}
+
+void ARM_CPU::set_mmu_enabled(bool enabled)
+{
+    mmu_enabled = enabled;
+    flush_tlb();
+    flush_code_cache();
+}
+
+void ARM_CPU::flush_tlb()
+{
+    for (int i = 0; i < ARM_TLB_ENTRIES; i++)
+    {
+        tlb[i].read_tag = ARM_TLB_EMPTY;
+        tlb[i].write_tag = ARM_TLB_EMPTY;
+    }
+}
+
+//ARMv6 page table walk with subpages disabled, run on TLB misses. Only privileged permissions are checked, and
+//aborts aren't emulated yet, so faults are fatal. The page is cached in the TLB when it's backed by host memory;
+//I/O is walked again on every access.
+uint32_t ARM_CPU::translate(uint32_t addr, bool write)
+{
+    //TTBCR.N splits the address space between the two tables, TTBR1 taking the top
+    int split = cp15->ttbcr & 0x7;
+    uint32_t table_addr;
+    if (split && (addr >> (32 - split)))
+        table_addr = (cp15->ttbr1 & 0xFFFFC000) | ((addr >> 20) << 2);
+    else
+        table_addr = (cp15->ttbr0 & (0xFFFFFFFF << (14 - split))) | (((addr << split) >> (split + 20)) << 2);
+
+    uint32_t desc = (id == 9) ? e->arm9_read32(table_addr) : e->arm11_read32(table_addr);
+    uint32_t phys = 0, domain = 0, ap = 0, apx = 0;
+    switch (desc & 0x3)
+    {
+        case 0x1:
+        {
+            //Coarse second-level table
+            domain = (desc >> 5) & 0xF;
+            uint32_t page_addr = (desc & 0xFFFFFC00) | (((addr >> 12) & 0xFF) << 2);
+            uint32_t page = (id == 9) ? e->arm9_read32(page_addr) : e->arm11_read32(page_addr);
+            if (!(page & 0x3))
+                EmuException::die("[ARM%d] Page translation fault at $%08X ($%08X)\n", id, addr, gpr[15]);
+
+            //64 KB large pages, or 4 KB small pages
+            if ((page & 0x3) == 0x1)
+                phys = (page & 0xFFFF0000) | (addr & 0xFFFF);
+            else
+                phys = (page & 0xFFFFF000) | (addr & 0xFFF);
+            ap = (page >> 4) & 0x3;
+            apx = (page >> 9) & 0x1;
+            break;
+        }
+        case 0x2:
+            //1 MB sections, or 16 MB supersections, which are always in domain 0
+            if (desc & (1 << 18))
+            {
+                phys = (desc & 0xFF000000) | (addr & 0xFFFFFF);
+                domain = 0;
+            }
+            else
+            {
+                phys = (desc & 0xFFF00000) | (addr & 0xFFFFF);
+                domain = (desc >> 5) & 0xF;
+            }
+            ap = (desc >> 10) & 0x3;
+            apx = (desc >> 15) & 0x1;
+            break;
+        default:
+            EmuException::die("[ARM%d] Section translation fault at $%08X ($%08X)\n", id, addr, gpr[15]);
+    }
+
+    bool readable = false, writable = false;
+    switch ((cp15->dacr >> (domain * 2)) & 0x3)
+    {
+        case 0x1:
+            //Client
+            readable = ap != 0;
+            writable = ap != 0 && !apx;
+            break;
+        case 0x3:
+            //Manager
+            readable = true;
+            writable = true;
+            break;
+        default:
+            EmuException::die("[ARM%d] Domain fault at $%08X ($%08X)\n", id, addr, gpr[15]);
+    }
+    if (!readable || (write && !writable))
+        EmuException::die("[ARM%d] Permission fault at $%08X ($%08X)\n", id, addr, gpr[15]);
+
+    ARM_TLB_Entry& entry = tlb[(addr >> 12) & (ARM_TLB_ENTRIES - 1)];
+    uint8_t* read_page = map->get_read_page(phys);
+    uint8_t* write_page = writable ? map->get_write_page(phys) : nullptr;
+    entry.phys = phys & ~MEMMAP_PAGE_MASK;
+    entry.mem = read_page;
+    entry.read_tag = read_page ? (addr >> 12) : ARM_TLB_EMPTY;
+    entry.write_tag = (write_page && write_page == read_page) ? (addr >> 12) : ARM_TLB_EMPTY;
+    return phys;
 }
 
 void ARM_CPU::print_state()
@@ -129,8 +1296,6 @@ void ARM_CPU::jp(uint32_t addr, bool change_thumb_state)
 {
     //if (id == 9)
         //printf("jp: $%08X\n", addr);
-    if (addr == 0x801B000)
-        can_disassemble = true;
     gpr[15] = addr;
 
     if (change_thumb_state)
@@ -154,14 +1319,15 @@ void ARM_CPU::int_check()
     if (!CPSR.irq_disable && int_pending)
     {
         printf("Interrupt!\n");
-        uint32_t value = CPSR.get();
-        SPSR[PSR_IRQ].set(value);
+        CPSR.resolve_flags();
+        SPSR[PSR_IRQ] = CPSR;
 
         //Update new CPSR
-        LR_irq = gpr[15] + ((CPSR.thumb) ? 2 : 0);
+        uint32_t return_addr = gpr[15] + ((CPSR.thumb) ? 2 : 0);
         update_reg_mode(PSR_IRQ);
         CPSR.mode = PSR_IRQ;
         CPSR.irq_disable = true;
+        gpr[REG_LR] = return_addr;
 
         if (id == 9)
             jp(0xFFFF0000 + 0x18, true);
@@ -173,9 +1339,12 @@ void ARM_CPU::int_check()
 void ARM_CPU::set_int_signal(bool pending)
 {
     int_pending = pending;
-    if (int_pending)
+    if (pending)
         unhalt();
-    int_check();
+
+    //The signal may come from the other core's thread, so leave it to the run loop
+    if (!threaded)
+        int_check();
 }
 
 void ARM_CPU::halt()
@@ -189,172 +1358,104 @@ void ARM_CPU::unhalt()
     halted = false;
 }
 
-void ARM_CPU::set_zero_neg_flags(uint32_t value)
+//Register bank of each PSR mode, or -1 for encodings that aren't a valid mode
+static const int8_t mode_banks[0x20] =
 {
-    CPSR.negative = value & (1 << 31);
-    CPSR.zero = !value;
-}
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    BANK_USER, BANK_FIQ, BANK_IRQ, BANK_SVC, -1, -1, -1, BANK_ABT,
+    -1, -1, -1, BANK_UND, -1, -1, -1, BANK_USER
+};
 
-//Code here from melonDS's ALU core (my original implementation was incorrect in many ways)
-void ARM_CPU::set_CV_add_flags(uint32_t a, uint32_t b, uint32_t result)
+void ARM_CPU::update_reg_mode(PSR_MODE mode)
 {
-    CPSR.carry = ((0xFFFFFFFF-a) < b);
-    CPSR.overflow = ADD_OVERFLOW(a, b, result);
-}
+    if (mode == CPSR.mode)
+        return;
 
-void ARM_CPU::set_CV_sub_flags(uint32_t a, uint32_t b, uint32_t result)
-{
-    CPSR.carry = a >= b;
-    CPSR.overflow = SUB_OVERFLOW(a, b, result);
-}
+    int old_bank = mode_banks[CPSR.mode & 0x1F];
+    int new_bank = mode_banks[mode & 0x1F];
+    if (old_bank < 0)
+        EmuException::die("[ARM%d] Unrecognized old PSR mode %d\n", id, CPSR.mode);
+    if (new_bank < 0)
+        EmuException::die("[ARM%d] Unrecognized new PSR mode %d\n", id, mode);
 
-void ARM_CPU::update_reg_mode(PSR_MODE mode)
-{
-    if (mode != CPSR.mode)
-    {
-        switch (CPSR.mode)
-        {
-            case PSR_SYSTEM:
-            case PSR_USER:
-                break;
-            case PSR_IRQ:
-                std::swap(gpr[13], SP_irq);
-                std::swap(gpr[14], LR_irq);
-                break;
-            case PSR_FIQ:
-                std::swap(gpr[8], fiq_regs[0]);
-                std::swap(gpr[9], fiq_regs[1]);
-                std::swap(gpr[10], fiq_regs[2]);
-                std::swap(gpr[11], fiq_regs[3]);
-                std::swap(gpr[12], fiq_regs[4]);
-                std::swap(gpr[13], SP_fiq);
-                std::swap(gpr[14], LR_fiq);
-                break;
-            case PSR_SUPERVISOR:
-                std::swap(gpr[13], SP_svc);
-                std::swap(gpr[14], LR_svc);
-                break;
-            case PSR_ABORT:
-                std::swap(gpr[13], SP_abt);
-                std::swap(gpr[14], LR_abt);
-                break;
-            case PSR_UNDEFINED:
-                std::swap(gpr[13], SP_und);
-                std::swap(gpr[14], LR_und);
-                break;
-            default:
-                EmuException::die("[ARM%d] Unrecognized old PSR mode %d\n", id, CPSR.mode);
-        }
-
-        switch (mode)
-        {
-            case PSR_SYSTEM:
-            case PSR_USER:
-                break;
-            case PSR_IRQ:
-                std::swap(gpr[13], SP_irq);
-                std::swap(gpr[14], LR_irq);
-                break;
-            case PSR_FIQ:
-                std::swap(gpr[8], fiq_regs[0]);
-                std::swap(gpr[9], fiq_regs[1]);
-                std::swap(gpr[10], fiq_regs[2]);
-                std::swap(gpr[11], fiq_regs[3]);
-                std::swap(gpr[12], fiq_regs[4]);
-                std::swap(gpr[13], SP_fiq);
-                std::swap(gpr[14], LR_fiq);
-                break;
-            case PSR_SUPERVISOR:
-                std::swap(gpr[13], SP_svc);
-                std::swap(gpr[14], LR_svc);
-                break;
-            case PSR_ABORT:
-                std::swap(gpr[13], SP_abt);
-                std::swap(gpr[14], LR_abt);
-                break;
-            case PSR_UNDEFINED:
-                std::swap(gpr[13], SP_und);
-                std::swap(gpr[14], LR_und);
-                break;
-            default:
-                EmuException::die("[ARM%d] Unrecognized new PSR mode %d\n", id, mode);
-        }
+    //User and system mode share every register
+    if (old_bank == new_bank)
+        return;
+
+    //Save the old mode's registers. r8-r12 only change hands when entering or leaving FIQ.
+    if (old_bank == BANK_FIQ)
+    {
+        memcpy(banked_regs[BANK_FIQ], &gpr[8], sizeof(uint32_t) * 7);
+        memcpy(&gpr[8], banked_regs[BANK_USER], sizeof(uint32_t) * 5);
+    }
+    else
+    {
+        if (new_bank == BANK_FIQ)
+            memcpy(banked_regs[BANK_USER], &gpr[8], sizeof(uint32_t) * 5);
+        banked_regs[old_bank][5] = gpr[13];
+        banked_regs[old_bank][6] = gpr[14];
+    }
+
+    if (new_bank == BANK_FIQ)
+        memcpy(&gpr[8], banked_regs[BANK_FIQ], sizeof(uint32_t) * 7);
+    else
+    {
+        gpr[13] = banked_regs[new_bank][5];
+        gpr[14] = banked_regs[new_bank][6];
     }
 }
 
 void ARM_CPU::spsr_to_cpsr()
 {
-    uint32_t new_CPSR = SPSR[CPSR.mode].get();
-    update_reg_mode((PSR_MODE)(new_CPSR & 0x1F));
-    CPSR.set(new_CPSR);
+    PSR_Flags new_CPSR = SPSR[CPSR.mode];
+    update_reg_mode(new_CPSR.mode);
+    CPSR = new_CPSR;
 }
 
-bool ARM_CPU::meets_condition(int cond)
+//With the MMU on, a TLB hit goes straight to host memory, and anything else is translated before taking the
+//physical path below. The TLB only holds host memory, so the walk repeats for each I/O access.
+inline uint8_t* ARM_CPU::tlb_read(uint32_t addr)
 {
-    switch (cond)
-    {
-        case 0x0:
-            //EQ - equal
-            return CPSR.zero;
-        case 0x1:
-            //NE - not equal
-            return !CPSR.zero;
-        case 0x2:
-            //CS - unsigned higher or same
-            return CPSR.carry;
-        case 0x3:
-            //CC - unsigned lower
-            return !CPSR.carry;
-        case 0x4:
-            //MI - negative
-            return CPSR.negative;
-        case 0x5:
-            //PL - positive or zero
-            return !CPSR.negative;
-        case 0x6:
-            //VS - overflow
-            return CPSR.overflow;
-        case 0x7:
-            //VC - no overflow
-            return !CPSR.overflow;
-        case 0x8:
-            //HI - unsigned higher
-            return CPSR.carry && !CPSR.zero;
-        case 0x9:
-            //LS - unsigned lower or same
-            return !CPSR.carry || CPSR.zero;
-        case 0xA:
-            //GE - greater than or equal
-            return (CPSR.negative == CPSR.overflow);
-        case 0xB:
-            //LT - less than
-            return (CPSR.negative != CPSR.overflow);
-        case 0xC:
-            //GT - greater than
-            return !CPSR.zero && (CPSR.negative == CPSR.overflow);
-        case 0xD:
-            //LE - less than or equal to
-            return CPSR.zero || (CPSR.negative != CPSR.overflow);
-        case 0xE:
-            //AL - always
-            return true;
-        case 0xF:
-            //Some instructions have the 0xF condition required, so let them pass
-            return true;
-        default:
-            EmuException::die("[ARM_CPU] Unrecognized condition %d\n", cond);
-            return false;
-    }
+    ARM_TLB_Entry& entry = tlb[(addr >> 12) & (ARM_TLB_ENTRIES - 1)];
+    if (entry.read_tag != addr >> 12)
+        return nullptr;
+    cycles_left -= cycle_table->wait_states[entry.phys >> 24];
+    return &entry.mem[addr & MEMMAP_PAGE_MASK];
 }
 
+//Cached code is tagged by virtual address, but the other core's by physical address
+inline uint8_t* ARM_CPU::tlb_write(uint32_t addr)
+{
+    ARM_TLB_Entry& entry = tlb[(addr >> 12) & (ARM_TLB_ENTRIES - 1)];
+    if (entry.write_tag != addr >> 12)
+        return nullptr;
+    cycles_left -= cycle_table->wait_states[entry.phys >> 24];
+    invalidate_code(addr);
+    e->invalidate_code(*this, entry.phys | (addr & MEMMAP_PAGE_MASK));
+    e->mark_dirty(entry.mem);
+    return &entry.mem[addr & MEMMAP_PAGE_MASK];
+}
+
+//TCM and plain memory come straight from the core's page table, and everything else goes to the bus.
+//Wait states are charged by region, which leaves the TCMs free wherever boot9 puts them.
 uint8_t ARM_CPU::read8(uint32_t addr)
 {
-    if (cp15)
+    if (mmu_enabled)
     {
-        if (addr < cp15->itcm_size)
-            return cp15->ITCM[addr & 0x7FFF];
-        if (addr >= cp15->dtcm_base && addr < cp15->dtcm_base + cp15->dtcm_size)
-            return cp15->DTCM[addr & 0x3FFF];
+        uint8_t* mem = tlb_read(addr);
+        if (mem)
+            return mem[0];
+        addr = translate(addr, false);
+    }
+    cycles_left -= cycle_table->wait_states[addr >> 24];
+    uint8_t* page = map->get_read_page(addr);
+    if (page)
+        return page[addr & MEMMAP_PAGE_MASK];
+    if (mpu_pages)
+    {
+        uint8_t* tcm = check_mpu(addr, false);
+        if (tcm)
+            return tcm[0];
     }
     if (id == 9)
         return e->arm9_read8(addr);
@@ -363,12 +1464,22 @@ uint8_t ARM_CPU::read8(uint32_t addr)
 
 uint16_t ARM_CPU::read16(uint32_t addr)
 {
-    if (cp15)
+    if (mmu_enabled)
     {
-        if (addr < cp15->itcm_size)
-            return *(uint16_t*)&cp15->ITCM[addr & 0x7FFF];
-        if (addr >= cp15->dtcm_base && addr < cp15->dtcm_base + cp15->dtcm_size)
-            return *(uint16_t*)&cp15->DTCM[addr & 0x3FFF];
+        uint8_t* mem = tlb_read(addr);
+        if (mem)
+            return *(uint16_t*)mem;
+        addr = translate(addr, false);
+    }
+    cycles_left -= cycle_table->wait_states[addr >> 24];
+    uint8_t* page = map->get_read_page(addr);
+    if (page)
+        return *(uint16_t*)&page[addr & MEMMAP_PAGE_MASK];
+    if (mpu_pages)
+    {
+        uint8_t* tcm = check_mpu(addr, false);
+        if (tcm)
+            return *(uint16_t*)tcm;
     }
     if (id == 9)
         return e->arm9_read16(addr);
@@ -377,33 +1488,68 @@ uint16_t ARM_CPU::read16(uint32_t addr)
 
 uint32_t ARM_CPU::read32(uint32_t addr)
 {
-    if (cp15)
+    if (mmu_enabled)
+    {
+        uint8_t* mem = tlb_read(addr);
+        if (mem)
+            return *(uint32_t*)mem;
+        addr = translate(addr, false);
+    }
+    cycles_left -= cycle_table->wait_states[addr >> 24];
+    uint8_t* page = map->get_read_page(addr);
+    if (page)
+        return *(uint32_t*)&page[addr & MEMMAP_PAGE_MASK];
+    if (mpu_pages)
     {
-        if (addr < cp15->itcm_size)
-            return *(uint32_t*)&cp15->ITCM[addr & 0x7FFF];
-        if (addr >= cp15->dtcm_base && addr < cp15->dtcm_base + cp15->dtcm_size)
-            return *(uint32_t*)&cp15->DTCM[addr & 0x3FFF];
+        uint8_t* tcm = check_mpu(addr, false);
+        if (tcm)
+            return *(uint32_t*)tcm;
     }
     if (id == 9)
         return e->arm9_read32(addr);
     return e->arm11_read32(addr);
 }
 
+//The ITCM is only mapped for reads, so only writes that miss the page table have to look for it
 void ARM_CPU::write8(uint32_t addr, uint8_t value)
 {
-    if (cp15)
+    if (mmu_enabled)
     {
-        if (addr < cp15->itcm_size)
+        uint8_t* mem = tlb_write(addr);
+        if (mem)
         {
-            cp15->ITCM[addr & 0x7FFF] = value;
+            mem[0] = value;
             return;
         }
-        if (addr >= cp15->dtcm_base && addr < cp15->dtcm_base + cp15->dtcm_size)
+        invalidate_code(addr);
+        addr = translate(addr, true);
+    }
+    cycles_left -= cycle_table->wait_states[addr >> 24];
+    uint8_t* page = map->get_write_page(addr);
+    if (page)
+    {
+        page[addr & MEMMAP_PAGE_MASK] = value;
+        e->mark_dirty(page);
+        e->invalidate_code(*this, addr);
+        return;
+    }
+    if (mpu_pages)
+    {
+        uint8_t* dtcm = check_mpu(addr, true);
+        if (dtcm)
         {
-            cp15->DTCM[addr & 0x3FFF] = value;
+            dtcm[0] = value;
+            e->mark_dirty(dtcm);
             return;
         }
     }
+    if (addr < itcm_size)
+    {
+        cp15->ITCM[addr & 0x7FFF] = value;
+        e->mark_dirty(&cp15->ITCM[addr & 0x7FFF]);
+        invalidate_itcm_code(addr);
+        return;
+    }
     if (id == 9)
         e->arm9_write8(addr, value);
     else
@@ -412,19 +1558,43 @@ void ARM_CPU::write8(uint32_t addr, uint8_t value)
 
 void ARM_CPU::write16(uint32_t addr, uint16_t value)
 {
-    if (cp15)
+    if (mmu_enabled)
     {
-        if (addr < cp15->itcm_size)
+        uint8_t* mem = tlb_write(addr);
+        if (mem)
         {
-            *(uint16_t*)&cp15->ITCM[addr & 0x7FFF] = value;
+            *(uint16_t*)mem = value;
             return;
         }
-        if (addr >= cp15->dtcm_base && addr < cp15->dtcm_base + cp15->dtcm_size)
+        invalidate_code(addr);
+        addr = translate(addr, true);
+    }
+    cycles_left -= cycle_table->wait_states[addr >> 24];
+    uint8_t* page = map->get_write_page(addr);
+    if (page)
+    {
+        *(uint16_t*)&page[addr & MEMMAP_PAGE_MASK] = value;
+        e->mark_dirty(page);
+        e->invalidate_code(*this, addr);
+        return;
+    }
+    if (mpu_pages)
+    {
+        uint8_t* dtcm = check_mpu(addr, true);
+        if (dtcm)
         {
-            *(uint16_t*)&cp15->DTCM[addr & 0x3FFF] = value;
+            *(uint16_t*)dtcm = value;
+            e->mark_dirty(dtcm);
             return;
         }
     }
+    if (addr < itcm_size)
+    {
+        *(uint16_t*)&cp15->ITCM[addr & 0x7FFF] = value;
+        e->mark_dirty(&cp15->ITCM[addr & 0x7FFF]);
+        invalidate_itcm_code(addr);
+        return;
+    }
     if (id == 9)
         e->arm9_write16(addr, value);
     else
@@ -435,25 +1605,99 @@ void ARM_CPU::write32(uint32_t addr, uint32_t value)
 {
     if (addr == 0x08077438 + 4)
         printf("blorp $%08X\n", value);
-    if (cp15)
+    if (mmu_enabled)
     {
-        if (addr < cp15->itcm_size)
+        uint8_t* mem = tlb_write(addr);
+        if (mem)
         {
-            *(uint32_t*)&cp15->ITCM[addr & 0x7FFF] = value;
+            *(uint32_t*)mem = value;
             return;
         }
-        if (addr >= cp15->dtcm_base && addr < cp15->dtcm_base + cp15->dtcm_size)
+        invalidate_code(addr);
+        addr = translate(addr, true);
+    }
+    cycles_left -= cycle_table->wait_states[addr >> 24];
+    uint8_t* page = map->get_write_page(addr);
+    if (page)
+    {
+        *(uint32_t*)&page[addr & MEMMAP_PAGE_MASK] = value;
+        e->mark_dirty(page);
+        e->invalidate_code(*this, addr);
+        return;
+    }
+    if (mpu_pages)
+    {
+        uint8_t* dtcm = check_mpu(addr, true);
+        if (dtcm)
         {
-            *(uint32_t*)&cp15->DTCM[addr & 0x3FFF] = value;
+            *(uint32_t*)dtcm = value;
+            e->mark_dirty(dtcm);
             return;
         }
     }
+    if (addr < itcm_size)
+    {
+        *(uint32_t*)&cp15->ITCM[addr & 0x7FFF] = value;
+        e->mark_dirty(&cp15->ITCM[addr & 0x7FFF]);
+        invalidate_itcm_code(addr);
+        return;
+    }
     if (id == 9)
         e->arm9_write32(addr, value);
     else
         e->arm11_write32(addr, value);
 }
 
+//Host memory backing [addr, addr + size) when it lies entirely within one page-table mapping, so block transfers
+//can skip the per-word lookup. Ranges straddling a mirror or touching I/O get nullptr and take the slow path.
+//The range is at most 64 bytes, so invalidating both ends covers every code page a write can touch.
+uint8_t* ARM_CPU::get_ram_block(uint32_t addr, uint32_t size, bool write)
+{
+    uint32_t end = addr + size - 1;
+    if (end < addr)
+        return nullptr;
+
+    //Neighbouring virtual pages needn't be neighbours physically
+    if (mmu_enabled)
+    {
+        if ((addr ^ end) >> 12)
+            return nullptr;
+        if (write)
+            invalidate_code(addr);
+        ARM_TLB_Entry& entry = tlb[(addr >> 12) & (ARM_TLB_ENTRIES - 1)];
+        if ((write ? entry.write_tag : entry.read_tag) == addr >> 12)
+            addr = entry.phys | (addr & MEMMAP_PAGE_MASK);
+        else
+            addr = translate(addr, write);
+        end = addr + size - 1;
+    }
+
+    uint8_t* block = map->get_block(addr, size, write);
+    if (block)
+    {
+        if (write)
+        {
+            e->invalidate_code(*this, addr);
+            e->invalidate_code(*this, end);
+            e->mark_dirty(block);
+            e->mark_dirty(block + size - 1);
+        }
+    }
+    else if (write && end < itcm_size && (addr & 0x7FFF) <= (end & 0x7FFF) &&
+             (!mpu_pages || (get_mpu_pages()[addr >> 12] & get_mpu_pages()[end >> 12] & MPU_WRITE)))
+    {
+        invalidate_itcm_code(addr);
+        invalidate_itcm_code(end);
+        block = &cp15->ITCM[addr & 0x7FFF];
+        e->mark_dirty(block);
+        e->mark_dirty(block + size - 1);
+    }
+    else
+        return nullptr;
+    cycles_left -= cycle_table->wait_states[addr >> 24] * (size / 4);
+    return block;
+}
+
 void ARM_CPU::andd(int destination, int source, int operand, bool set_condition_codes)
 {
     uint32_t result = source & operand;
@@ -509,7 +1753,7 @@ void ARM_CPU::sub(uint32_t destination, uint32_t source, uint32_t operand, bool
         {
             int index = static_cast<int>(CPSR.mode);
             update_reg_mode(SPSR[index].mode);
-            CPSR.set(SPSR[index].get());
+            CPSR = SPSR[index];
             jp(unsigned_result & 0xFFFFFFFF, false);
         }
         else
@@ -523,29 +1767,34 @@ void ARM_CPU::sub(uint32_t destination, uint32_t source, uint32_t operand, bool
     }
 }
 
+//The carry-in can't be expressed by the lazy add/sub forms, so ADC and SBC resolve their flags eagerly
 void ARM_CPU::adc(uint32_t destination, uint32_t source, uint32_t operand, bool set_condition_codes)
 {
-    uint8_t carry = (CPSR.carry) ? 1 : 0;
+    uint8_t carry = get_carry() ? 1 : 0;
     add(destination, source + carry, operand, set_condition_codes);
     if (set_condition_codes)
     {
+        CPSR.resolve_flags();
         uint32_t temp = source + operand;
         uint32_t res = temp + carry;
-        CPSR.carry = CARRY_ADD(source, operand) | CARRY_ADD(temp, carry);
-        CPSR.overflow = ADD_OVERFLOW(source, operand, temp) | ADD_OVERFLOW(temp, carry, res);
+        bool carry_out = CARRY_ADD(source, operand) | CARRY_ADD(temp, carry);
+        bool overflow = ADD_OVERFLOW(source, operand, temp) | ADD_OVERFLOW(temp, carry, res);
+        CPSR.nzcv = (CPSR.nzcv & (NZCV_N | NZCV_Z)) | (carry_out ? NZCV_C : 0) | (overflow ? NZCV_V : 0);
     }
 }
 
 void ARM_CPU::sbc(uint32_t destination, uint32_t source, uint32_t operand, bool set_condition_codes)
 {
-    unsigned int borrow = (CPSR.carry) ? 0 : 1;
+    unsigned int borrow = get_carry() ? 0 : 1;
     sub(destination, source, operand + borrow, set_condition_codes);
     if (set_condition_codes)
     {
+        CPSR.resolve_flags();
         uint32_t temp = source - operand;
         uint32_t res = temp - borrow;
-        CPSR.carry = CARRY_SUB(source, operand) & CARRY_SUB(temp, borrow);
-        CPSR.overflow = SUB_OVERFLOW(source, operand, temp) | SUB_OVERFLOW(temp, borrow, res);
+        bool carry_out = CARRY_SUB(source, operand) & CARRY_SUB(temp, borrow);
+        bool overflow = SUB_OVERFLOW(source, operand, temp) | SUB_OVERFLOW(temp, borrow, res);
+        CPSR.nzcv = (CPSR.nzcv & (NZCV_N | NZCV_Z)) | (carry_out ? NZCV_C : 0) | (overflow ? NZCV_V : 0);
     }
 }
 
@@ -559,20 +1808,6 @@ void ARM_CPU::teq(uint32_t x, uint32_t y)
     set_zero_neg_flags(x ^ y);
 }
 
-void ARM_CPU::cmn(uint32_t x, uint32_t y)
-{
-    uint32_t result = x + y;
-    set_zero_neg_flags(result);
-    set_CV_add_flags(x, y, result);
-}
-
-void ARM_CPU::cmp(uint32_t x, uint32_t y)
-{
-    uint32_t result = x - y;
-    set_zero_neg_flags(result);
-    set_CV_sub_flags(x, y, result);
-}
-
 void ARM_CPU::mov(uint32_t destination, uint32_t operand, bool alter_flags)
 {
     if (destination == REG_PC)
@@ -581,7 +1816,7 @@ void ARM_CPU::mov(uint32_t destination, uint32_t operand, bool alter_flags)
         {
             int index = static_cast<int>(CPSR.mode);
             update_reg_mode(SPSR[index].mode);
-            CPSR.set(SPSR[index].get());
+            CPSR = SPSR[index];
             jp(operand, false);
         }
         else
@@ -856,7 +2091,7 @@ uint32_t ARM_CPU::lsl(uint32_t value, int shift, bool alter_flags)
         if (alter_flags)
         {
             set_zero_neg_flags(0);
-            CPSR.carry = false;
+            set_carry(false);
         }
         return 0;
     }
@@ -865,7 +2100,7 @@ uint32_t ARM_CPU::lsl(uint32_t value, int shift, bool alter_flags)
         if (alter_flags)
         {
             set_zero_neg_flags(0);
-            CPSR.carry = value & (1 << 0);
+            set_carry(value & (1 << 0));
         }
         return 0;
     }
@@ -873,7 +2108,7 @@ uint32_t ARM_CPU::lsl(uint32_t value, int shift, bool alter_flags)
     if (alter_flags)
     {
         set_zero_neg_flags(result);
-        CPSR.carry = value & (1 << (32 - shift));
+        set_carry(value & (1 << (32 - shift)));
     }
     return value << shift;
 }
@@ -885,7 +2120,7 @@ uint32_t ARM_CPU::lsr(uint32_t value, int shift, bool alter_flags)
         if (alter_flags)
         {
             set_zero_neg_flags(0);
-            CPSR.carry = false;
+            set_carry(false);
         }
         return 0;
     }
@@ -896,7 +2131,7 @@ uint32_t ARM_CPU::lsr(uint32_t value, int shift, bool alter_flags)
     {
         set_zero_neg_flags(result);
         if (shift)
-            CPSR.carry = value & (1 << (shift - 1));
+            set_carry(value & (1 << (shift - 1)));
     }
     return result;
 }
@@ -906,7 +2141,7 @@ uint32_t ARM_CPU::lsr_32(uint32_t value, bool alter_flags)
     if (alter_flags)
     {
         set_zero_neg_flags(0);
-        CPSR.carry = value & (1 << 31);
+        set_carry(value & (1 << 31));
     }
     return 0;
 }
@@ -920,7 +2155,7 @@ uint32_t ARM_CPU::asr(uint32_t value, int shift, bool alter_flags)
     {
         set_zero_neg_flags(result);
         if (shift)
-            CPSR.carry = value & (1 << (shift - 1));
+            set_carry(value & (1 << (shift - 1)));
     }
     return result;
 }
@@ -931,7 +2166,7 @@ uint32_t ARM_CPU::asr_32(uint32_t value, bool alter_flags)
     if (alter_flags)
     {
         set_zero_neg_flags(result);
-        CPSR.carry = value & (1 << 31);
+        set_carry(value & (1 << 31));
     }
     return result;
 }
@@ -940,11 +2175,11 @@ uint32_t ARM_CPU::rrx(uint32_t value, bool alter_flags)
 {
     uint32_t result = value;
     result >>= 1;
-    result |= (CPSR.carry) ? (1 << 31) : 0;
+    result |= get_carry() ? (1 << 31) : 0;
     if (alter_flags)
     {
         set_zero_neg_flags(result);
-        CPSR.carry = value & 0x1;
+        set_carry(value & 0x1);
     }
     return result;
 }
@@ -956,9 +2191,9 @@ uint32_t ARM_CPU::rotr32(uint32_t n, unsigned int c, bool alter_flags)
     if (alter_flags && c)
     {
         if (c & 0x1F)
-            CPSR.carry = n & (1 << (c - 1));
+            set_carry(n & (1 << (c - 1)));
         else
-            CPSR.carry = n & (1 << 31);
+            set_carry(n & (1 << 31));
     }
     c &= mask;
 
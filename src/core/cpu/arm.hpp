@@ -1,13 +1,24 @@
 #ifndef ARM_HPP
 #define ARM_HPP
+#include <atomic>
 #include <cstdint>
 #include <string>
+#include <vector>
+#include "arm_interpret.hpp"
+#include "arm_jit.hpp"
+#include "arm_timing.hpp"
 #include "cp15.hpp"
 
 #define REG_SP 13
 #define REG_LR 14
 #define REG_PC 15
 
+#define ARM_BLOCK_ENTRIES 0x1000
+
+//Direct-mapped, indexed by the low bits of the virtual page number
+#define ARM_TLB_ENTRIES 0x400
+#define ARM_TLB_EMPTY 0xFFFFFFFF
+
 #define CARRY_ADD(a, b)  ((0xFFFFFFFF-a) < b)
 #define CARRY_SUB(a, b)  (a >= b)
 
@@ -25,50 +36,323 @@ enum PSR_MODE
     PSR_SYSTEM = 0x1F
 };
 
+//Bits of PSR_Flags::nzcv, which match CPSR bits 31-28
+#define NZCV_N 0x8
+#define NZCV_Z 0x4
+#define NZCV_C 0x2
+#define NZCV_V 0x1
+
+//How N/Z/C/V were last set. Anything other than FLAGS_READY means PSR_Flags::nzcv is stale.
+enum PSR_FLAG_OP
+{
+    FLAGS_READY,
+    FLAGS_NZ,
+    FLAGS_ADD,
+    FLAGS_SUB
+};
+
+//Banks of r8-r14. Only FIQ has its own r8-r12; the other modes share the ones kept in BANK_USER.
+enum REG_BANK
+{
+    BANK_USER,
+    BANK_FIQ,
+    BANK_IRQ,
+    BANK_SVC,
+    BANK_ABT,
+    BANK_UND,
+    REG_BANK_COUNT
+};
+
 struct PSR_Flags
 {
     PSR_MODE mode;
     bool thumb;
     bool fiq_disable, irq_disable;
 
-    bool negative;
-    bool zero;
-    bool carry;
-    bool overflow;
+    uint8_t nzcv;
     bool q_overflow;
 
+    //Flag-setting ALU ops only record their operands and result; nzcv is computed on first read
+    PSR_FLAG_OP flag_op;
+    uint32_t flag_a, flag_b, flag_result;
+
     uint32_t get();
     void set(uint32_t value);
+    void resolve_flags();
+    void compute_flags();
+};
+
+inline void PSR_Flags::resolve_flags()
+{
+    if (flag_op != FLAGS_READY)
+        compute_flags();
+}
+
+//Bit n of masks[cond] is set when cond passes with an NZCV value of n
+struct ARM_ConditionTable
+{
+    uint16_t masks[16];
+};
+
+constexpr bool condition_passes(int cond, int nzcv)
+{
+    bool n = nzcv & NZCV_N;
+    bool z = nzcv & NZCV_Z;
+    bool c = nzcv & NZCV_C;
+    bool v = nzcv & NZCV_V;
+    switch (cond)
+    {
+        case 0x0:
+            //EQ - equal
+            return z;
+        case 0x1:
+            //NE - not equal
+            return !z;
+        case 0x2:
+            //CS - unsigned higher or same
+            return c;
+        case 0x3:
+            //CC - unsigned lower
+            return !c;
+        case 0x4:
+            //MI - negative
+            return n;
+        case 0x5:
+            //PL - positive or zero
+            return !n;
+        case 0x6:
+            //VS - overflow
+            return v;
+        case 0x7:
+            //VC - no overflow
+            return !v;
+        case 0x8:
+            //HI - unsigned higher
+            return c && !z;
+        case 0x9:
+            //LS - unsigned lower or same
+            return !c || z;
+        case 0xA:
+            //GE - greater than or equal
+            return n == v;
+        case 0xB:
+            //LT - less than
+            return n != v;
+        case 0xC:
+            //GT - greater than
+            return !z && (n == v);
+        case 0xD:
+            //LE - less than or equal to
+            return z || (n != v);
+        default:
+            //AL, and the 0xF condition some instructions require
+            return true;
+    }
+}
+
+constexpr ARM_ConditionTable build_condition_table()
+{
+    ARM_ConditionTable table = {};
+    for (int cond = 0; cond < 16; cond++)
+    {
+        for (int nzcv = 0; nzcv < 16; nzcv++)
+        {
+            if (condition_passes(cond, nzcv))
+                table.masks[cond] |= 1 << nzcv;
+        }
+    }
+    return table;
+}
+
+static constexpr ARM_ConditionTable condition_table = build_condition_table();
+
+//Thrown once an abort has been entered, to cut the aborting instruction short. Caught by the core's run loop.
+struct ARM_Abort {};
+
+//A run of predecoded instructions that never crosses a 4 KB page
+struct ARM_Block
+{
+    uint32_t addr;
+    bool thumb;
+    int length;
+
+    //Set when user mode may not execute the block's page, so entering the block from there aborts
+    bool privileged;
+
+    //Set when the block only polls memory and branches back to itself, see ARM_CPU::is_idle_loop
+    bool idle_loop;
+    ARM_Predecoded instrs[ARM_BLOCK_MAX_INSTRS];
+
+    //Cycles taken by the first n instructions
+    uint16_t cycles[ARM_BLOCK_MAX_INSTRS + 1];
+};
+
+//A 4 KB page translated by the MMU. The tags hold its virtual page number only if mem can be accessed directly
+//that way, so a hit takes a single compare; read-only pages and I/O leave write_tag or both empty.
+struct ARM_TLB_Entry
+{
+    uint32_t read_tag, write_tag;
+    uint32_t phys;
+    uint8_t* mem;
 };
 
 class Emulator;
+class Fastmem;
+class Memory_Map;
 
 class ARM_CPU
 {
+    friend class ARM_JIT;
     private:
         Emulator* e;
         int id;
         uint32_t gpr[16];
-        bool halted;
-        bool can_disassemble;
-        bool int_pending;
+
+        //Devices on the other core's thread may raise or clear these while the core runs
+        std::atomic<bool> halted;
+        std::atomic<bool> int_pending;
+
+        //Set while the cores run on separate host threads. Interrupts are then only taken between blocks,
+        //by the core's own thread.
+        bool threaded;
 
         CP15* cp15;
 
-        uint32_t fiq_regs[5];
-        uint32_t SP_und, SP_irq, SP_svc, SP_fiq, SP_abt;
-        uint32_t LR_und, LR_irq, LR_svc, LR_fiq, LR_abt;
+        //Page table the core's own accesses go through: its bus's, or for a core with TCM, a copy of it with
+        //the TCMs mapped over. ITCM is mapped read-only there, so writes to it can drop cached ITCM code.
+        Memory_Map* map;
+        Memory_Map* bus_map;
+        Memory_Map* tcm_map;
+
+        //CP15's compiled protection unit regions, null on a core without one. Whatever they forbid in either
+        //mode is also taken out of tcm_map, so only accesses that miss it and fetches have to check them.
+        uint8_t* mpu_pages;
+        uint8_t* mpu_user_pages;
+
+        //Set when the protection unit allows every access the bus's page table does, so generated code
+        //can reach it directly
+        bool mpu_allows_bus;
+
+        //Where CP15 last put the TCMs, all 0 on a core without them
+        uint32_t itcm_size;
+        uint32_t dtcm_base, dtcm_size;
+
+        //Only the ARM11 has an MMU. Cached code is tagged by virtual address while it's on.
+        bool mmu_enabled;
+        ARM_TLB_Entry* tlb;
+
+        //r8-r14 of every mode that isn't current, indexed by REG_BANK
+        uint32_t banked_regs[REG_BANK_COUNT][7];
 
         PSR_Flags CPSR, SPSR[0x20];
+
+        //Cached blocks, hashed by start address
+        ARM_Block* blocks;
+
+        //One bit per 4 KB page that has blocks in it
+        uint8_t* code_pages;
+
+        //The core sharing the bus, whose code generated stores also have to look out for
+        ARM_CPU* other_core;
+
+        //ITCM is mirrored, so cached ITCM code is tracked by its offset within ITCM instead
+        uint8_t itcm_code_pages;
+
+        //One bit per 4 KB page, set until a write to the page has gone through write* and marked it dirty.
+        //Generated code stores to these through the slow path.
+        uint8_t* clean_pages;
+
+        //Set when cached code is invalidated, so the running block stops before a stale instruction
+        bool code_written;
+
+        //Cycles left in the current time slice; negative when the last block overran it
+        int cycles_left;
+
+        //Cycles run since reset, including time spent halted
+        uint64_t cycle_count;
+
+        const ARM_Cycle_Table* cycle_table;
+
+        //Set when an idle loop branched back to itself. Running it again can't change anything
+        //until another core or a device writes memory, so the rest of the slice is skipped.
+        bool spinning;
+
+        //Whether the last run() ended early because the core was halted or spinning
+        bool idle;
+
+        //Null when running on the interpreter
+        ARM_JIT* jit;
+        ARM_FastRAM fast_ram;
+
+        //Host mirror of the core's bus for generated code, or null to use fast_ram
+        Fastmem* fastmem;
+
+        //Tracing is a separate instantiation of the core loop, so the untraced one never checks for it.
+        //Trigger addresses are only looked at while building blocks, which end before each of them.
+        bool tracing;
+        void (ARM_CPU::*run_slice)();
+        std::vector<uint32_t> trace_triggers;
+
+        //Cycles a trace trigger took from the untraced loop, to be run on the traced one
+        int deferred_cycles;
+
+        template <bool trace> void run_cycles();
+        bool is_trace_trigger(uint32_t addr);
+        void trigger_trace();
+        static void trace_trigger_arm(ARM_CPU& cpu, uint32_t instr);
+        static void trace_trigger_thumb(ARM_CPU& cpu, uint16_t instr);
+
+        ARM_Block* get_block(uint32_t addr, bool thumb);
+        void build_block(ARM_Block* block, uint32_t addr, bool thumb);
+        void mark_code_page(uint32_t addr);
+        static bool is_idle_loop(ARM_Predecoded* instrs, int length, uint32_t addr, bool thumb);
+        int run_block();
+        static void sum_block_cycles(ARM_Predecoded* instrs, int length, uint16_t* cycles);
+        ARM_Predecoded* run_arm_instrs(ARM_Predecoded* instr, ARM_Predecoded* end);
+        ARM_Predecoded* run_thumb_instrs(ARM_Predecoded* instr, ARM_Predecoded* end);
+        int step();
+        void invalidate_code_page(uint32_t page);
+        void invalidate_itcm_page(uint32_t offset);
+        void invalidate_itcm_code(uint32_t addr);
+        void map_tcm();
+        void protect_pages(uint32_t first, uint32_t count);
+        void check_mpu_bus();
+        uint8_t* get_mpu_pages();
+        uint8_t* check_mpu(uint32_t addr, bool write);
+        void data_abort(uint32_t addr, bool write);
+        void prefetch_abort(uint32_t addr);
+        void enter_abort(uint32_t return_addr, uint32_t vector);
+        uint32_t translate(uint32_t addr, bool write);
+        uint8_t* tlb_read(uint32_t addr);
+        uint8_t* tlb_write(uint32_t addr);
     public:
         ARM_CPU(Emulator* e, int id, CP15* cp15);
+        ~ARM_CPU();
 
         static std::string get_reg_name(int id);
 
         void reset();
-        void run();
+        void run(int cycles);
+        bool is_idle();
+        void set_jit_enabled(bool enabled);
+        void set_threaded(bool enabled);
+        void set_tracing(bool enabled);
+        void add_trace_trigger(uint32_t addr);
+        void clear_trace_triggers();
+        void set_fast_ram(uint32_t base, uint32_t size, uint8_t* mem, bool writable);
+        void set_fastmem(Fastmem* fastmem);
+        void set_other_core(ARM_CPU* core);
+        void set_memory_map(Memory_Map* bus_map, bool has_tcm);
+        void update_memory_map();
+        void update_memory_map(uint32_t start, uint32_t size);
+        void update_tcm();
+        void update_mpu();
+        void set_mmu_enabled(bool enabled);
+        void flush_tlb();
         void print_state();
         int get_id();
+        uint64_t get_cycle_count();
+        const ARM_Cycle_Table& get_cycle_table();
 
         uint32_t get_PC();
         PSR_Flags* get_CPSR();
@@ -76,9 +360,12 @@ class ARM_CPU
         uint8_t read8(uint32_t addr);
         uint16_t read16(uint32_t addr);
         uint32_t read32(uint32_t addr);
+        uint16_t fetch16(uint32_t addr);
+        uint32_t fetch32(uint32_t addr);
         void write8(uint32_t addr, uint8_t value);
         void write16(uint32_t addr, uint16_t value);
         void write32(uint32_t addr, uint32_t value);
+        uint8_t* get_ram_block(uint32_t addr, uint32_t size, bool write);
 
         uint32_t get_register(int id);
         void set_register(int id, uint32_t value);
@@ -88,12 +375,17 @@ class ARM_CPU
         void halt();
         void unhalt();
 
+        void invalidate_code(uint32_t addr);
+        bool has_code(uint32_t addr);
+        void flush_code_cache();
+        void reset_clean_pages();
+
         void jp(uint32_t addr, bool change_thumb_state);
         void set_zero_neg_flags(uint32_t value);
         void set_zero(bool flag);
         void set_neg(bool flag);
-        void set_CV_add_flags(uint32_t a, uint32_t b, uint32_t result);
-        void set_CV_sub_flags(uint32_t a, uint32_t b, uint32_t result);
+        void set_carry(bool flag);
+        bool get_carry();
         void update_reg_mode(PSR_MODE mode);
         void spsr_to_cpsr();
         bool meets_condition(int cond);
@@ -138,6 +430,45 @@ inline int ARM_CPU::get_id()
     return id;
 }
 
+inline uint64_t ARM_CPU::get_cycle_count()
+{
+    return cycle_count;
+}
+
+inline const ARM_Cycle_Table& ARM_CPU::get_cycle_table()
+{
+    return *cycle_table;
+}
+
+//The protection unit's flags for the current mode
+inline uint8_t* ARM_CPU::get_mpu_pages()
+{
+    return (CPSR.mode == PSR_USER) ? mpu_user_pages : mpu_pages;
+}
+
+//Reads an instruction to predecode. Fetches are assumed to hit the caches, so unlike data reads they cost nothing.
+//Blocks never cross a page, so checking the protection unit here aborts exactly when the first instruction runs.
+//Fetches still go through the data path, so they need data read access as well.
+inline uint16_t ARM_CPU::fetch16(uint32_t addr)
+{
+    if (mpu_pages && !(get_mpu_pages()[addr >> 12] & MPU_EXEC))
+        prefetch_abort(addr);
+    int cycles = cycles_left;
+    uint16_t instr = read16(addr);
+    cycles_left = cycles;
+    return instr;
+}
+
+inline uint32_t ARM_CPU::fetch32(uint32_t addr)
+{
+    if (mpu_pages && !(get_mpu_pages()[addr >> 12] & MPU_EXEC))
+        prefetch_abort(addr);
+    int cycles = cycles_left;
+    uint32_t instr = read32(addr);
+    cycles_left = cycles;
+    return instr;
+}
+
 inline uint32_t ARM_CPU::get_register(int id)
 {
     return gpr[id];
@@ -148,6 +479,11 @@ inline void ARM_CPU::set_register(int id, uint32_t value)
     gpr[id] = value;
 }
 
+inline bool ARM_CPU::is_idle()
+{
+    return idle;
+}
+
 inline uint32_t ARM_CPU::get_PC()
 {
     return gpr[15];
@@ -158,14 +494,86 @@ inline PSR_Flags* ARM_CPU::get_CPSR()
     return &CPSR;
 }
 
+inline void ARM_CPU::invalidate_code(uint32_t addr)
+{
+    uint32_t page = addr >> 12;
+    if (code_pages[page >> 3] & (1 << (page & 0x7)))
+        invalidate_code_page(page);
+}
+
+//Also asked from the other core's thread, where a page being marked at the same moment can be missed.
+//That only happens if the guest writes code while the other core fetches it without synchronising.
+inline bool ARM_CPU::has_code(uint32_t addr)
+{
+    uint32_t page = addr >> 12;
+    return code_pages[page >> 3] & (1 << (page & 0x7));
+}
+
+inline void ARM_CPU::invalidate_itcm_code(uint32_t addr)
+{
+    uint32_t offset = (addr >> 12) & 0x7;
+    if (itcm_code_pages & (1 << offset))
+        invalidate_itcm_page(offset);
+}
+
+//C and V are left alone, so they have to be materialised if a pending add/sub still owns them
+inline void ARM_CPU::set_zero_neg_flags(uint32_t value)
+{
+    if (CPSR.flag_op > FLAGS_NZ)
+        CPSR.compute_flags();
+    CPSR.flag_op = FLAGS_NZ;
+    CPSR.flag_result = value;
+}
+
+inline void ARM_CPU::cmn(uint32_t x, uint32_t y)
+{
+    CPSR.flag_op = FLAGS_ADD;
+    CPSR.flag_a = x;
+    CPSR.flag_b = y;
+    CPSR.flag_result = x + y;
+}
+
+inline void ARM_CPU::cmp(uint32_t x, uint32_t y)
+{
+    CPSR.flag_op = FLAGS_SUB;
+    CPSR.flag_a = x;
+    CPSR.flag_b = y;
+    CPSR.flag_result = x - y;
+}
+
 inline void ARM_CPU::set_zero(bool flag)
 {
-    CPSR.zero = flag;
+    CPSR.resolve_flags();
+    CPSR.nzcv = (CPSR.nzcv & ~NZCV_Z) | (flag ? NZCV_Z : 0);
 }
 
 inline void ARM_CPU::set_neg(bool flag)
 {
-    CPSR.negative = flag;
+    CPSR.resolve_flags();
+    CPSR.nzcv = (CPSR.nzcv & ~NZCV_N) | (flag ? NZCV_N : 0);
+}
+
+//Only a pending add/sub owns C; after a logical op C is already materialised
+inline void ARM_CPU::set_carry(bool flag)
+{
+    if (CPSR.flag_op > FLAGS_NZ)
+        CPSR.compute_flags();
+    CPSR.nzcv = (CPSR.nzcv & ~NZCV_C) | (flag ? NZCV_C : 0);
+}
+
+inline bool ARM_CPU::get_carry()
+{
+    if (CPSR.flag_op > FLAGS_NZ)
+        CPSR.compute_flags();
+    return CPSR.nzcv & NZCV_C;
+}
+
+inline bool ARM_CPU::meets_condition(int cond)
+{
+    if (cond >= 0xE)
+        return true;
+    CPSR.resolve_flags();
+    return (condition_table.masks[cond] >> CPSR.nzcv) & 0x1;
 }
 
 #endif // ARM_HPP
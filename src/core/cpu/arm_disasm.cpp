@@ -5,135 +5,6 @@
 
 using namespace std;
 
-ARM_INSTR decode_arm(uint32_t instr)
-{
-    if ((instr & 0xFE5D0F00) == 0xF84D0500)
-        return ARM_SRS;
-
-    if ((instr & 0xFE500F00) == 0xF8100A00)
-        return ARM_RFE;
-
-    if ((instr & 0x0F000000) == 0x0A000000)
-        return ARM_B;
-
-    if ((instr & (0x0F000000)) >> 24 == 0xB)
-        return ARM_BL;
-
-    if ((instr & 0x0FFFFFFF) == 0x0320F003)
-        return ARM_WFI;
-
-    if (((instr >> 4) & 0x0FFFFFF) == 0x12FFF1)
-        return ARM_BX;
-
-    if (((instr >> 4) & 0x0FFFFFF) == 0x12FFF3)
-        return ARM_BLX;
-
-    if (((instr >> 16) & 0xFFF) == 0x16F)
-    {
-        if (((instr >> 4) & 0xFF) == 0xF1)
-            return ARM_CLZ;
-    }
-
-    if (((instr >> 4) & 0xFF) == 0x05)
-    {
-        if (((instr >> 24) & 0xF) == 0x1)
-        {
-            int op = (instr >> 20) & 0xF;
-            if (op == 0 || op == 2 || op == 4 || op == 6)
-                return ARM_SATURATED_OP;
-        }
-    }
-
-    if ((instr & 0x0FFF00F0) == 0x06EF0070)
-        return ARM_UXTB;
-
-    if ((instr & 0xFD70F000) == 0xF550F000)
-        return ARM_PLD;
-
-    if (((instr >> 26) & 0x3) == 0)
-    {
-        if ((instr & (1 << 25)) == 0)
-        {
-            if (((instr >> 4) & 0xFF) == 0x9)
-            {
-                if (((instr >> 23) & 0x1F) == 0x2 && (((instr >> 20) & 0x3) == 0))
-                    return ARM_SWAP;
-            }
-            if ((instr & (1 << 7)) != 0 && (instr & (1 << 4)) == 0)
-            {
-                if ((instr & (1 << 20)) == 0 && ((instr >> 23) & 0x3) == 0x2)
-                    return ARM_SIGNED_HALFWORD_MULTIPLY;
-            }
-            if ((instr & (1 << 7)) != 0 && (instr & (1 << 4)) != 0)
-            {
-                if (((instr >> 4) & 0xF) == 0x9)
-                {
-                    if (((instr >> 22) & 0x3F) == 0)
-                        return ARM_MULTIPLY;
-                    else if (((instr >> 23) & 0x1F) == 1)
-                        return ARM_MULTIPLY_LONG;
-                    return ARM_UNDEFINED;
-                }
-                else if ((instr & (1 << 6)) == 0 && ((instr & (1 << 5)) != 0))
-                {
-                    if ((instr & (1 << 20)) != 0)
-                        return ARM_LOAD_HALFWORD;
-                    else
-                        return ARM_STORE_HALFWORD;
-                }
-                else if ((instr & (1 << 6)) != 0 && ((instr & (1 << 5))) == 0)
-                {
-                    if ((instr & (1 << 20)) != 0)
-                        return ARM_LOAD_SIGNED_BYTE;
-                    else
-                        return ARM_LOAD_DOUBLEWORD;
-                }
-                else if ((instr & (1 << 6)) != 0 && ((instr & (1 << 5))) != 0)
-                {
-                    if ((instr & (1 << 20)) != 0)
-                        return ARM_LOAD_SIGNED_HALFWORD;
-                    else
-                        return ARM_STORE_DOUBLEWORD;
-                }
-                return ARM_UNDEFINED;
-            }
-        }
-        return ARM_DATA_PROCESSING;
-    }
-    else if ((instr & (0x0F000000)) >> 26 == 0x1)
-    {
-        if ((instr & (1 << 20)) == 0)
-        {
-            if ((instr & (1 << 22)) == 0)
-                return ARM_STORE_WORD;
-            else
-                return ARM_STORE_BYTE;
-        }
-        else
-        {
-            if ((instr & (1 << 22)) == 0)
-                return ARM_LOAD_WORD;
-            else
-                return ARM_LOAD_BYTE;
-        }
-    }
-    else if (((instr >> 25) & 0x7) == 0x4)
-    {
-        if ((instr & (1 << 20)) == 0)
-            return ARM_STORE_BLOCK;
-        else
-            return ARM_LOAD_BLOCK;
-    }
-    else if (((instr >> 24) & 0xF) == 0xE)
-    {
-        if ((instr & (1 << 4)) != 0)
-            return ARM_COP_REG_TRANSFER;
-        else
-            return ARM_COP_DATA_OP;
-    }
-    return ARM_UNDEFINED;
-}
-
 namespace ARM_Disasm
 {
 
@@ -1,6 +1,7 @@
 #ifndef ARM_DISASM_HPP
 #define ARM_DISASM_HPP
 
+#include <cstdint>
 #include <string>
 
 enum ARM_INSTR
@@ -82,8 +83,239 @@ enum THUMB_INSTR
     THUMB_SWI
 };
 
-ARM_INSTR decode_arm(uint32_t instr);
-THUMB_INSTR decode_thumb(uint16_t instr);
+constexpr ARM_INSTR decode_arm(uint32_t instr)
+{
+    if ((instr & 0xFE5D0F00) == 0xF84D0500)
+        return ARM_SRS;
+
+    if ((instr & 0xFE500F00) == 0xF8100A00)
+        return ARM_RFE;
+
+    if ((instr & 0x0F000000) == 0x0A000000)
+        return ARM_B;
+
+    if ((instr & (0x0F000000)) >> 24 == 0xB)
+        return ARM_BL;
+
+    if ((instr & 0x0FFFFFFF) == 0x0320F003)
+        return ARM_WFI;
+
+    if (((instr >> 4) & 0x0FFFFFF) == 0x12FFF1)
+        return ARM_BX;
+
+    if (((instr >> 4) & 0x0FFFFFF) == 0x12FFF3)
+        return ARM_BLX;
+
+    if (((instr >> 16) & 0xFFF) == 0x16F)
+    {
+        if (((instr >> 4) & 0xFF) == 0xF1)
+            return ARM_CLZ;
+    }
+
+    if (((instr >> 4) & 0xFF) == 0x05)
+    {
+        if (((instr >> 24) & 0xF) == 0x1)
+        {
+            int op = (instr >> 20) & 0xF;
+            if (op == 0 || op == 2 || op == 4 || op == 6)
+                return ARM_SATURATED_OP;
+        }
+    }
+
+    if ((instr & 0x0FFF00F0) == 0x06EF0070)
+        return ARM_UXTB;
+
+    if ((instr & 0xFD70F000) == 0xF550F000)
+        return ARM_PLD;
+
+    if (((instr >> 26) & 0x3) == 0)
+    {
+        if ((instr & (1 << 25)) == 0)
+        {
+            if (((instr >> 4) & 0xFF) == 0x9)
+            {
+                if (((instr >> 23) & 0x1F) == 0x2 && (((instr >> 20) & 0x3) == 0))
+                    return ARM_SWAP;
+            }
+            if ((instr & (1 << 7)) != 0 && (instr & (1 << 4)) == 0)
+            {
+                if ((instr & (1 << 20)) == 0 && ((instr >> 23) & 0x3) == 0x2)
+                    return ARM_SIGNED_HALFWORD_MULTIPLY;
+            }
+            if ((instr & (1 << 7)) != 0 && (instr & (1 << 4)) != 0)
+            {
+                if (((instr >> 4) & 0xF) == 0x9)
+                {
+                    if (((instr >> 22) & 0x3F) == 0)
+                        return ARM_MULTIPLY;
+                    else if (((instr >> 23) & 0x1F) == 1)
+                        return ARM_MULTIPLY_LONG;
+                    return ARM_UNDEFINED;
+                }
+                else if ((instr & (1 << 6)) == 0 && ((instr & (1 << 5)) != 0))
+                {
+                    if ((instr & (1 << 20)) != 0)
+                        return ARM_LOAD_HALFWORD;
+                    else
+                        return ARM_STORE_HALFWORD;
+                }
+                else if ((instr & (1 << 6)) != 0 && ((instr & (1 << 5))) == 0)
+                {
+                    if ((instr & (1 << 20)) != 0)
+                        return ARM_LOAD_SIGNED_BYTE;
+                    else
+                        return ARM_LOAD_DOUBLEWORD;
+                }
+                else if ((instr & (1 << 6)) != 0 && ((instr & (1 << 5))) != 0)
+                {
+                    if ((instr & (1 << 20)) != 0)
+                        return ARM_LOAD_SIGNED_HALFWORD;
+                    else
+                        return ARM_STORE_DOUBLEWORD;
+                }
+                return ARM_UNDEFINED;
+            }
+        }
+        return ARM_DATA_PROCESSING;
+    }
+    else if ((instr & (0x0F000000)) >> 26 == 0x1)
+    {
+        if ((instr & (1 << 20)) == 0)
+        {
+            if ((instr & (1 << 22)) == 0)
+                return ARM_STORE_WORD;
+            else
+                return ARM_STORE_BYTE;
+        }
+        else
+        {
+            if ((instr & (1 << 22)) == 0)
+                return ARM_LOAD_WORD;
+            else
+                return ARM_LOAD_BYTE;
+        }
+    }
+    else if (((instr >> 25) & 0x7) == 0x4)
+    {
+        if ((instr & (1 << 20)) == 0)
+            return ARM_STORE_BLOCK;
+        else
+            return ARM_LOAD_BLOCK;
+    }
+    else if (((instr >> 24) & 0xF) == 0xE)
+    {
+        if ((instr & (1 << 4)) != 0)
+            return ARM_COP_REG_TRANSFER;
+        else
+            return ARM_COP_DATA_OP;
+    }
+    return ARM_UNDEFINED;
+}
+
+//Only bits 15-6 are examined, which the Thumb dispatch table in thumb_interpret.cpp relies on
+constexpr THUMB_INSTR decode_thumb(uint16_t instr)
+{
+    uint16_t instr13 = instr >> 13;
+    uint16_t instr12 = instr >> 12;
+    uint16_t instr11 = instr >> 11;
+    uint16_t instr10 = instr >> 10;
+    switch (instr11)
+    {
+        case 0x4:
+            return THUMB_MOV_IMM;
+        case 0x5:
+            return THUMB_CMP_IMM;
+        case 0x6:
+            return THUMB_ADD_IMM;
+        case 0x7:
+            return THUMB_SUB_IMM;
+        case 0x9:
+            return THUMB_PC_REL_LOAD;
+        case 0x10:
+            return THUMB_STORE_HALFWORD;
+        case 0x11:
+            return THUMB_LOAD_HALFWORD;
+        case 0x12:
+            return THUMB_SP_REL_STORE;
+        case 0x13:
+            return THUMB_SP_REL_LOAD;
+        case 0x18:
+            return THUMB_STORE_MULTIPLE;
+        case 0x19:
+            return THUMB_LOAD_MULTIPLE;
+        case 0x1C:
+            return THUMB_BRANCH;
+        case 0x1D:
+            return THUMB_LONG_BLX;
+    }
+    if (instr13 == 0)
+    {
+        if ((instr11 & 0x3) != 0x3)
+            return THUMB_MOV_SHIFT;
+        else
+        {
+            if ((instr & (1 << 9)) != 0)
+                return THUMB_SUB_REG;
+            return THUMB_ADD_REG;
+        }
+    }
+    if (instr10 == 0x10)
+        return THUMB_ALU_OP;
+    if (instr10 == 0x11)
+        return THUMB_HI_REG_OP;
+    if (instr12 == 0x5)
+    {
+        if ((instr & (1 << 9)) == 0)
+        {
+            if ((instr & (1 << 11)) == 0)
+                return THUMB_STORE_REG_OFFSET;
+            return THUMB_LOAD_REG_OFFSET;
+        }
+        return THUMB_LOAD_STORE_SIGN_HALFWORD;
+    }
+    if (instr13 == 0x3)
+    {
+        if ((instr & (1 << 11)) == 0)
+            return THUMB_STORE_IMM_OFFSET;
+        return THUMB_LOAD_IMM_OFFSET;
+    }
+    if (instr12 == 0xA)
+        return THUMB_LOAD_ADDRESS;
+    if (instr12 == 0xB)
+    {
+        if (((instr >> 9) & 0x3) == 0x2)
+        {
+            if ((instr & (1 << 11)) != 0)
+                return THUMB_POP;
+            return THUMB_PUSH;
+        }
+        if (instr & (1 << 9))
+        {
+            int op = (instr >> 6) & 0x3;
+            switch (op)
+            {
+                case 0:
+                    return THUMB_SXTH;
+                case 1:
+                    return THUMB_SXTB;
+                case 2:
+                    return THUMB_UXTH;
+                case 3:
+                    return THUMB_UXTB;
+            }
+        }
+        return THUMB_OFFSET_SP;
+    }
+    if (instr12 == 0xD)
+        return THUMB_COND_BRANCH;
+    if (instr12 == 0xF)
+    {
+        if ((instr & (1 << 11)) == 0)
+            return THUMB_LONG_BRANCH_PREP;
+        return THUMB_LONG_BRANCH;
+    }
+    return THUMB_UNDEFINED;
+}
 
 class ARM_CPU;
 
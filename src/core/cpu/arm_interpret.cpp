@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <utility>
 #include "arm.hpp"
 #include "arm_disasm.hpp"
 #include "arm_interpret.hpp"
@@ -7,110 +8,513 @@
 namespace ARM_Interpreter
 {
 
-void interpret_arm(ARM_CPU &cpu, uint32_t instr)
+static constexpr ARM_Handler get_arm_handler(ARM_INSTR kind)
 {
-    int cond = instr >> 28;
+    switch (kind)
+    {
+        case ARM_SRS:
+            return arm_srs;
+        case ARM_RFE:
+            return arm_rfe;
+        case ARM_B:
+        case ARM_BL:
+            return arm_b;
+        case ARM_BX:
+            return arm_bx;
+        case ARM_BLX:
+            return arm_blx_reg;
+        case ARM_CLZ:
+            return arm_clz;
+        case ARM_UXTB:
+            return arm_uxtb;
+        case ARM_DATA_PROCESSING:
+            return arm_data_processing;
+        case ARM_SIGNED_HALFWORD_MULTIPLY:
+            return arm_signed_halfword_multiply;
+        case ARM_MULTIPLY:
+            return arm_mul;
+        case ARM_MULTIPLY_LONG:
+            return arm_mul_long;
+        case ARM_LOAD_BYTE:
+            return arm_load_byte;
+        case ARM_STORE_BYTE:
+            return arm_store_byte;
+        case ARM_LOAD_WORD:
+            return arm_load_word;
+        case ARM_STORE_WORD:
+            return arm_store_word;
+        case ARM_PLD:
+            //We don't emulate cache, so ignore
+            return arm_nop;
+        case ARM_LOAD_HALFWORD:
+            return arm_load_halfword;
+        case ARM_STORE_HALFWORD:
+            return arm_store_halfword;
+        case ARM_LOAD_SIGNED_BYTE:
+            return arm_load_signed_byte;
+        case ARM_LOAD_DOUBLEWORD:
+            return arm_load_doubleword;
+        case ARM_STORE_DOUBLEWORD:
+            return arm_store_doubleword;
+        case ARM_LOAD_BLOCK:
+            return arm_load_block;
+        case ARM_STORE_BLOCK:
+            return arm_store_block;
+        case ARM_COP_REG_TRANSFER:
+            return arm_cop_transfer;
+        case ARM_WFI:
+            return arm_wfi;
+        default:
+            return arm_undefined;
+    }
+}
 
-    if (cond == 0xF)
+//Key on bits 27-20 and 7-4, which is enough to tell apart nearly every ARM encoding
+static constexpr uint32_t arm_table_key(uint32_t instr)
+{
+    return ((instr >> 16) & 0xFF0) | ((instr >> 4) & 0xF);
+}
+
+//Single loads and stores have bits 27-26 set to 01, and take an immediate offset when bit 25 is clear.
+//Data processing takes a rotated immediate when bit 25 is set.
+void arm_extract_operands(uint32_t instr, ARM_Operands& ops)
+{
+    ops.rd = (instr >> 12) & 0xF;
+    ops.rn = (instr >> 16) & 0xF;
+    ops.rm = instr & 0xF;
+    ops.rs = (instr >> 8) & 0xF;
+    if ((instr & (1 << 26)) || !(instr & (1 << 25)))
     {
-        if ((instr & 0xFE000000) == 0xFA000000)
-        {
-            arm_blx(cpu, instr);
-            return;
-        }
-        if (cpu.get_id() == 11 && (instr >> 20) == 0xF10)
+        ops.shift = (instr >> 7) & 0x1F;
+        ops.imm = instr & 0xFFF;
+    }
+    else
+    {
+        //Immediate values are rotated right
+        unsigned int rotate = (instr & 0xF00) >> 7;
+        uint32_t value = instr & 0xFF;
+        ops.shift = rotate;
+        ops.imm = (value >> rotate) | (value << ((32 - rotate) & 0x1F));
+    }
+}
+
+//Operand 2 of a data processing instruction. Carry out is only written for flag-setting logical ops.
+template <bool imm, int shift_type, bool reg_shift, bool set_carry>
+static inline uint32_t arm_shifter_operand(ARM_CPU& cpu, const ARM_Operands& ops)
+{
+    if (imm)
+    {
+        if (set_carry && ops.shift)
+            cpu.set_carry(ops.imm >> 31);
+        return ops.imm;
+    }
+
+    uint32_t value = cpu.get_register(ops.rm);
+
+    //Register-specified shift amounts can exceed 31, so leave those to the general shifter
+    if (reg_shift)
+    {
+        int shift = cpu.get_register(ops.rs) & 0xFF;
+
+        //PC must take into account pipelining
+        if (ops.rm == REG_PC)
+            value = cpu.get_PC() + 4;
+
+        switch (shift_type)
         {
-            cpu.cps(instr);
-            return;
+            case 0:
+                return cpu.lsl(value, shift, set_carry);
+            case 1:
+                return cpu.lsr(value, shift, set_carry);
+            case 2:
+                return cpu.asr(value, shift, set_carry);
+            default:
+                if (shift == 0)
+                    return cpu.rrx(value, set_carry);
+                return cpu.rotr32(value, shift, set_carry);
         }
     }
 
-    if (!cpu.meets_condition(cond))
-        return;
-
-    switch (decode_arm(instr))
+    //An immediate shift of 0 means LSL #0, LSR #32, ASR #32 or RRX depending on the type
+    int shift = ops.shift;
+    uint32_t result;
+    bool carry;
+    switch (shift_type)
     {
-        case ARM_SRS:
-            cpu.srs(instr);
+        case 0:
+            if (!shift)
+                return value;
+            result = value << shift;
+            carry = value & (1 << (32 - shift));
             break;
-        case ARM_RFE:
-            cpu.rfe(instr);
+        case 1:
+            if (!shift)
+            {
+                result = 0;
+                carry = value >> 31;
+            }
+            else
+            {
+                result = value >> shift;
+                carry = value & (1 << (shift - 1));
+            }
             break;
-        case ARM_B:
-        case ARM_BL:
-            arm_b(cpu, instr);
+        case 2:
+            if (!shift)
+            {
+                result = static_cast<int32_t>(value) >> 31;
+                carry = value >> 31;
+            }
+            else
+            {
+                result = static_cast<int32_t>(value) >> shift;
+                carry = value & (1 << (shift - 1));
+            }
             break;
-        case ARM_BX:
-            arm_bx(cpu, instr);
+        default:
+            if (!shift)
+            {
+                result = (value >> 1) | (cpu.get_carry() ? (1 << 31) : 0);
+                carry = value & 0x1;
+            }
+            else
+            {
+                result = (value >> shift) | (value << (32 - shift));
+                carry = value & (1 << (shift - 1));
+            }
             break;
-        case ARM_BLX:
-            arm_blx_reg(cpu, instr);
+    }
+
+    if (set_carry)
+        cpu.set_carry(carry);
+    return result;
+}
+
+template <bool set_flags>
+static inline void arm_write_logical(ARM_CPU& cpu, int destination, uint32_t result)
+{
+    cpu.set_register(destination, result);
+    if (set_flags)
+        cpu.set_zero_neg_flags(result);
+}
+
+//One handler per opcode and operand form, so the hot path never branches on those instruction bits.
+//Writes to PC and the carry-in ops go through the ARM_CPU helpers, which handle the rare cases.
+template <int opcode, bool set_flags, bool imm, int shift_type, bool reg_shift>
+static inline void arm_data_processing_exec(ARM_CPU& cpu, uint32_t instr, const ARM_Operands& ops)
+{
+    //TST, TEQ, CMP and CMN without S are the PSR transfers
+    if (!set_flags && opcode >= 0x8 && opcode <= 0xB)
+    {
+        if (opcode & 0x1)
+            cpu.msr(instr);
+        else
+            cpu.mrs(instr);
+        return;
+    }
+
+    constexpr bool is_logical = opcode <= 0x1 || (opcode >= 0x8 && opcode <= 0x9) || opcode >= 0xC;
+    uint32_t operand = arm_shifter_operand<imm, shift_type, reg_shift, set_flags && is_logical>(cpu, ops);
+    uint32_t source = cpu.get_register(ops.rn);
+    int destination = ops.rd;
+
+    switch (opcode)
+    {
+        case 0x0:
+            arm_write_logical<set_flags>(cpu, destination, source & operand);
             break;
-        case ARM_CLZ:
-            arm_clz(cpu, instr);
+        case 0x1:
+            arm_write_logical<set_flags>(cpu, destination, source ^ operand);
             break;
-        case ARM_UXTB:
-            arm_uxtb(cpu, instr);
+        case 0x2:
+            if (destination == REG_PC)
+                cpu.sub(destination, source, operand, set_flags);
+            else
+            {
+                cpu.set_register(destination, source - operand);
+                if (set_flags)
+                    cpu.cmp(source, operand);
+            }
             break;
-        case ARM_DATA_PROCESSING:
-            arm_data_processing(cpu, instr);
+        case 0x3:
+            //Same as SUB, but switch the order of the operands
+            if (destination == REG_PC)
+                cpu.sub(destination, operand, source, set_flags);
+            else
+            {
+                cpu.set_register(destination, operand - source);
+                if (set_flags)
+                    cpu.cmp(operand, source);
+            }
             break;
-        case ARM_SIGNED_HALFWORD_MULTIPLY:
-            arm_signed_halfword_multiply(cpu, instr);
+        case 0x4:
+            if (destination == REG_PC)
+                cpu.add(destination, source, operand, set_flags);
+            else
+            {
+                cpu.set_register(destination, source + operand);
+                if (set_flags)
+                    cpu.cmn(source, operand);
+            }
             break;
-        case ARM_MULTIPLY:
-            arm_mul(cpu, instr);
+        case 0x5:
+            cpu.adc(destination, source, operand, set_flags);
             break;
-        case ARM_MULTIPLY_LONG:
-            arm_mul_long(cpu, instr);
+        case 0x6:
+            cpu.sbc(destination, source, operand, set_flags);
             break;
-        case ARM_LOAD_BYTE:
-            arm_load_byte(cpu, instr);
+        case 0x7:
+            cpu.sbc(destination, operand, source, set_flags);
             break;
-        case ARM_STORE_BYTE:
-            arm_store_byte(cpu, instr);
+        case 0x8:
+            cpu.set_zero_neg_flags(source & operand);
             break;
-        case ARM_LOAD_WORD:
-            arm_load_word(cpu, instr);
+        case 0x9:
+            cpu.set_zero_neg_flags(source ^ operand);
             break;
-        case ARM_STORE_WORD:
-            arm_store_word(cpu, instr);
+        case 0xA:
+            cpu.cmp(source, operand);
             break;
-        case ARM_PLD:
-            //We don't emulate cache, so ignore
+        case 0xB:
+            cpu.cmn(source, operand);
             break;
-        case ARM_LOAD_HALFWORD:
-            arm_load_halfword(cpu, instr);
+        case 0xC:
+            arm_write_logical<set_flags>(cpu, destination, source | operand);
             break;
-        case ARM_STORE_HALFWORD:
-            arm_store_halfword(cpu, instr);
+        case 0xD:
+            if (destination == REG_PC)
+                cpu.mov(destination, operand, set_flags);
+            else
+                arm_write_logical<set_flags>(cpu, destination, operand);
             break;
-        case ARM_LOAD_SIGNED_BYTE:
-            arm_load_signed_byte(cpu, instr);
+        case 0xE:
+            arm_write_logical<set_flags>(cpu, destination, source & ~operand);
             break;
-        case ARM_LOAD_DOUBLEWORD:
-            arm_load_doubleword(cpu, instr);
+        case 0xF:
+            arm_write_logical<set_flags>(cpu, destination, ~operand);
             break;
-        case ARM_STORE_DOUBLEWORD:
-            arm_store_doubleword(cpu, instr);
+    }
+}
+
+//Decodes the operands itself, for instructions run without a cached entry
+template <int opcode, bool set_flags, bool imm, int shift_type, bool reg_shift>
+static void arm_data_processing_op(ARM_CPU& cpu, uint32_t instr)
+{
+    ARM_Operands ops;
+    arm_extract_operands(instr, ops);
+    arm_data_processing_exec<opcode, set_flags, imm, shift_type, reg_shift>(cpu, instr, ops);
+}
+
+template <int opcode, bool set_flags, bool imm, int shift_type, bool reg_shift>
+static void arm_data_processing_predecoded(ARM_CPU& cpu, const ARM_Predecoded& instr)
+{
+    arm_data_processing_exec<opcode, set_flags, imm, shift_type, reg_shift>(cpu, instr.instr, instr.ops);
+}
+
+//Bits 25-20 and 7-4 of a data processing instruction, which are the low 10 bits of its arm_table_key.
+//Shift fields are ignored for immediate operands so those forms share one handler per opcode.
+#define DATA_PROCESSING_FORM(key) (key >> 5) & 0xF, (key >> 4) & 0x1, (key >> 9) & 0x1, \
+                                  (key & (1 << 9)) ? 0 : ((key >> 1) & 0x3), \
+                                  (key & (1 << 9)) ? false : (key & 0x1)
+
+template <uint32_t key>
+static constexpr ARM_Handler get_data_processing_handler()
+{
+    return arm_data_processing_op<DATA_PROCESSING_FORM(key)>;
+}
+
+template <uint32_t key>
+static constexpr ARM_Operand_Handler get_data_processing_operand_handler()
+{
+    return arm_data_processing_predecoded<DATA_PROCESSING_FORM(key)>;
+}
+
+struct ARM_DataProcessingTable
+{
+    ARM_Handler handlers[1024];
+    ARM_Operand_Handler operand_handlers[1024];
+};
+
+template <size_t... keys>
+static constexpr ARM_DataProcessingTable build_data_processing_table(std::index_sequence<keys...>)
+{
+    return {{ get_data_processing_handler<keys>()... }, { get_data_processing_operand_handler<keys>()... }};
+}
+
+static constexpr ARM_DataProcessingTable data_processing_table =
+        build_data_processing_table(std::make_index_sequence<1024>());
+
+struct ARM_Table
+{
+    ARM_Handler handlers[4096];
+    ARM_INSTR kinds[4096];
+};
+
+static constexpr ARM_Table build_arm_table()
+{
+    ARM_Table table = {};
+    for (uint32_t key = 0; key < 4096; key++)
+    {
+        uint32_t instr = 0xE0000000 | ((key & 0xFF0) << 16) | ((key & 0xF) << 4);
+
+        //BX, BLX, CLZ, UXTB and WFI are matched on bits outside the key. Probing with the
+        //remaining bits clear, set, and set to WFI's pattern finds every key where that matters.
+        ARM_INSTR kind = decode_arm(instr);
+        if (kind != decode_arm(instr | 0x000FFF0F) || kind != decode_arm(instr | 0x0000F003))
+        {
+            table.handlers[key] = arm_decode_full;
+            table.kinds[key] = ARM_UNDEFINED;
+        }
+        else
+        {
+            if (kind == ARM_DATA_PROCESSING)
+                table.handlers[key] = data_processing_table.handlers[key & 0x3FF];
+            else
+                table.handlers[key] = get_arm_handler(kind);
+            table.kinds[key] = kind;
+        }
+    }
+    return table;
+}
+
+static constexpr ARM_Table arm_table = build_arm_table();
+
+void interpret_arm(ARM_CPU &cpu, uint32_t instr)
+{
+    int cond = instr >> 28;
+    if (cond == 0xF)
+    {
+        ARM_Predecoded entry;
+        predecode_arm(cpu, instr, entry);
+        entry.handler(cpu, instr);
+        return;
+    }
+
+    if (cpu.meets_condition(cond))
+        arm_table.handlers[arm_table_key(instr)](cpu, instr);
+}
+
+void predecode_arm(ARM_CPU &cpu, uint32_t instr, ARM_Predecoded &entry)
+{
+    entry.instr = instr;
+    entry.cond = instr >> 28;
+
+    //SRS, RFE, PLD, BLX and CPS are only encodable with the 0xF condition, which the table doesn't cover
+    if (entry.cond == 0xF)
+    {
+        entry.kind = decode_arm(instr);
+        if ((instr & 0xFE000000) == 0xFA000000)
+            entry.handler = arm_blx;
+        else if (cpu.get_id() == 11 && (instr >> 20) == 0xF10)
+            entry.handler = arm_cps;
+        else
+            entry.handler = get_arm_handler(entry.kind);
+        entry.dispatch = ARM_UNDEFINED;
+    }
+    else
+    {
+        uint32_t key = arm_table_key(instr);
+        entry.kind = arm_table.kinds[key];
+        entry.handler = arm_table.handlers[key];
+        if (entry.handler == arm_decode_full)
+        {
+            entry.kind = decode_arm(instr);
+            entry.handler = get_arm_handler(entry.kind);
+        }
+        entry.dispatch = entry.kind;
+    }
+
+    entry.op_handler = nullptr;
+    switch (entry.kind)
+    {
+        case ARM_DATA_PROCESSING:
+            entry.op_handler = data_processing_table.operand_handlers[arm_table_key(instr) & 0x3FF];
+            arm_extract_operands(instr, entry.ops);
             break;
-        case ARM_LOAD_BLOCK:
-            arm_load_block(cpu, instr);
+        case ARM_LOAD_WORD:
+        case ARM_STORE_WORD:
+        case ARM_LOAD_BYTE:
+        case ARM_STORE_BYTE:
+            arm_extract_operands(instr, entry.ops);
             break;
-        case ARM_STORE_BLOCK:
-            arm_store_block(cpu, instr);
+        default:
             break;
+    }
+    entry.ends_block = arm_ends_block(instr, entry.kind);
+    entry.cycles = ARM_Timing::arm_cycles(cpu.get_cycle_table(), instr, entry.kind);
+}
+
+bool arm_ends_block(uint32_t instr, ARM_INSTR kind)
+{
+    if ((instr >> 28) == 0xF)
+        return kind != ARM_PLD;
+
+    switch (kind)
+    {
+        case ARM_DATA_PROCESSING:
+        {
+            //Writes to PC, and MSR since it can change the mode or unmask interrupts
+            int opcode = (instr >> 21) & 0xF;
+            bool set_condition_codes = instr & (1 << 20);
+            if (opcode >= 0x8 && opcode <= 0xB && !set_condition_codes)
+                return instr & (1 << 21);
+            return ((instr >> 12) & 0xF) == REG_PC;
+        }
+        case ARM_LOAD_WORD:
+            return ((instr >> 12) & 0xF) == REG_PC;
+        case ARM_LOAD_BLOCK:
+            return instr & ((1 << REG_PC) | (1 << 22));
+        case ARM_B:
+        case ARM_BL:
+        case ARM_BX:
+        case ARM_BLX:
         case ARM_COP_REG_TRANSFER:
-            arm_cop_transfer(cpu, instr);
-            break;
         case ARM_WFI:
-            cpu.halt();
-            break;
+        case ARM_UNDEFINED:
+            return true;
         default:
-            EmuException::die("[ARM_Interpreter] Undefined instr $%08X\n", instr);
+            return false;
     }
 }
 
+void arm_decode_full(ARM_CPU &cpu, uint32_t instr)
+{
+    get_arm_handler(decode_arm(instr))(cpu, instr);
+}
+
+void arm_undefined(ARM_CPU &cpu, uint32_t instr)
+{
+    (void)cpu;
+    EmuException::die("[ARM_Interpreter] Undefined instr $%08X\n", instr);
+}
+
+void arm_nop(ARM_CPU &cpu, uint32_t instr)
+{
+    (void)cpu;
+    (void)instr;
+}
+
+void arm_wfi(ARM_CPU &cpu, uint32_t instr)
+{
+    (void)instr;
+    cpu.halt();
+}
+
+void arm_cps(ARM_CPU &cpu, uint32_t instr)
+{
+    cpu.cps(instr);
+}
+
+void arm_srs(ARM_CPU &cpu, uint32_t instr)
+{
+    cpu.srs(instr);
+}
+
+void arm_rfe(ARM_CPU &cpu, uint32_t instr)
+{
+    cpu.rfe(instr);
+}
+
 void arm_b(ARM_CPU &cpu, uint32_t instr)
 {
     uint32_t address = cpu.get_PC();
@@ -199,166 +603,10 @@ void arm_uxtb(ARM_CPU &cpu, uint32_t instr)
     cpu.set_register(dest, source_reg & 0xFF);
 }
 
+//Used when the handler is chosen from the decoded kind rather than the table key
 void arm_data_processing(ARM_CPU &cpu, uint32_t instr)
 {
-    int opcode = (instr >> 21) & 0xF;
-    int first_operand = (instr >> 16) & 0xF;
-    uint32_t first_operand_contents = cpu.get_register(first_operand);
-    bool set_condition_codes = instr & (1 << 20);
-
-    int destination = (instr >> 12) & 0xF;
-    uint32_t second_operand;
-
-    bool is_operand_imm = instr & (1 << 25);
-    bool set_carry;
-    int shift;
-
-    switch (opcode)
-    {
-        case 0x0:
-        case 0x1:
-        case 0x8:
-        case 0x9:
-        case 0xC:
-        case 0xD:
-        case 0xE:
-        case 0xF:
-            set_carry = set_condition_codes;
-            break;
-        default:
-            set_carry = false;
-            break;
-    }
-
-    if (is_operand_imm)
-    {
-        //Immediate values are rotated right
-        second_operand = instr & 0xFF;
-        //shift = (instr >> 8) & 0xF;
-        shift = (instr & 0xF00) >> 7;
-
-        second_operand = cpu.rotr32(second_operand, shift, set_carry);
-    }
-    else
-    {
-        second_operand = instr & 0xF;
-        second_operand = cpu.get_register(second_operand);
-        int shift_type = (instr >> 5) & 0x3;
-
-        if (instr & (1 << 4))
-        {
-            shift = cpu.get_register((instr >> 8) & 0xF) & 0xFF;
-            //cpu.add_internal_cycles(1); //Extra cycle due to SHIFT(reg) operation
-
-            //PC must take into account pipelining
-            if ((instr & 0xF) == 15)
-                second_operand = cpu.get_PC() + 4;
-        }
-        else
-            shift = (instr >> 7) & 0x1F;
-
-        switch (shift_type)
-        {
-            case 0: //Logical shift left
-                second_operand = cpu.lsl(second_operand, shift, set_carry);
-                break;
-            case 1: //Logical shift right
-                if (shift || (instr & (1 << 4)))
-                    second_operand = cpu.lsr(second_operand, shift, set_carry);
-                else
-                    second_operand = cpu.lsr_32(second_operand, set_carry);
-                break;
-            case 2: //Arithmetic shift right
-                if (shift || (instr & (1 << 4)))
-                    second_operand = cpu.asr(second_operand, shift, set_carry);
-                else
-                    second_operand = cpu.asr_32(second_operand, set_carry);
-                break;
-            case 3: //Rotate right
-                if (shift == 0)
-                    second_operand = cpu.rrx(second_operand, set_carry);
-                else
-                    second_operand = cpu.rotr32(second_operand, shift, set_carry);
-                break;
-            default:
-                EmuException::die("[ARM_Interpreter] Invalid data processing shift: %d\n", shift_type);
-        }
-    }
-
-    switch (opcode)
-    {
-        case 0x0:
-            cpu.andd(destination, first_operand_contents, second_operand, set_condition_codes);
-            break;
-        case 0x1:
-            cpu.eor(destination, first_operand_contents, second_operand, set_condition_codes);
-            break;
-        case 0x2:
-            cpu.sub(destination, first_operand_contents, second_operand, set_condition_codes);
-            break;
-        case 0x3:
-            //Same as SUB, but switch the order of the operands
-            cpu.sub(destination, second_operand, first_operand_contents, set_condition_codes);
-            break;
-        case 0x4:
-            cpu.add(destination, first_operand_contents, second_operand, set_condition_codes);
-            break;
-        case 0x5:
-            cpu.adc(destination, first_operand_contents, second_operand, set_condition_codes);
-            break;
-        case 0x6:
-            cpu.sbc(destination, first_operand_contents, second_operand, set_condition_codes);
-            break;
-        case 0x7:
-            cpu.sbc(destination, second_operand, first_operand_contents, set_condition_codes);
-            break;
-        case 0x8:
-            if (set_condition_codes)
-            {
-                cpu.tst(first_operand_contents, second_operand);
-            }
-            else
-                cpu.mrs(instr);
-            break;
-        case 0x9:
-            if (set_condition_codes)
-            {
-                cpu.teq(first_operand_contents, second_operand);
-            }
-            else
-                cpu.msr(instr);
-            break;
-        case 0xA:
-            if (set_condition_codes)
-            {
-                cpu.cmp(first_operand_contents, second_operand);
-            }
-            else
-                cpu.mrs(instr);
-            break;
-        case 0xB:
-            if (set_condition_codes)
-            {
-                cpu.cmn(first_operand_contents, second_operand);
-            }
-            else
-                cpu.msr(instr);
-            break;
-        case 0xC:
-            cpu.orr(destination, first_operand_contents, second_operand, set_condition_codes);
-            break;
-        case 0xD:
-            cpu.mov(destination, second_operand, set_condition_codes);
-            break;
-        case 0xE:
-            cpu.bic(destination, first_operand_contents, second_operand, set_condition_codes);
-            break;
-        case 0xF:
-            cpu.mvn(destination, second_operand, set_condition_codes);
-            break;
-        default:
-            printf("Data processing opcode $%01X not recognized\n", opcode);
-    }
+    data_processing_table.handlers[arm_table_key(instr) & 0x3FF](cpu, instr);
 }
 
 void arm_signed_halfword_multiply(ARM_CPU &cpu, uint32_t instr)
@@ -520,11 +768,11 @@ void arm_mul_long(ARM_CPU &cpu, uint32_t instr)
     }
 }
 
-uint32_t load_store_shift_reg(ARM_CPU& cpu, uint32_t instr)
+static inline uint32_t load_store_shift_reg(ARM_CPU& cpu, uint32_t instr, const ARM_Operands& ops)
 {
-    int reg = cpu.get_register(instr & 0xF);
+    int reg = cpu.get_register(ops.rm);
     int shift_type = (instr >> 5) & 0x3;
-    int shift = (instr >> 7) & 0x1F;
+    int shift = ops.shift;
 
     switch (shift_type)
     {
@@ -554,10 +802,11 @@ uint32_t load_store_shift_reg(ARM_CPU& cpu, uint32_t instr)
     return reg;
 }
 
-void arm_load_byte(ARM_CPU &cpu, uint32_t instr)
+//Single loads and stores take their operand fields either from a cached entry or straight from the instruction
+static inline void load_byte(ARM_CPU &cpu, uint32_t instr, const ARM_Operands &ops)
 {
-    uint32_t base = (instr >> 16) & 0xF;
-    uint32_t destination = (instr >> 12) & 0xF;
+    uint32_t base = ops.rn;
+    uint32_t destination = ops.rd;
     uint32_t offset;
 
     bool is_imm = (instr & (1 << 25)) == 0;
@@ -566,9 +815,9 @@ void arm_load_byte(ARM_CPU &cpu, uint32_t instr)
     bool is_writing_back = instr & (1 << 21);
 
     if (is_imm)
-        offset = instr & 0xFFF;
+        offset = ops.imm;
     else
-        offset = load_store_shift_reg(cpu, instr);
+        offset = load_store_shift_reg(cpu, instr, ops);
 
     uint32_t address = cpu.get_register(base);
     //cpu.add_n16_data(address, 1);
@@ -581,10 +830,12 @@ void arm_load_byte(ARM_CPU &cpu, uint32_t instr)
         else
             address -= offset;
 
+        //The base is only written back once the access is done, as an abort leaves it untouched
+        uint8_t value = cpu.read8(address);
         if (is_writing_back)
             cpu.set_register(base, address);
 
-        cpu.set_register(destination, cpu.read8(address));
+        cpu.set_register(destination, value);
     }
     else
     {
@@ -600,10 +851,22 @@ void arm_load_byte(ARM_CPU &cpu, uint32_t instr)
     }
 }
 
-void arm_store_byte(ARM_CPU &cpu, uint32_t instr)
+void arm_load_byte(ARM_CPU &cpu, uint32_t instr)
 {
-    uint32_t base = (instr >> 16) & 0xF;
-    uint32_t source = (instr >> 12) & 0xF;
+    ARM_Operands ops;
+    arm_extract_operands(instr, ops);
+    load_byte(cpu, instr, ops);
+}
+
+void arm_load_byte(ARM_CPU &cpu, const ARM_Predecoded &instr)
+{
+    load_byte(cpu, instr.instr, instr.ops);
+}
+
+static inline void store_byte(ARM_CPU &cpu, uint32_t instr, const ARM_Operands &ops)
+{
+    uint32_t base = ops.rn;
+    uint32_t source = ops.rd;
     uint32_t offset;
 
     bool is_imm = (instr & (1 << 25)) == 0;
@@ -612,9 +875,9 @@ void arm_store_byte(ARM_CPU &cpu, uint32_t instr)
     bool is_writing_back = (instr & (1 << 21)) != 0;
 
     if (is_imm)
-        offset = instr & 0xFFF;
+        offset = ops.imm;
     else
-        offset = load_store_shift_reg(cpu, instr);
+        offset = load_store_shift_reg(cpu, instr, ops);
 
     uint32_t address = cpu.get_register(base);
     uint8_t value = cpu.get_register(source) & 0xFF;
@@ -628,10 +891,10 @@ void arm_store_byte(ARM_CPU &cpu, uint32_t instr)
         else
             address -= offset;
 
+        cpu.write8(address, value);
+
         if (is_writing_back)
             cpu.set_register(base, address);
-
-        cpu.write8(address, value);
     }
     else
     {
@@ -646,10 +909,22 @@ void arm_store_byte(ARM_CPU &cpu, uint32_t instr)
     }
 }
 
-void arm_load_word(ARM_CPU &cpu, uint32_t instr)
+void arm_store_byte(ARM_CPU &cpu, uint32_t instr)
 {
-    uint32_t base = (instr >> 16) & 0xF;
-    uint32_t destination = (instr >> 12) & 0xF;
+    ARM_Operands ops;
+    arm_extract_operands(instr, ops);
+    store_byte(cpu, instr, ops);
+}
+
+void arm_store_byte(ARM_CPU &cpu, const ARM_Predecoded &instr)
+{
+    store_byte(cpu, instr.instr, instr.ops);
+}
+
+static inline void load_word(ARM_CPU &cpu, uint32_t instr, const ARM_Operands &ops)
+{
+    uint32_t base = ops.rn;
+    uint32_t destination = ops.rd;
     uint32_t offset;
 
     bool is_imm = (instr & (1 << 25)) == 0;
@@ -658,9 +933,9 @@ void arm_load_word(ARM_CPU &cpu, uint32_t instr)
     bool is_writing_back = (instr & (1 << 21)) != 0;
 
     if (is_imm)
-        offset = instr & 0xFFF;
+        offset = ops.imm;
     else
-        offset = load_store_shift_reg(cpu, instr);
+        offset = load_store_shift_reg(cpu, instr, ops);
 
     uint32_t address = cpu.get_register(base);
     //cpu.add_n32_data(address, 1);
@@ -672,12 +947,12 @@ void arm_load_word(ARM_CPU &cpu, uint32_t instr)
         else
             address -= offset;
 
-        if (is_writing_back)
-            cpu.set_register(base, address);
-
         //TODO: What does ARM11 do on unaligned access?
         uint32_t word = cpu.rotr32(cpu.read32(address & ~0x3), (address & 0x3) * 8, false);
 
+        if (is_writing_back)
+            cpu.set_register(base, address);
+
         if (destination == REG_PC)
             cpu.jp(word, true);
         else
@@ -702,10 +977,22 @@ void arm_load_word(ARM_CPU &cpu, uint32_t instr)
     }
 }
 
-void arm_store_word(ARM_CPU &cpu, uint32_t instr)
+void arm_load_word(ARM_CPU &cpu, uint32_t instr)
 {
-    uint32_t base = (instr >> 16) & 0xF;
-    uint32_t source = (instr >> 12) & 0xF;
+    ARM_Operands ops;
+    arm_extract_operands(instr, ops);
+    load_word(cpu, instr, ops);
+}
+
+void arm_load_word(ARM_CPU &cpu, const ARM_Predecoded &instr)
+{
+    load_word(cpu, instr.instr, instr.ops);
+}
+
+static inline void store_word(ARM_CPU &cpu, uint32_t instr, const ARM_Operands &ops)
+{
+    uint32_t base = ops.rn;
+    uint32_t source = ops.rd;
     uint32_t offset;
 
     bool is_imm = (instr & (1 << 25)) == 0;
@@ -714,9 +1001,9 @@ void arm_store_word(ARM_CPU &cpu, uint32_t instr)
     bool is_writing_back = (instr & (1 << 21)) != 0;
 
     if (is_imm)
-        offset = instr & 0xFFF;
+        offset = ops.imm;
     else
-        offset = load_store_shift_reg(cpu, instr);
+        offset = load_store_shift_reg(cpu, instr, ops);
 
     uint32_t address = cpu.get_register(base);
     uint32_t value = cpu.get_register(source);
@@ -728,11 +1015,11 @@ void arm_store_word(ARM_CPU &cpu, uint32_t instr)
         else
             address -= offset;
 
-        if (is_writing_back)
-            cpu.set_register(base, address);
-
         //cpu.add_n32_data(address, 1);
         cpu.write32(address & ~0x3, value);
+
+        if (is_writing_back)
+            cpu.set_register(base, address);
     }
     else
     {
@@ -748,6 +1035,18 @@ void arm_store_word(ARM_CPU &cpu, uint32_t instr)
     }
 }
 
+void arm_store_word(ARM_CPU &cpu, uint32_t instr)
+{
+    ARM_Operands ops;
+    arm_extract_operands(instr, ops);
+    store_word(cpu, instr, ops);
+}
+
+void arm_store_word(ARM_CPU &cpu, const ARM_Predecoded &instr)
+{
+    store_word(cpu, instr.instr, instr.ops);
+}
+
 void arm_load_halfword(ARM_CPU &cpu, uint32_t instr)
 {
     bool is_preindexing = (instr & (1 << 24)) != 0;
@@ -774,10 +1073,11 @@ void arm_load_halfword(ARM_CPU &cpu, uint32_t instr)
         else
             address -= offset;
 
+        uint16_t halfword = cpu.read16(address);
         if (is_writing_back && base != destination)
             cpu.set_register(base, address);
 
-        cpu.set_register(destination, cpu.read16(address));
+        cpu.set_register(destination, halfword);
     }
     else
     {
@@ -863,10 +1163,10 @@ void arm_load_signed_byte(ARM_CPU &cpu, uint32_t instr)
         else
             address -= offset;
 
+        uint32_t word = static_cast<int32_t>(static_cast<int8_t>(cpu.read8(address)));
         if (is_writing_back)
             cpu.set_register(base, address);
 
-        uint32_t word = static_cast<int32_t>(static_cast<int8_t>(cpu.read8(address)));
         cpu.set_register(destination, word);
     }
     else
@@ -1004,6 +1304,36 @@ void arm_load_block(ARM_CPU &cpu, uint32_t instr)
             printf("LDM {%d}, $%04X", base, reg_list);
     }*/
 
+    //Fast path: when the whole range is plain RAM, resolve it once and copy the registers directly.
+    //Registers are stored in ascending order at ascending addresses whichever direction the base moves.
+    int count = count_regs(reg_list);
+    if (!load_PSR && count)
+    {
+        uint32_t end_address = is_adding_offset ? address + (count * 4) : address - (count * 4);
+        uint32_t start = is_adding_offset ? address : end_address;
+        if (is_preindexing == is_adding_offset)
+            start += 4;
+
+        uint8_t* mem = cpu.get_ram_block(start, count * 4, false);
+        if (mem)
+        {
+            for (int i = 0; i < 15; i++)
+            {
+                if (reg_list & (1 << i))
+                {
+                    cpu.set_register(i, *(uint32_t*)mem);
+                    mem += 4;
+                }
+            }
+            if (reg_list & (1 << 15))
+                cpu.jp(*(uint32_t*)mem, true);
+
+            if (is_writing_back && !((reg_list & (1 << base))))
+                cpu.set_register(base, end_address);
+            return;
+        }
+    }
+
     PSR_Flags* cpsr = cpu.get_CPSR();
     PSR_MODE old_mode = cpsr->mode;
     if (user_bank_transfer)
@@ -1125,6 +1455,32 @@ void arm_store_block(ARM_CPU &cpu, uint32_t instr)
     else
         offset = -4;
 
+    int count = count_regs(reg_list);
+    if (!load_PSR && count)
+    {
+        uint32_t end_address = is_adding_offset ? address + (count * 4) : address - (count * 4);
+        uint32_t start = is_adding_offset ? address : end_address;
+        if (is_preindexing == is_adding_offset)
+            start += 4;
+
+        uint8_t* mem = cpu.get_ram_block(start, count * 4, true);
+        if (mem)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                if (reg_list & (1 << i))
+                {
+                    *(uint32_t*)mem = cpu.get_register(i);
+                    mem += 4;
+                }
+            }
+
+            if (is_writing_back)
+                cpu.set_register(base, end_address);
+            return;
+        }
+    }
+
     PSR_Flags* cpsr = cpu.get_CPSR();
     PSR_MODE old_mode = cpsr->mode;
     if (user_bank_transfer)
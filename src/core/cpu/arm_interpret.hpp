@@ -1,12 +1,83 @@
 #ifndef ARM_INTERPRET_HPP
 #define ARM_INTERPRET_HPP
 #include <cstdint>
+#include "arm_disasm.hpp"
 
 class ARM_CPU;
+struct ARM_Predecoded;
+
+typedef void (*ARM_Handler)(ARM_CPU& cpu, uint32_t instr);
+typedef void (*Thumb_Handler)(ARM_CPU& cpu, uint16_t instr);
+typedef void (*ARM_Operand_Handler)(ARM_CPU& cpu, const ARM_Predecoded& instr);
+
+//Longest run of instructions the interpreter and the JIT decode as one block
+#define ARM_BLOCK_MAX_INSTRS 32
+
+//Operand fields of data processing and single loads and stores, pulled out of the instruction once
+struct ARM_Operands
+{
+    uint8_t rd, rn, rm, rs;
+
+    //Immediate shift amount, or the rotation of a data processing immediate
+    uint8_t shift;
+
+    //Data processing immediate, already rotated, or a load/store's immediate offset
+    uint32_t imm;
+};
+
+//One decoded instruction of a cached block. Thumb entries use thumb_handler and thumb_kind.
+struct ARM_Predecoded
+{
+    uint32_t instr;
+    union
+    {
+        ARM_Handler handler;
+        Thumb_Handler thumb_handler;
+    };
+    union
+    {
+        ARM_INSTR kind;
+        THUMB_INSTR thumb_kind;
+    };
+    uint8_t cond;
+
+    //Kind the block loop dispatches on. Zero (undefined) whenever the handler isn't the kind's usual one.
+    uint8_t dispatch;
+
+    //Cycles the instruction takes on this core, see ARM_Cycle_Table
+    uint8_t cycles;
+
+    //Set for instructions that branch or may change mode or interrupt state
+    bool ends_block;
+
+    //Filled in for ARM data processing and word/byte loads and stores, which the block loop runs from these
+    //fields rather than the raw instruction. op_handler is the data processing handler that takes them.
+    ARM_Operands ops;
+    ARM_Operand_Handler op_handler;
+};
 
 namespace ARM_Interpreter
 {
+    //Number of registers named in an LDM/STM/PUSH/POP register list
+    constexpr int count_regs(uint32_t reg_list)
+    {
+        int count = 0;
+        for (; reg_list; reg_list &= reg_list - 1)
+            count++;
+        return count;
+    }
+
     void interpret_arm(ARM_CPU& cpu, uint32_t instr);
+    void predecode_arm(ARM_CPU& cpu, uint32_t instr, ARM_Predecoded& entry);
+    void arm_extract_operands(uint32_t instr, ARM_Operands& ops);
+    bool arm_ends_block(uint32_t instr, ARM_INSTR kind);
+    void arm_decode_full(ARM_CPU& cpu, uint32_t instr);
+    void arm_undefined(ARM_CPU& cpu, uint32_t instr);
+    void arm_nop(ARM_CPU& cpu, uint32_t instr);
+    void arm_wfi(ARM_CPU& cpu, uint32_t instr);
+    void arm_cps(ARM_CPU& cpu, uint32_t instr);
+    void arm_srs(ARM_CPU& cpu, uint32_t instr);
+    void arm_rfe(ARM_CPU& cpu, uint32_t instr);
     void arm_b(ARM_CPU& cpu, uint32_t instr);
     void arm_bx(ARM_CPU& cpu, uint32_t instr);
     void arm_blx(ARM_CPU& cpu, uint32_t instr);
@@ -18,9 +89,13 @@ namespace ARM_Interpreter
     void arm_mul(ARM_CPU& cpu, uint32_t instr);
     void arm_mul_long(ARM_CPU& cpu, uint32_t instr);
     void arm_load_byte(ARM_CPU& cpu, uint32_t instr);
+    void arm_load_byte(ARM_CPU& cpu, const ARM_Predecoded& instr);
     void arm_store_byte(ARM_CPU& cpu, uint32_t instr);
+    void arm_store_byte(ARM_CPU& cpu, const ARM_Predecoded& instr);
     void arm_load_word(ARM_CPU& cpu, uint32_t instr);
+    void arm_load_word(ARM_CPU& cpu, const ARM_Predecoded& instr);
     void arm_store_word(ARM_CPU& cpu, uint32_t instr);
+    void arm_store_word(ARM_CPU& cpu, const ARM_Predecoded& instr);
     void arm_load_halfword(ARM_CPU& cpu, uint32_t instr);
     void arm_store_halfword(ARM_CPU& cpu, uint32_t instr);
     void arm_load_signed_byte(ARM_CPU& cpu, uint32_t instr);
@@ -31,6 +106,9 @@ namespace ARM_Interpreter
     void arm_cop_transfer(ARM_CPU& cpu, uint32_t instr);
 
     void interpret_thumb(ARM_CPU& cpu, uint16_t instr);
+    void predecode_thumb(ARM_CPU& cpu, uint16_t instr, ARM_Predecoded& entry);
+    bool thumb_ends_block(uint16_t instr, THUMB_INSTR kind);
+    void thumb_undefined(ARM_CPU& cpu, uint16_t instr);
     void thumb_move_shift(ARM_CPU& cpu, uint16_t instr);
     void thumb_add_reg(ARM_CPU& cpu, uint16_t instr);
     void thumb_sub_reg(ARM_CPU& cpu, uint16_t instr);
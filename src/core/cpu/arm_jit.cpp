@@ -0,0 +1,1561 @@
+#include <cstddef>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#include "arm.hpp"
+#include "arm_jit.hpp"
+#include "../common/common.hpp"
+#include "../fastmem.hpp"
+
+#ifdef FASTMEM_SUPPORTED
+#include <signal.h>
+#include <ucontext.h>
+#endif
+
+//Same hash as the interpreter's block cache, so static branch targets can be looked up at compile time
+static inline uint32_t block_index(uint32_t addr)
+{
+    return ((addr >> 1) ^ (addr >> 13)) & (JIT_BLOCK_ENTRIES - 1);
+}
+
+//Whether a data processing op sets flags or reads C through RRX
+static bool arm_touches_flags(uint32_t instr)
+{
+    if (instr & (1 << 20))
+        return true;
+    return !(instr & (1 << 25)) && (instr & 0xFF0) == 0x060;
+}
+
+static uint8_t* alloc_executable(size_t size)
+{
+#ifdef _WIN32
+    return (uint8_t*)VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return nullptr;
+    return (uint8_t*)mem;
+#endif
+}
+
+static void free_executable(uint8_t* mem, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(mem, 0, MEM_RELEASE);
+#else
+    munmap(mem, size);
+#endif
+}
+
+#ifdef FASTMEM_SUPPORTED
+//Recompilers whose code may fault on a fastmem access. Only changed while no generated code runs.
+static std::vector<ARM_JIT*> fault_jits;
+static struct sigaction old_segv_action;
+
+//A fastmem access that hit I/O or unmapped memory resumes at its slow path instead.
+//Any other fault isn't ours, so the previous handler is put back and the access faults again into it.
+static void handle_segv(int sig, siginfo_t* info, void* raw_context)
+{
+    (void)sig;
+    (void)info;
+    ucontext_t* context = (ucontext_t*)raw_context;
+    uint8_t* host_pc = (uint8_t*)context->uc_mcontext.gregs[REG_RIP];
+    for (unsigned int i = 0; i < fault_jits.size(); i++)
+    {
+        uint8_t* target = fault_jits[i]->handle_fault(host_pc);
+        if (target)
+        {
+            context->uc_mcontext.gregs[REG_RIP] = (greg_t)target;
+            return;
+        }
+    }
+    sigaction(SIGSEGV, &old_segv_action, nullptr);
+}
+
+static void add_fault_jit(ARM_JIT* jit)
+{
+    if (fault_jits.empty())
+    {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = handle_segv;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, &old_segv_action);
+    }
+    fault_jits.push_back(jit);
+}
+
+static void remove_fault_jit(ARM_JIT* jit)
+{
+    for (unsigned int i = 0; i < fault_jits.size(); i++)
+    {
+        if (fault_jits[i] == jit)
+        {
+            fault_jits.erase(fault_jits.begin() + i);
+            break;
+        }
+    }
+    if (fault_jits.empty())
+        sigaction(SIGSEGV, &old_segv_action, nullptr);
+}
+#endif
+
+ARM_JIT::ARM_JIT(ARM_CPU* cpu) : cpu(cpu)
+{
+    code_buffer = alloc_executable(JIT_CODE_SIZE);
+    if (!code_buffer)
+        EmuException::die("[ARM_JIT] Failed to allocate %d bytes of executable memory", JIT_CODE_SIZE);
+    blocks = new JIT_Block[JIT_BLOCK_ENTRIES];
+    exception_thrown = false;
+
+    emitter.set_buffer(code_buffer, JIT_CODE_SIZE);
+    emit_entry_exit();
+    code_start = emitter.get_ptr();
+    flush();
+#ifdef FASTMEM_SUPPORTED
+    add_fault_jit(this);
+#endif
+}
+
+ARM_JIT::~ARM_JIT()
+{
+#ifdef FASTMEM_SUPPORTED
+    remove_fault_jit(this);
+#endif
+    free_executable(code_buffer, JIT_CODE_SIZE);
+    delete[] blocks;
+}
+
+void ARM_JIT::run()
+{
+    bool thumb = cpu->CPSR.thumb;
+    uint32_t addr = cpu->gpr[15] - (thumb ? 2 : 4);
+    JIT_Block* block = &blocks[block_index(addr)];
+    if (block->tag != (addr | thumb))
+        compile(block, addr, thumb);
+
+    enter_code(cpu, block->code);
+
+    if (exception_thrown)
+    {
+        std::exception_ptr exception = pending_exception;
+        pending_exception = nullptr;
+        exception_thrown = false;
+        std::rethrow_exception(exception);
+    }
+}
+
+//May be called from generated code, which keeps running its block until the next check.
+//Nothing is overwritten until the next compile, and that only happens outside generated code.
+void ARM_JIT::flush()
+{
+    //0xFFFFFFFF is never a valid tag, as ARM blocks are word aligned
+    for (int i = 0; i < JIT_BLOCK_ENTRIES; i++)
+        blocks[i].tag = 0xFFFFFFFF;
+    emitter.set_buffer(code_start, JIT_CODE_SIZE - (code_start - code_buffer));
+}
+
+void ARM_JIT::invalidate_page(uint32_t page)
+{
+    for (int i = 0; i < JIT_BLOCK_ENTRIES; i++)
+    {
+        if ((blocks[i].tag >> 12) == page)
+            blocks[i].tag = 0xFFFFFFFF;
+    }
+}
+
+void ARM_JIT::invalidate_itcm_page(uint32_t offset, uint32_t itcm_size)
+{
+    for (int i = 0; i < JIT_BLOCK_ENTRIES; i++)
+    {
+        uint32_t addr = blocks[i].tag & ~0x1;
+        if (addr < itcm_size && ((addr >> 12) & 0x7) == offset)
+            blocks[i].tag = 0xFFFFFFFF;
+    }
+}
+
+//Called from the fault handler, on the thread that ran the faulting code. Only that thread compiles into this
+//buffer, so nothing else touches it meanwhile. An access that hit I/O once most likely always will, and a fault
+//costs far more than a call, so the access is patched into a jump to its slow path.
+uint8_t* ARM_JIT::handle_fault(uint8_t* host_pc)
+{
+    if (host_pc < code_buffer || host_pc >= code_buffer + JIT_CODE_SIZE)
+        return nullptr;
+    std::unordered_map<uint8_t*, uint8_t*>::iterator target = fault_targets.find(host_pc);
+    if (target == fault_targets.end())
+        return nullptr;
+
+    uint8_t* slow = target->second;
+    int32_t offset = (int32_t)(slow - (host_pc + JIT_FASTMEM_PATCH_SIZE));
+    host_pc[0] = 0xE9;
+    memcpy(&host_pc[1], &offset, sizeof(offset));
+    return slow;
+}
+
+int32_t ARM_JIT::offset_of(void* member)
+{
+    return (int32_t)((uint8_t*)member - (uint8_t*)cpu);
+}
+
+int32_t ARM_JIT::reg_offset(int reg)
+{
+    return offset_of(&cpu->gpr[reg]);
+}
+
+//TCM takes priority over the rest of the address space, so RAM it covers must go through read*/write*.
+//Both fast paths take physical addresses, so they're off while the MMU is on, and they skip the protection unit,
+//so they're also off while it forbids anything on the bus.
+bool ARM_JIT::fast_ram_usable()
+{
+    ARM_FastRAM& fast_ram = cpu->fast_ram;
+    if (!fast_ram.mem || cpu->mmu_enabled || !cpu->mpu_allows_bus)
+        return false;
+    if (fast_ram.base < cpu->itcm_size)
+        return false;
+    if (fast_ram.base < cpu->dtcm_base + cpu->dtcm_size && cpu->dtcm_base < fast_ram.base + fast_ram.size)
+        return false;
+    return true;
+}
+
+//Same for fastmem: TCM covering any mapped page would be bypassed, so such layouts use the slow path
+bool ARM_JIT::fastmem_usable()
+{
+    Fastmem* fastmem = cpu->fastmem;
+    if (!fastmem || !fastmem->get_base() || cpu->mmu_enabled || !cpu->mpu_allows_bus)
+        return false;
+    if (fastmem->is_mapped(0, cpu->itcm_size))
+        return false;
+    if (fastmem->is_mapped(cpu->dtcm_base, cpu->dtcm_size))
+        return false;
+    return true;
+}
+
+//Value of PC while the current instruction executes
+uint32_t ARM_JIT::pc_value()
+{
+    return instr_addr + (thumb ? 4 : 8);
+}
+
+void ARM_JIT::emit_entry_exit()
+{
+    //RBX holds the ARM_CPU for the lifetime of the generated code.
+    //Four pushes plus the 40 byte frame keep RSP 16-byte aligned and leave Win64 shadow space.
+    enter_code = (void (*)(ARM_CPU*, uint8_t*))emitter.get_ptr();
+    emitter.push(RBX);
+    emitter.push(R12);
+    emitter.push(R13);
+    emitter.push(R14);
+    emitter.alu64_reg_imm(ALU_SUB, RSP, 40);
+    emitter.mov64_reg_reg(RBX, ABI_PARAM1);
+    emitter.jmp_reg(ABI_PARAM2);
+
+    exit_code = emitter.get_ptr();
+    emitter.alu64_reg_imm(ALU_ADD, RSP, 40);
+    emitter.pop(R14);
+    emitter.pop(R13);
+    emitter.pop(R12);
+    emitter.pop(RBX);
+    emitter.ret();
+}
+
+void ARM_JIT::compile(JIT_Block *block, uint32_t addr, bool thumb)
+{
+    if (emitter.get_space_left() < JIT_MAX_BLOCK_SIZE)
+        flush();
+
+    //Everything after the start of the buffer is gone once compiling starts over there
+    if (emitter.get_ptr() == code_start)
+        fault_targets.clear();
+
+    this->thumb = thumb;
+    lr_known = false;
+    use_fastmem = fastmem_usable();
+    exits.clear();
+    slow_accesses.clear();
+
+    uint8_t* code = emitter.get_ptr();
+
+    //Same as the interpreter: a trace trigger gets a block of its own that only hands over to the traced loop
+    if (cpu->is_trace_trigger(addr))
+    {
+        ARM_CPU::sum_block_cycles(nullptr, 0, block_cycles);
+        emitter.mov64_reg_reg(ABI_PARAM1, RBX);
+        emitter.mov64_reg_imm(RAX, (uint64_t)&ARM_JIT::trigger_trace);
+        emitter.call_reg(RAX);
+        emit_exit(0);
+
+        block->tag = addr | thumb;
+        block->code = code;
+        cpu->mark_code_page(addr);
+        return;
+    }
+
+    emitter.mov8_mem_imm(RBX, offset_of(&cpu->code_written), 0);
+
+    //Decode the whole block first, as idle loop detection needs to see all of it
+    ARM_Predecoded instrs[ARM_BLOCK_MAX_INSTRS];
+    int length = 0;
+    uint32_t page = addr >> 12;
+    instr_addr = addr;
+    while (length < ARM_BLOCK_MAX_INSTRS && (instr_addr >> 12) == page)
+    {
+        if (length && cpu->is_trace_trigger(instr_addr))
+            break;
+
+        if (thumb)
+        {
+            ARM_Interpreter::predecode_thumb(*cpu, cpu->fetch16(instr_addr), instrs[length]);
+            instr_addr += 2;
+        }
+        else
+        {
+            ARM_Interpreter::predecode_arm(*cpu, cpu->fetch32(instr_addr), instrs[length]);
+            instr_addr += 4;
+        }
+        length++;
+        if (instrs[length - 1].ends_block)
+            break;
+    }
+    block_addr = addr;
+    idle_loop = ARM_CPU::is_idle_loop(instrs, length, addr, thumb);
+    ARM_CPU::sum_block_cycles(instrs, length, block_cycles);
+
+    //Links skip the dispatcher, so a block only privileged code may execute checks the mode itself
+    if (cpu->mpu_user_pages && !(cpu->mpu_user_pages[page] & MPU_EXEC))
+        emit_privileged_check();
+
+    instr_addr = addr;
+    for (instr_index = 0; instr_index < length; instr_index++)
+    {
+        if (thumb)
+            compile_thumb(instrs[instr_index]);
+        else
+            compile_arm(instrs[instr_index]);
+        instr_addr += thumb ? 2 : 4;
+    }
+
+    emit_link(instr_addr, instr_index);
+    emit_slow_accesses();
+    emit_exit_stubs();
+
+    block->tag = addr | thumb;
+    block->code = code;
+    cpu->mark_code_page(addr);
+}
+
+bool ARM_JIT::compile_arm(ARM_Predecoded &instr)
+{
+    std::vector<uint8_t*> skips;
+    bool native = false;
+    lr_known = false;
+
+    //The 0xF condition marks unconditional encodings, which are all left to the interpreter
+    if (instr.cond != 0xF)
+    {
+        if (instr.cond != 0xE || (instr.kind == ARM_DATA_PROCESSING && arm_touches_flags(instr.instr)))
+            emit_resolve_flags();
+        emit_condition_check(instr.cond, skips);
+        switch (instr.kind)
+        {
+            case ARM_DATA_PROCESSING:
+                native = compile_arm_data_processing(instr.instr);
+                break;
+            case ARM_LOAD_WORD:
+            case ARM_STORE_WORD:
+            case ARM_LOAD_BYTE:
+            case ARM_STORE_BYTE:
+                native = compile_arm_load_store(instr.instr, instr.kind);
+                break;
+            case ARM_B:
+            case ARM_BL:
+                native = compile_arm_branch(instr.instr);
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!native)
+        emit_call_handler(instr);
+
+    for (unsigned int i = 0; i < skips.size(); i++)
+        emitter.set_target(skips[i]);
+    return native;
+}
+
+bool ARM_JIT::compile_thumb(ARM_Predecoded &instr)
+{
+    uint16_t op = instr.instr;
+    bool native = false;
+    bool prev_lr_known = lr_known;
+    lr_known = false;
+
+    switch (instr.thumb_kind)
+    {
+        case THUMB_MOV_SHIFT:
+        case THUMB_ADD_REG:
+        case THUMB_SUB_REG:
+        case THUMB_MOV_IMM:
+        case THUMB_CMP_IMM:
+        case THUMB_ADD_IMM:
+        case THUMB_SUB_IMM:
+        case THUMB_ALU_OP:
+        case THUMB_HI_REG_OP:
+        case THUMB_COND_BRANCH:
+            emit_resolve_flags();
+            break;
+        default:
+            break;
+    }
+
+    switch (instr.thumb_kind)
+    {
+        case THUMB_MOV_SHIFT:
+            load_reg(RCX, (op >> 3) & 0x7);
+            emit_shift_imm(RCX, (op >> 11) & 0x3, (op >> 6) & 0x1F, true);
+            emitter.test32_reg_reg(RCX, RCX);
+            emit_set_nz();
+            store_reg(op & 0x7, RCX);
+            native = true;
+            break;
+        case THUMB_ADD_REG:
+        case THUMB_SUB_REG:
+        {
+            bool add = instr.thumb_kind == THUMB_ADD_REG;
+            load_reg(RAX, (op >> 3) & 0x7);
+            if (op & (1 << 10))
+                emitter.alu32_reg_imm(add ? ALU_ADD : ALU_SUB, RAX, (op >> 6) & 0x7);
+            else
+                emitter.alu32_reg_mem(add ? ALU_ADD : ALU_SUB, RAX, RBX, reg_offset((op >> 6) & 0x7));
+            if (add)
+                emit_set_nzcv_add();
+            else
+                emit_set_nzcv_sub();
+            store_reg(op & 0x7, RAX);
+            native = true;
+            break;
+        }
+        case THUMB_MOV_IMM:
+            emitter.mov32_mem_imm(RBX, reg_offset((op >> 8) & 0x7), op & 0xFF);
+            emitter.alu8_mem_imm(ALU_AND, RBX, offset_of(&cpu->CPSR.nzcv), NZCV_C | NZCV_V);
+            if (!(op & 0xFF))
+                emitter.alu8_mem_imm(ALU_OR, RBX, offset_of(&cpu->CPSR.nzcv), NZCV_Z);
+            native = true;
+            break;
+        case THUMB_CMP_IMM:
+            load_reg(RAX, (op >> 8) & 0x7);
+            emitter.alu32_reg_imm(ALU_SUB, RAX, op & 0xFF);
+            emit_set_nzcv_sub();
+            native = true;
+            break;
+        case THUMB_ADD_IMM:
+        case THUMB_SUB_IMM:
+        {
+            bool add = instr.thumb_kind == THUMB_ADD_IMM;
+            load_reg(RAX, (op >> 8) & 0x7);
+            emitter.alu32_reg_imm(add ? ALU_ADD : ALU_SUB, RAX, op & 0xFF);
+            if (add)
+                emit_set_nzcv_add();
+            else
+                emit_set_nzcv_sub();
+            store_reg((op >> 8) & 0x7, RAX);
+            native = true;
+            break;
+        }
+        case THUMB_ALU_OP:
+            native = compile_thumb_alu(op);
+            break;
+        case THUMB_HI_REG_OP:
+            native = compile_thumb_hi_reg_op(op);
+            break;
+        case THUMB_PC_REL_LOAD:
+        case THUMB_LOAD_IMM_OFFSET:
+        case THUMB_STORE_IMM_OFFSET:
+        case THUMB_LOAD_REG_OFFSET:
+        case THUMB_STORE_REG_OFFSET:
+        case THUMB_SP_REL_LOAD:
+        case THUMB_SP_REL_STORE:
+        case THUMB_LOAD_HALFWORD:
+        case THUMB_STORE_HALFWORD:
+            native = compile_thumb_load_store(op, instr.thumb_kind);
+            break;
+        case THUMB_LOAD_ADDRESS:
+            if (op & (1 << 11))
+            {
+                load_reg(RAX, REG_SP);
+                emitter.alu32_reg_imm(ALU_ADD, RAX, (op & 0xFF) << 2);
+                store_reg((op >> 8) & 0x7, RAX);
+            }
+            else
+                emitter.mov32_mem_imm(RBX, reg_offset((op >> 8) & 0x7), (pc_value() & ~0x2) + ((op & 0xFF) << 2));
+            native = true;
+            break;
+        case THUMB_OFFSET_SP:
+        {
+            int32_t offset = (op & 0x7F) << 2;
+            if (op & (1 << 7))
+                offset = -offset;
+            emitter.alu32_mem_imm(ALU_ADD, RBX, reg_offset(REG_SP), offset);
+            native = true;
+            break;
+        }
+        case THUMB_BRANCH:
+        case THUMB_COND_BRANCH:
+        case THUMB_LONG_BRANCH_PREP:
+        case THUMB_LONG_BRANCH:
+            lr_known = prev_lr_known;
+            native = compile_thumb_branch(op, instr.thumb_kind);
+            if (instr.thumb_kind != THUMB_LONG_BRANCH_PREP)
+                lr_known = false;
+            break;
+        default:
+            break;
+    }
+
+    if (!native)
+        emit_call_handler(instr);
+    return native;
+}
+
+bool ARM_JIT::compile_arm_data_processing(uint32_t instr)
+{
+    int opcode = (instr >> 21) & 0xF;
+    bool set_condition_codes = instr & (1 << 20);
+    int first_operand = (instr >> 16) & 0xF;
+    int destination = (instr >> 12) & 0xF;
+    bool is_operand_imm = instr & (1 << 25);
+    bool is_test = opcode >= 0x8 && opcode <= 0xB;
+
+    //ADC, SBC and RSC, MRS/MSR, PC writes and register-specified shifts go through the interpreter
+    if (opcode >= 0x5 && opcode <= 0x7)
+        return false;
+    if (is_test && !set_condition_codes)
+        return false;
+    if (destination == REG_PC && !is_test)
+        return false;
+    if (!is_operand_imm && (instr & (1 << 4)))
+        return false;
+
+    bool is_logical;
+    switch (opcode)
+    {
+        case 0x0:
+        case 0x1:
+        case 0x8:
+        case 0x9:
+        case 0xC:
+        case 0xD:
+        case 0xE:
+        case 0xF:
+            is_logical = true;
+            break;
+        default:
+            is_logical = false;
+            break;
+    }
+    bool set_carry = set_condition_codes && is_logical;
+
+    //The second operand ends up in ECX unless it is an immediate
+    uint32_t imm = 0;
+    if (is_operand_imm)
+    {
+        int shift = (instr & 0xF00) >> 7;
+        imm = instr & 0xFF;
+        if (shift)
+        {
+            imm = (imm >> shift) | (imm << (32 - shift));
+            if (set_carry)
+            {
+                int32_t nzcv = offset_of(&cpu->CPSR.nzcv);
+                if (imm >> 31)
+                    emitter.alu8_mem_imm(ALU_OR, RBX, nzcv, NZCV_C);
+                else
+                    emitter.alu8_mem_imm(ALU_AND, RBX, nzcv, (uint8_t)~NZCV_C);
+            }
+        }
+    }
+    else
+    {
+        load_reg(RCX, instr & 0xF);
+        emit_shift_imm(RCX, (instr >> 5) & 0x3, (instr >> 7) & 0x1F, set_carry);
+    }
+
+    X64_ALU op;
+    switch (opcode)
+    {
+        case 0x0:
+        case 0x8:
+        case 0xE:
+            op = ALU_AND;
+            break;
+        case 0x1:
+        case 0x9:
+            op = ALU_XOR;
+            break;
+        case 0x2:
+        case 0x3:
+        case 0xA:
+            op = ALU_SUB;
+            break;
+        case 0x4:
+        case 0xB:
+            op = ALU_ADD;
+            break;
+        case 0xC:
+            op = ALU_OR;
+            break;
+        default:
+            op = ALU_OR;
+            break;
+    }
+
+    if (opcode == 0xD || opcode == 0xF)
+    {
+        //MOV/MVN
+        if (is_operand_imm)
+            emitter.mov32_reg_imm(RAX, opcode == 0xF ? ~imm : imm);
+        else
+        {
+            emitter.mov32_reg_reg(RAX, RCX);
+            if (opcode == 0xF)
+                emitter.not32(RAX);
+        }
+        if (set_condition_codes)
+            emitter.test32_reg_reg(RAX, RAX);
+    }
+    else if (opcode == 0x3)
+    {
+        //RSB
+        if (is_operand_imm)
+            emitter.mov32_reg_imm(RAX, imm);
+        else
+            emitter.mov32_reg_reg(RAX, RCX);
+        load_reg(RCX, first_operand);
+        emitter.alu32_reg_reg(ALU_SUB, RAX, RCX);
+    }
+    else
+    {
+        load_reg(RAX, first_operand);
+        if (opcode == 0xE)
+        {
+            //BIC
+            if (is_operand_imm)
+                imm = ~imm;
+            else
+                emitter.not32(RCX);
+        }
+        if (is_operand_imm)
+            emitter.alu32_reg_imm(op, RAX, imm);
+        else
+            emitter.alu32_reg_reg(op, RAX, RCX);
+    }
+
+    if (set_condition_codes)
+    {
+        if (op == ALU_ADD)
+            emit_set_nzcv_add();
+        else if (op == ALU_SUB)
+            emit_set_nzcv_sub();
+        else
+            emit_set_nz();
+    }
+
+    if (!is_test)
+        store_reg(destination, RAX);
+    return true;
+}
+
+bool ARM_JIT::compile_arm_load_store(uint32_t instr, ARM_INSTR kind)
+{
+    bool is_load = kind == ARM_LOAD_WORD || kind == ARM_LOAD_BYTE;
+    bool is_byte = kind == ARM_LOAD_BYTE || kind == ARM_STORE_BYTE;
+    bool is_preindexing = instr & (1 << 24);
+    bool is_adding_offset = instr & (1 << 23);
+    bool is_writing_back = instr & (1 << 21);
+    int base = (instr >> 16) & 0xF;
+    int reg = (instr >> 12) & 0xF;
+    uint32_t offset = instr & 0xFFF;
+    X64_ALU offset_op = is_adding_offset ? ALU_ADD : ALU_SUB;
+
+    //Post-indexed loads skip the writeback when the base is also the destination
+    bool writes_base;
+    if (is_preindexing)
+        writes_base = is_writing_back;
+    else
+        writes_base = !is_load || base != reg;
+
+    if (instr & (1 << 25))
+        return false;
+    if (is_load && reg == REG_PC)
+        return false;
+    if (base == REG_PC && writes_base)
+        return false;
+
+    if (!is_load)
+        load_reg(R13, reg);
+    load_reg(R12, base);
+
+    if (is_preindexing)
+        emitter.alu32_reg_imm(offset_op, R12, offset);
+
+    //The base is only written back once the access is done, as an abort leaves it untouched
+    if (is_load)
+    {
+        emit_load(is_byte ? 1 : 4, !is_byte);
+        if (writes_base)
+        {
+            if (!is_preindexing)
+                emitter.alu32_reg_imm(offset_op, R12, offset);
+            store_reg(base, R12);
+        }
+        store_reg(reg, RAX);
+    }
+    else
+    {
+        if (writes_base)
+        {
+            emitter.mov32_reg_reg(R14, R12);
+            if (!is_preindexing)
+                emitter.alu32_reg_imm(offset_op, R14, offset);
+        }
+        if (!is_byte)
+            emitter.alu32_reg_imm(ALU_AND, R12, ~0x3);
+        emit_store(is_byte ? 1 : 4);
+        if (writes_base)
+            store_reg(base, R14);
+    }
+
+    emit_call_checks();
+    return true;
+}
+
+bool ARM_JIT::compile_arm_branch(uint32_t instr)
+{
+    int32_t offset = (instr & 0xFFFFFF) << 2;
+    offset <<= 6;
+    offset >>= 6;
+    uint32_t target = pc_value() + offset;
+
+    if (instr & (1 << 24))
+        emitter.mov32_mem_imm(RBX, reg_offset(REG_LR), pc_value() - 4);
+    emit_link(target & ~0x3, instr_index + 1);
+    return true;
+}
+
+bool ARM_JIT::compile_thumb_alu(uint16_t instr)
+{
+    int destination = instr & 0x7;
+    int source = (instr >> 3) & 0x7;
+
+    switch ((instr >> 6) & 0xF)
+    {
+        case 0x0:
+        case 0x1:
+        case 0x8:
+        case 0xC:
+        {
+            int opcode = (instr >> 6) & 0xF;
+            X64_ALU op = ALU_AND;
+            if (opcode == 0x1)
+                op = ALU_XOR;
+            else if (opcode == 0xC)
+                op = ALU_OR;
+            load_reg(RAX, destination);
+            emitter.alu32_reg_mem(op, RAX, RBX, reg_offset(source));
+            emit_set_nz();
+            if (opcode != 0x8)
+                store_reg(destination, RAX);
+            return true;
+        }
+        case 0x9:
+            //NEG
+            emitter.mov32_reg_imm(RAX, 0);
+            emitter.alu32_reg_mem(ALU_SUB, RAX, RBX, reg_offset(source));
+            emit_set_nzcv_sub();
+            store_reg(destination, RAX);
+            return true;
+        case 0xA:
+            load_reg(RAX, destination);
+            emitter.alu32_reg_mem(ALU_SUB, RAX, RBX, reg_offset(source));
+            emit_set_nzcv_sub();
+            return true;
+        case 0xB:
+            load_reg(RAX, destination);
+            emitter.alu32_reg_mem(ALU_ADD, RAX, RBX, reg_offset(source));
+            emit_set_nzcv_add();
+            return true;
+        case 0xD:
+            load_reg(RAX, destination);
+            load_reg(RCX, source);
+            emitter.imul32_reg_reg(RAX, RCX);
+            emitter.test32_reg_reg(RAX, RAX);
+            emit_set_nz();
+            store_reg(destination, RAX);
+            return true;
+        case 0xE:
+            load_reg(RCX, source);
+            emitter.not32(RCX);
+            load_reg(RAX, destination);
+            emitter.alu32_reg_reg(ALU_AND, RAX, RCX);
+            emit_set_nz();
+            store_reg(destination, RAX);
+            return true;
+        case 0xF:
+            load_reg(RAX, source);
+            emitter.not32(RAX);
+            emitter.test32_reg_reg(RAX, RAX);
+            emit_set_nz();
+            store_reg(destination, RAX);
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool ARM_JIT::compile_thumb_hi_reg_op(uint16_t instr)
+{
+    int opcode = (instr >> 8) & 0x3;
+    int source = ((instr >> 3) & 0x7) | ((instr >> 3) & 0x8);
+    int destination = (instr & 0x7) | ((instr >> 4) & 0x8);
+
+    switch (opcode)
+    {
+        case 0x0:
+            if (destination == REG_PC)
+                return false;
+            load_reg(RAX, destination);
+            load_reg(RCX, source);
+            emitter.alu32_reg_reg(ALU_ADD, RAX, RCX);
+            store_reg(destination, RAX);
+            return true;
+        case 0x1:
+            load_reg(RAX, destination);
+            load_reg(RCX, source);
+            emitter.alu32_reg_reg(ALU_SUB, RAX, RCX);
+            emit_set_nzcv_sub();
+            return true;
+        case 0x2:
+            if (destination == REG_PC)
+                return false;
+            load_reg(RAX, source);
+            store_reg(destination, RAX);
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool ARM_JIT::compile_thumb_load_store(uint16_t instr, THUMB_INSTR kind)
+{
+    int reg = instr & 0x7;
+    int base = (instr >> 3) & 0x7;
+    int size = 4;
+    bool is_load = true;
+    bool rotate = false;
+
+    switch (kind)
+    {
+        case THUMB_PC_REL_LOAD:
+            reg = (instr >> 8) & 0x7;
+            emitter.mov32_reg_imm(R12, (pc_value() + ((instr & 0xFF) << 2)) & ~0x3);
+            break;
+        case THUMB_LOAD_IMM_OFFSET:
+        case THUMB_STORE_IMM_OFFSET:
+            is_load = kind == THUMB_LOAD_IMM_OFFSET;
+            load_reg(R12, base);
+            if (instr & (1 << 12))
+            {
+                size = 1;
+                emitter.alu32_reg_imm(ALU_ADD, R12, (instr >> 6) & 0x1F);
+            }
+            else
+            {
+                rotate = is_load;
+                emitter.alu32_reg_imm(ALU_ADD, R12, ((instr >> 6) & 0x1F) << 2);
+            }
+            break;
+        case THUMB_LOAD_REG_OFFSET:
+        case THUMB_STORE_REG_OFFSET:
+            is_load = kind == THUMB_LOAD_REG_OFFSET;
+            if (instr & (1 << 10))
+                size = 1;
+            else
+                rotate = is_load;
+            load_reg(R12, base);
+            emitter.alu32_reg_mem(ALU_ADD, R12, RBX, reg_offset((instr >> 6) & 0x7));
+            break;
+        case THUMB_SP_REL_LOAD:
+        case THUMB_SP_REL_STORE:
+            is_load = kind == THUMB_SP_REL_LOAD;
+            reg = (instr >> 8) & 0x7;
+            load_reg(R12, REG_SP);
+            emitter.alu32_reg_imm(ALU_ADD, R12, (instr & 0xFF) << 2);
+            break;
+        case THUMB_LOAD_HALFWORD:
+        case THUMB_STORE_HALFWORD:
+            is_load = kind == THUMB_LOAD_HALFWORD;
+            size = 2;
+            load_reg(R12, base);
+            emitter.alu32_reg_imm(ALU_ADD, R12, ((instr >> 6) & 0x1F) << 1);
+            break;
+        default:
+            return false;
+    }
+
+    if (is_load)
+    {
+        emit_load(size, rotate);
+        store_reg(reg, RAX);
+    }
+    else
+    {
+        load_reg(R13, reg);
+        emit_store(size);
+    }
+    emit_call_checks();
+    return true;
+}
+
+bool ARM_JIT::compile_thumb_branch(uint16_t instr, THUMB_INSTR kind)
+{
+    switch (kind)
+    {
+        case THUMB_BRANCH:
+        {
+            int16_t offset = (instr & 0x7FF) << 1;
+            offset <<= 4;
+            offset >>= 4;
+            uint32_t target = pc_value() + offset;
+            emit_link(target & ~0x1, instr_index + 1);
+            return true;
+        }
+        case THUMB_COND_BRANCH:
+        {
+            int condition = (instr >> 8) & 0xF;
+            int16_t offset = static_cast<int32_t>(instr << 24) >> 23;
+            uint32_t target = pc_value() + offset;
+            if (condition == 0xF)
+                return false;
+
+            //The not-taken path falls through to the block's final link
+            std::vector<uint8_t*> skips;
+            emit_condition_check(condition, skips);
+            emit_link(target & ~0x1, instr_index + 1);
+            for (unsigned int i = 0; i < skips.size(); i++)
+                emitter.set_target(skips[i]);
+            return true;
+        }
+        case THUMB_LONG_BRANCH_PREP:
+        {
+            int32_t offset = ((instr & 0x7FF) << 21) >> 9;
+            known_lr = pc_value() + offset;
+            lr_known = true;
+            emitter.mov32_mem_imm(RBX, reg_offset(REG_LR), known_lr);
+            return true;
+        }
+        case THUMB_LONG_BRANCH:
+        {
+            //Only a BL whose first half is in the same block has a known target
+            if (!lr_known)
+                return false;
+            uint32_t target = known_lr + ((instr & 0x7FF) << 1);
+            emitter.mov32_mem_imm(RBX, reg_offset(REG_LR), (pc_value() - 2) | 0x1);
+            emit_link(target & ~0x1, instr_index + 1);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+void ARM_JIT::load_reg(X64_REG dest, int reg)
+{
+    if (reg == REG_PC)
+        emitter.mov32_reg_imm(dest, pc_value());
+    else
+        emitter.mov32_reg_mem(dest, RBX, reg_offset(reg));
+}
+
+void ARM_JIT::store_reg(int reg, X64_REG source)
+{
+    emitter.mov32_mem_reg(RBX, reg_offset(reg), source);
+}
+
+//Immediate shift with the interpreter's semantics; an amount of 0 means LSR/ASR #32 and RRX
+void ARM_JIT::emit_shift_imm(X64_REG reg, int type, int amount, bool set_carry)
+{
+    switch (type)
+    {
+        case 0:
+            if (!amount)
+                return;
+            emitter.shift32_imm(SHIFT_SHL, reg, amount);
+            break;
+        case 1:
+            if (!amount)
+            {
+                if (set_carry)
+                {
+                    emitter.bt32_reg_imm(reg, 31);
+                    emit_set_carry(CC_B);
+                }
+                emitter.mov32_reg_imm(reg, 0);
+                return;
+            }
+            emitter.shift32_imm(SHIFT_SHR, reg, amount);
+            break;
+        case 2:
+            if (!amount)
+            {
+                if (set_carry)
+                {
+                    emitter.bt32_reg_imm(reg, 31);
+                    emit_set_carry(CC_B);
+                }
+                emitter.shift32_imm(SHIFT_SAR, reg, 31);
+                return;
+            }
+            emitter.shift32_imm(SHIFT_SAR, reg, amount);
+            break;
+        case 3:
+            if (!amount)
+            {
+                emitter.movzx8_reg_mem(RDX, RBX, offset_of(&cpu->CPSR.nzcv));
+                emitter.bt32_reg_imm(RDX, 1);
+                emitter.shift32_imm(SHIFT_RCR, reg, 1);
+            }
+            else
+                emitter.shift32_imm(SHIFT_ROR, reg, amount);
+            break;
+    }
+    if (set_carry)
+        emit_set_carry(CC_B);
+}
+
+//The packed flag updates below use RDX and R8-R10 as scratch, leaving RAX and RCX intact
+void ARM_JIT::emit_set_carry(X64_COND cond)
+{
+    int32_t nzcv = offset_of(&cpu->CPSR.nzcv);
+    emitter.setcc_reg(cond, RDX);
+    emitter.movzx8_reg_reg(RDX, RDX);
+    emitter.shift32_imm(SHIFT_SHL, RDX, 1);
+    emitter.alu8_mem_imm(ALU_AND, RBX, nzcv, (uint8_t)~NZCV_C);
+    emitter.alu8_mem_reg(ALU_OR, RBX, nzcv, RDX);
+}
+
+void ARM_JIT::emit_set_nz()
+{
+    int32_t nzcv = offset_of(&cpu->CPSR.nzcv);
+    emitter.setcc_reg(CC_S, RDX);
+    emitter.setcc_reg(CC_E, R8);
+    emitter.movzx8_reg_reg(RDX, RDX);
+    emitter.movzx8_reg_reg(R8, R8);
+    emitter.shift32_imm(SHIFT_SHL, RDX, 3);
+    emitter.shift32_imm(SHIFT_SHL, R8, 2);
+    emitter.alu32_reg_reg(ALU_OR, RDX, R8);
+    emitter.alu8_mem_imm(ALU_AND, RBX, nzcv, NZCV_C | NZCV_V);
+    emitter.alu8_mem_reg(ALU_OR, RBX, nzcv, RDX);
+}
+
+void ARM_JIT::emit_set_nzcv(X64_COND carry_cond)
+{
+    emitter.setcc_reg(CC_S, RDX);
+    emitter.setcc_reg(CC_E, R8);
+    emitter.setcc_reg(carry_cond, R9);
+    emitter.setcc_reg(CC_O, R10);
+    emitter.movzx8_reg_reg(RDX, RDX);
+    emitter.movzx8_reg_reg(R8, R8);
+    emitter.movzx8_reg_reg(R9, R9);
+    emitter.movzx8_reg_reg(R10, R10);
+    emitter.shift32_imm(SHIFT_SHL, RDX, 3);
+    emitter.shift32_imm(SHIFT_SHL, R8, 2);
+    emitter.shift32_imm(SHIFT_SHL, R9, 1);
+    emitter.alu32_reg_reg(ALU_OR, RDX, R8);
+    emitter.alu32_reg_reg(ALU_OR, RDX, R9);
+    emitter.alu32_reg_reg(ALU_OR, RDX, R10);
+    emitter.mov8_mem_reg(RBX, offset_of(&cpu->CPSR.nzcv), RDX);
+}
+
+void ARM_JIT::emit_set_nzcv_add()
+{
+    emit_set_nzcv(CC_B);
+}
+
+//ARM's carry after a subtraction is the inverse of x86's borrow
+void ARM_JIT::emit_set_nzcv_sub()
+{
+    emit_set_nzcv(CC_AE);
+}
+
+//Native code reads and writes the N/Z/C/V bools directly, so a pending lazy op from an interpreter call
+//has to be materialised first. Nothing is held in host registers between instructions.
+void ARM_JIT::emit_resolve_flags()
+{
+    emitter.alu32_mem_imm(ALU_CMP, RBX, offset_of(&cpu->CPSR.flag_op), FLAGS_READY);
+    uint8_t* ready = emitter.jcc(CC_E);
+    emitter.mov64_reg_reg(ABI_PARAM1, RBX);
+    emitter.mov64_reg_imm(RAX, (uint64_t)&ARM_JIT::resolve_flags);
+    emitter.call_reg(RAX);
+    emitter.set_target(ready);
+}
+
+//Appends a branch that is taken when the condition fails, testing NZCV against the condition's truth table mask
+void ARM_JIT::emit_condition_check(int cond, std::vector<uint8_t*>& skips)
+{
+    if (cond >= 0xE)
+        return;
+    emitter.mov32_reg_imm(RAX, condition_table.masks[cond]);
+    emitter.movzx8_reg_mem(RCX, RBX, offset_of(&cpu->CPSR.nzcv));
+    emitter.bt32_reg_reg(RAX, RCX);
+    skips.push_back(emitter.jcc(CC_AE));
+}
+
+//Loads from the address in R12 into EAX. Word loads with rotate follow LDR's unaligned behavior.
+void ARM_JIT::emit_load(int size, bool rotate)
+{
+    ARM_FastRAM& fast_ram = cpu->fast_ram;
+    uint8_t* done = nullptr;
+
+    emitter.mov32_mem_imm(RBX, reg_offset(REG_PC), pc_value());
+    emitter.mov32_reg_reg(RAX, R12);
+    if (rotate)
+        emitter.alu32_reg_imm(ALU_AND, RAX, ~0x3);
+
+    if (use_fastmem)
+    {
+        //A fault leaves the address in EAX for the slow path
+        JIT_Slow_Access slow;
+        emitter.mov64_reg_imm(RDX, (uint64_t)cpu->fastmem->get_base());
+        slow.access = emitter.get_ptr();
+        if (size == 1)
+            emitter.movzx8_reg_index(RAX, RDX, RAX);
+        else if (size == 2)
+            emitter.movzx16_reg_index(RAX, RDX, RAX);
+        else
+            emitter.mov32_reg_index(RAX, RDX, RAX);
+        while (emitter.get_ptr() < slow.access + JIT_FASTMEM_PATCH_SIZE)
+            emitter.nop();
+        slow.resume = emitter.get_ptr();
+        slow.code_check = nullptr;
+        slow.other_code_check = nullptr;
+        slow.clean_check = nullptr;
+        slow.size = size;
+        slow.store = false;
+        slow.instr_index = instr_index;
+        slow_accesses.push_back(slow);
+    }
+    else
+    {
+        if (fast_ram_usable())
+        {
+            emitter.mov32_reg_reg(RCX, RAX);
+            emitter.alu32_reg_imm(ALU_SUB, RCX, fast_ram.base);
+            emitter.alu32_reg_imm(ALU_CMP, RCX, fast_ram.size - size + 1);
+            uint8_t* slow = emitter.jcc(CC_AE);
+            emitter.mov64_reg_imm(RDX, (uint64_t)fast_ram.mem);
+            if (size == 1)
+                emitter.movzx8_reg_index(RAX, RDX, RCX);
+            else if (size == 2)
+                emitter.movzx16_reg_index(RAX, RDX, RCX);
+            else
+                emitter.mov32_reg_index(RAX, RDX, RCX);
+            done = emitter.jmp();
+            emitter.set_target(slow);
+        }
+
+        emit_load_call(size);
+
+        if (done)
+            emitter.set_target(done);
+    }
+
+    if (rotate)
+    {
+        emitter.mov32_reg_reg(RCX, R12);
+        emitter.alu32_reg_imm(ALU_AND, RCX, 0x3);
+        emitter.shift32_imm(SHIFT_SHL, RCX, 3);
+        emitter.shift32_cl(SHIFT_ROR, RAX);
+    }
+}
+
+//Stores R13 to the address in R12. Pages holding cached code on either core always take the slow path, as
+//do clean pages, so write* can mark them dirty. A page stays dirty until the dirty set is next taken, so the
+//code checks have to come first to catch code the other core compiles on it in the meantime.
+void ARM_JIT::emit_store(int size)
+{
+    ARM_FastRAM& fast_ram = cpu->fast_ram;
+    uint8_t* done = nullptr;
+
+    emitter.mov32_mem_imm(RBX, reg_offset(REG_PC), pc_value());
+
+    if (use_fastmem)
+    {
+        JIT_Slow_Access slow;
+        emitter.mov32_reg_reg(RDX, R12);
+        emitter.shift32_imm(SHIFT_SHR, RDX, 12);
+        emitter.mov64_reg_imm(RAX, (uint64_t)cpu->code_pages);
+        emitter.bt32_mem_reg(RAX, 0, RDX);
+        slow.code_check = emitter.jcc(CC_B);
+        emitter.mov64_reg_imm(RAX, (uint64_t)cpu->other_core->code_pages);
+        emitter.bt32_mem_reg(RAX, 0, RDX);
+        slow.other_code_check = emitter.jcc(CC_B);
+        emitter.mov64_reg_imm(RAX, (uint64_t)cpu->clean_pages);
+        emitter.bt32_mem_reg(RAX, 0, RDX);
+        slow.clean_check = emitter.jcc(CC_B);
+
+        emitter.mov32_reg_reg(RCX, R12);
+        emitter.mov64_reg_imm(RDX, (uint64_t)cpu->fastmem->get_base());
+        slow.access = emitter.get_ptr();
+        if (size == 1)
+            emitter.mov8_index_reg(RDX, RCX, R13);
+        else if (size == 2)
+            emitter.mov16_index_reg(RDX, RCX, R13);
+        else
+            emitter.mov32_index_reg(RDX, RCX, R13);
+        while (emitter.get_ptr() < slow.access + JIT_FASTMEM_PATCH_SIZE)
+            emitter.nop();
+        slow.resume = emitter.get_ptr();
+        slow.size = size;
+        slow.store = true;
+        slow.instr_index = instr_index;
+        slow_accesses.push_back(slow);
+        return;
+    }
+
+    if (fast_ram_usable() && fast_ram.writable)
+    {
+        emitter.mov32_reg_reg(RCX, R12);
+        emitter.alu32_reg_imm(ALU_SUB, RCX, fast_ram.base);
+        emitter.alu32_reg_imm(ALU_CMP, RCX, fast_ram.size - size + 1);
+        uint8_t* slow = emitter.jcc(CC_AE);
+
+        emitter.mov32_reg_reg(RDX, R12);
+        emitter.shift32_imm(SHIFT_SHR, RDX, 12);
+        emitter.mov64_reg_imm(RAX, (uint64_t)cpu->code_pages);
+        emitter.bt32_mem_reg(RAX, 0, RDX);
+        uint8_t* slow_code = emitter.jcc(CC_B);
+        emitter.mov64_reg_imm(RAX, (uint64_t)cpu->other_core->code_pages);
+        emitter.bt32_mem_reg(RAX, 0, RDX);
+        uint8_t* slow_other_code = emitter.jcc(CC_B);
+        emitter.mov64_reg_imm(RAX, (uint64_t)cpu->clean_pages);
+        emitter.bt32_mem_reg(RAX, 0, RDX);
+        uint8_t* slow_clean = emitter.jcc(CC_B);
+
+        emitter.mov64_reg_imm(RDX, (uint64_t)fast_ram.mem);
+        if (size == 1)
+            emitter.mov8_index_reg(RDX, RCX, R13);
+        else if (size == 2)
+            emitter.mov16_index_reg(RDX, RCX, R13);
+        else
+            emitter.mov32_index_reg(RDX, RCX, R13);
+        done = emitter.jmp();
+        emitter.set_target(slow);
+        emitter.set_target(slow_code);
+        emitter.set_target(slow_other_code);
+        emitter.set_target(slow_clean);
+    }
+
+    emit_store_call(size);
+
+    if (done)
+        emitter.set_target(done);
+}
+
+//Reads the address in EAX through ARM_CPU::read*
+void ARM_JIT::emit_load_call(int size)
+{
+    void* func;
+    if (size == 1)
+        func = (void*)&ARM_JIT::read8;
+    else if (size == 2)
+        func = (void*)&ARM_JIT::read16;
+    else
+        func = (void*)&ARM_JIT::read32;
+    emitter.mov32_reg_reg(ABI_PARAM2, RAX);
+    emitter.mov64_reg_reg(ABI_PARAM1, RBX);
+    emitter.mov64_reg_imm(RAX, (uint64_t)func);
+    emitter.call_reg(RAX);
+    emit_exception_check();
+}
+
+void ARM_JIT::emit_store_call(int size)
+{
+    void* func;
+    if (size == 1)
+        func = (void*)&ARM_JIT::write8;
+    else if (size == 2)
+        func = (void*)&ARM_JIT::write16;
+    else
+        func = (void*)&ARM_JIT::write32;
+    emitter.mov32_reg_reg(ABI_PARAM3, R13);
+    emitter.mov32_reg_reg(ABI_PARAM2, R12);
+    emitter.mov64_reg_reg(ABI_PARAM1, RBX);
+    emitter.mov64_reg_imm(RAX, (uint64_t)func);
+    emitter.call_reg(RAX);
+    emit_exception_check();
+}
+
+//Placed after the block, so fastmem accesses that hit RAM run straight through
+void ARM_JIT::emit_slow_accesses()
+{
+    int block_length = instr_index;
+    for (unsigned int i = 0; i < slow_accesses.size(); i++)
+    {
+        JIT_Slow_Access& slow = slow_accesses[i];
+        uint8_t* code = emitter.get_ptr();
+        instr_index = slow.instr_index;
+        if (slow.code_check)
+            emitter.set_target(slow.code_check);
+        if (slow.other_code_check)
+            emitter.set_target(slow.other_code_check);
+        if (slow.clean_check)
+            emitter.set_target(slow.clean_check);
+        if (slow.store)
+            emit_store_call(slow.size);
+        else
+            emit_load_call(slow.size);
+        emitter.jmp(slow.resume);
+        fault_targets[slow.access] = code;
+    }
+    instr_index = block_length;
+}
+
+void ARM_JIT::emit_call_handler(ARM_Predecoded &instr)
+{
+    emitter.mov32_mem_imm(RBX, reg_offset(REG_PC), pc_value());
+    emitter.mov64_reg_reg(ABI_PARAM1, RBX);
+    emitter.mov32_reg_imm(ABI_PARAM2, instr.instr);
+    if (thumb)
+    {
+        emitter.mov64_reg_imm(ABI_PARAM3, (uint64_t)instr.thumb_handler);
+        emitter.mov64_reg_imm(RAX, (uint64_t)&ARM_JIT::call_thumb);
+    }
+    else
+    {
+        emitter.mov64_reg_imm(ABI_PARAM3, (uint64_t)instr.handler);
+        emitter.mov64_reg_imm(RAX, (uint64_t)&ARM_JIT::call_arm);
+    }
+    emitter.call_reg(RAX);
+
+    //Instructions that end a block may have changed state the linked blocks rely on
+    if (instr.ends_block)
+        emit_exit(instr_index + 1);
+    else
+        emit_call_checks();
+}
+
+//Leaves the block if the call branched, took an interrupt, overwrote cached code or threw
+void ARM_JIT::emit_call_checks()
+{
+    emitter.alu32_mem_imm(ALU_CMP, RBX, reg_offset(REG_PC), pc_value());
+    exits.push_back(std::make_pair(emitter.jcc(CC_NE), instr_index + 1));
+    emitter.alu8_mem_imm(ALU_CMP, RBX, offset_of(&cpu->code_written), 0);
+    exits.push_back(std::make_pair(emitter.jcc(CC_NE), instr_index + 1));
+}
+
+//A faulting access must not write back its result or base register, as the interpreter's wouldn't
+void ARM_JIT::emit_exception_check()
+{
+    emitter.mov64_reg_imm(RDX, (uint64_t)&exception_thrown);
+    emitter.alu8_mem_imm(ALU_CMP, RDX, 0, 0);
+    exits.push_back(std::make_pair(emitter.jcc(CC_NE), instr_index + 1));
+}
+
+//Takes a prefetch abort before anything in the block has run if it's entered from user mode
+void ARM_JIT::emit_privileged_check()
+{
+    emitter.mov32_reg_imm(ABI_PARAM2, block_addr);
+    emitter.mov64_reg_reg(ABI_PARAM1, RBX);
+    emitter.mov64_reg_imm(RAX, (uint64_t)&ARM_JIT::check_privileged);
+    emitter.call_reg(RAX);
+    emitter.mov64_reg_imm(RDX, (uint64_t)&exception_thrown);
+    emitter.alu8_mem_imm(ALU_CMP, RDX, 0, 0);
+    exits.push_back(std::make_pair(emitter.jcc(CC_NE), 0));
+}
+
+void ARM_JIT::emit_exit(int executed)
+{
+    emitter.alu32_mem_imm(ALU_SUB, RBX, offset_of(&cpu->cycles_left), block_cycles[executed]);
+    emitter.jmp(exit_code);
+}
+
+//Jumps straight to the target's compiled block while the time slice lasts.
+//Anything ARM_CPU::run checks between blocks sends it back to the dispatcher instead.
+void ARM_JIT::emit_link(uint32_t target, int executed)
+{
+    JIT_Block* block = &blocks[block_index(target)];
+
+    //An idle loop going around again gives up the rest of the slice, see ARM_CPU::is_idle_loop
+    if (idle_loop && target == block_addr)
+    {
+        emitter.mov32_mem_imm(RBX, reg_offset(REG_PC), target + (thumb ? 2 : 4));
+        emitter.mov8_mem_imm(RBX, offset_of(&cpu->spinning), 1);
+        emit_exit(executed);
+        return;
+    }
+
+    emitter.mov32_mem_imm(RBX, reg_offset(REG_PC), target + (thumb ? 2 : 4));
+    emitter.alu32_mem_imm(ALU_SUB, RBX, offset_of(&cpu->cycles_left), block_cycles[executed]);
+    emitter.jcc(CC_LE, exit_code);
+    emitter.alu8_mem_imm(ALU_CMP, RBX, offset_of(&cpu->int_pending), 0);
+    emitter.jcc(CC_NE, exit_code);
+    emitter.mov64_reg_imm(RAX, (uint64_t)block);
+    emitter.alu32_mem_imm(ALU_CMP, RAX, offsetof(JIT_Block, tag), target | thumb);
+    emitter.jcc(CC_NE, exit_code);
+    emitter.jmp_mem(RAX, offsetof(JIT_Block, code));
+}
+
+void ARM_JIT::emit_exit_stubs()
+{
+    uint8_t* stubs[ARM_BLOCK_MAX_INSTRS + 1];
+    memset(stubs, 0, sizeof(stubs));
+
+    for (unsigned int i = 0; i < exits.size(); i++)
+    {
+        int executed = exits[i].second;
+        if (!stubs[executed])
+        {
+            stubs[executed] = emitter.get_ptr();
+            emit_exit(executed);
+        }
+        emitter.set_target(exits[i].first, stubs[executed]);
+    }
+}
+
+void ARM_JIT::catch_exception(ARM_CPU *cpu)
+{
+    cpu->jit->pending_exception = std::current_exception();
+    cpu->jit->exception_thrown = true;
+    cpu->code_written = true;
+}
+
+void ARM_JIT::resolve_flags(ARM_CPU *cpu)
+{
+    cpu->CPSR.compute_flags();
+}
+
+void ARM_JIT::trigger_trace(ARM_CPU *cpu)
+{
+    cpu->trigger_trace();
+}
+
+void ARM_JIT::check_privileged(ARM_CPU *cpu, uint32_t addr)
+{
+    try
+    {
+        if (cpu->CPSR.mode == PSR_USER)
+            cpu->prefetch_abort(addr);
+    }
+    catch (...)
+    {
+        catch_exception(cpu);
+    }
+}
+
+void ARM_JIT::call_arm(ARM_CPU *cpu, uint32_t instr, ARM_Handler handler)
+{
+    try
+    {
+        handler(*cpu, instr);
+    }
+    catch (...)
+    {
+        catch_exception(cpu);
+    }
+}
+
+void ARM_JIT::call_thumb(ARM_CPU *cpu, uint32_t instr, Thumb_Handler handler)
+{
+    try
+    {
+        handler(*cpu, instr);
+    }
+    catch (...)
+    {
+        catch_exception(cpu);
+    }
+}
+
+uint32_t ARM_JIT::read8(ARM_CPU *cpu, uint32_t addr)
+{
+    try
+    {
+        return cpu->read8(addr);
+    }
+    catch (...)
+    {
+        catch_exception(cpu);
+        return 0;
+    }
+}
+
+uint32_t ARM_JIT::read16(ARM_CPU *cpu, uint32_t addr)
+{
+    try
+    {
+        return cpu->read16(addr);
+    }
+    catch (...)
+    {
+        catch_exception(cpu);
+        return 0;
+    }
+}
+
+uint32_t ARM_JIT::read32(ARM_CPU *cpu, uint32_t addr)
+{
+    try
+    {
+        return cpu->read32(addr);
+    }
+    catch (...)
+    {
+        catch_exception(cpu);
+        return 0;
+    }
+}
+
+//write* has marked the page dirty by now, so stores to it can stay inline until the dirty pages are next taken
+void ARM_JIT::write8(ARM_CPU *cpu, uint32_t addr, uint32_t value)
+{
+    try
+    {
+        cpu->write8(addr, value);
+        cpu->clean_pages[addr >> 15] &= ~(1 << ((addr >> 12) & 0x7));
+    }
+    catch (...)
+    {
+        catch_exception(cpu);
+    }
+}
+
+void ARM_JIT::write16(ARM_CPU *cpu, uint32_t addr, uint32_t value)
+{
+    try
+    {
+        cpu->write16(addr, value);
+        cpu->clean_pages[addr >> 15] &= ~(1 << ((addr >> 12) & 0x7));
+    }
+    catch (...)
+    {
+        catch_exception(cpu);
+    }
+}
+
+void ARM_JIT::write32(ARM_CPU *cpu, uint32_t addr, uint32_t value)
+{
+    try
+    {
+        cpu->write32(addr, value);
+        cpu->clean_pages[addr >> 15] &= ~(1 << ((addr >> 12) & 0x7));
+    }
+    catch (...)
+    {
+        catch_exception(cpu);
+    }
+}
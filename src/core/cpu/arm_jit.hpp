@@ -0,0 +1,160 @@
+#ifndef ARM_JIT_HPP
+#define ARM_JIT_HPP
+#include <cstdint>
+#include <exception>
+#include <unordered_map>
+#include <vector>
+#include "arm_interpret.hpp"
+#include "x64_emitter.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define JIT_SUPPORTED
+#endif
+
+#define JIT_BLOCK_ENTRIES 0x4000
+#define JIT_CODE_SIZE (1024 * 1024 * 16)
+
+//Worst case for one block; the code buffer is flushed when less than this is left
+#define JIT_MAX_BLOCK_SIZE (1024 * 16)
+
+//Tagged by start address, with bit 0 set for Thumb blocks
+struct JIT_Block
+{
+    uint32_t tag;
+    uint8_t* code;
+};
+
+//Guest RAM the generated code may access without going through ARM_CPU::read*/write*
+struct ARM_FastRAM
+{
+    uint32_t base;
+    uint32_t size;
+    uint8_t* mem;
+    bool writable;
+};
+
+//Bytes reserved for each fastmem access, so it can be patched into a jump
+#define JIT_FASTMEM_PATCH_SIZE 5
+
+//A fastmem load or store and its out-of-line fallback, which the fault handler sends it to
+//when the access hits I/O or unmapped memory
+struct JIT_Slow_Access
+{
+    uint8_t* access;
+    uint8_t* resume;
+
+    //Stores also get here when the page holds either core's cached code, or hasn't been marked dirty yet.
+    //The code checks are emitted ahead of the dirty one, which doesn't imply anything about code.
+    uint8_t* code_check;
+    uint8_t* other_code_check;
+    uint8_t* clean_check;
+
+    int size;
+    bool store;
+    int instr_index;
+};
+
+class ARM_CPU;
+
+//Translates ARM and Thumb blocks to x86-64. Instructions without a native translation
+//call their ARM_Interpreter handler, so the two backends share semantics.
+class ARM_JIT
+{
+    private:
+        ARM_CPU* cpu;
+        X64_Emitter emitter;
+        uint8_t* code_buffer;
+        uint8_t* code_start;
+        JIT_Block* blocks;
+
+        void (*enter_code)(ARM_CPU* cpu, uint8_t* code);
+        uint8_t* exit_code;
+
+        //C++ exceptions can't unwind through generated code, so they are rethrown from run()
+        std::exception_ptr pending_exception;
+        bool exception_thrown;
+
+        //Fallback of each fastmem access in the code buffer, by the address of the access
+        std::unordered_map<uint8_t*, uint8_t*> fault_targets;
+
+        //State of the block being compiled
+        bool thumb;
+        uint32_t block_addr;
+        bool idle_loop;
+        bool use_fastmem;
+        uint16_t block_cycles[ARM_BLOCK_MAX_INSTRS + 1];
+        uint32_t instr_addr;
+        int instr_index;
+        bool lr_known;
+        uint32_t known_lr;
+        std::vector<std::pair<uint8_t*, int> > exits;
+        std::vector<JIT_Slow_Access> slow_accesses;
+
+        int32_t offset_of(void* member);
+        int32_t reg_offset(int reg);
+        uint32_t pc_value();
+        bool fast_ram_usable();
+        bool fastmem_usable();
+
+        void emit_entry_exit();
+        void compile(JIT_Block* block, uint32_t addr, bool thumb);
+        bool compile_arm(ARM_Predecoded& instr);
+        bool compile_thumb(ARM_Predecoded& instr);
+
+        bool compile_arm_data_processing(uint32_t instr);
+        bool compile_arm_load_store(uint32_t instr, ARM_INSTR kind);
+        bool compile_arm_branch(uint32_t instr);
+
+        bool compile_thumb_alu(uint16_t instr);
+        bool compile_thumb_hi_reg_op(uint16_t instr);
+        bool compile_thumb_load_store(uint16_t instr, THUMB_INSTR kind);
+        bool compile_thumb_branch(uint16_t instr, THUMB_INSTR kind);
+
+        void load_reg(X64_REG dest, int reg);
+        void store_reg(int reg, X64_REG source);
+        void emit_shift_imm(X64_REG reg, int type, int amount, bool set_carry);
+        void emit_set_carry(X64_COND cond);
+        void emit_set_nz();
+        void emit_set_nzcv(X64_COND carry_cond);
+        void emit_set_nzcv_add();
+        void emit_set_nzcv_sub();
+        void emit_resolve_flags();
+        void emit_condition_check(int cond, std::vector<uint8_t*>& skips);
+
+        void emit_load(int size, bool rotate);
+        void emit_store(int size);
+        void emit_load_call(int size);
+        void emit_store_call(int size);
+        void emit_slow_accesses();
+        void emit_call_handler(ARM_Predecoded& instr);
+        void emit_call_checks();
+        void emit_exception_check();
+        void emit_privileged_check();
+        void emit_exit(int executed);
+        void emit_link(uint32_t target, int executed);
+        void emit_exit_stubs();
+
+        static void call_arm(ARM_CPU* cpu, uint32_t instr, ARM_Handler handler);
+        static void call_thumb(ARM_CPU* cpu, uint32_t instr, Thumb_Handler handler);
+        static uint32_t read8(ARM_CPU* cpu, uint32_t addr);
+        static uint32_t read16(ARM_CPU* cpu, uint32_t addr);
+        static uint32_t read32(ARM_CPU* cpu, uint32_t addr);
+        static void write8(ARM_CPU* cpu, uint32_t addr, uint32_t value);
+        static void write16(ARM_CPU* cpu, uint32_t addr, uint32_t value);
+        static void write32(ARM_CPU* cpu, uint32_t addr, uint32_t value);
+        static void catch_exception(ARM_CPU* cpu);
+        static void resolve_flags(ARM_CPU* cpu);
+        static void trigger_trace(ARM_CPU* cpu);
+        static void check_privileged(ARM_CPU* cpu, uint32_t addr);
+    public:
+        ARM_JIT(ARM_CPU* cpu);
+        ~ARM_JIT();
+
+        void run();
+        void flush();
+        void invalidate_page(uint32_t page);
+        void invalidate_itcm_page(uint32_t offset, uint32_t itcm_size);
+        uint8_t* handle_fault(uint8_t* host_pc);
+};
+
+#endif // ARM_JIT_HPP
@@ -0,0 +1,206 @@
+#ifndef ARM_TIMING_HPP
+#define ARM_TIMING_HPP
+#include <cstdint>
+#include "arm_disasm.hpp"
+#include "arm_interpret.hpp"
+
+//Approximate cycle costs of one core, after the ARM946E-S and ARM11 MPCore technical reference manuals.
+//Instruction fetches are assumed to hit the caches, so only data accesses pay memory wait states.
+//Conditional instructions are charged as if they passed, and branches as if they were taken.
+struct ARM_Cycle_Table
+{
+    //Issue cycles by instruction kind
+    uint8_t arm[ARM_RFE + 1];
+    uint8_t thumb[THUMB_SWI + 1];
+
+    //Added when an instruction writes PC and the pipeline has to refill
+    uint8_t branch;
+
+    //Added for data processing with a register-specified shift
+    uint8_t reg_shift;
+
+    //Registers LDM/STM/PUSH/POP move per cycle
+    uint8_t regs_per_cycle;
+
+    //Wait states of one data access outside the TCMs, by address bits 31-24
+    uint8_t wait_states[256];
+};
+
+namespace ARM_Timing
+{
+
+constexpr void set_wait_states(ARM_Cycle_Table& table, int start, int end, int wait)
+{
+    for (int i = start; i <= end; i++)
+        table.wait_states[i] = wait;
+}
+
+constexpr void set_common_costs(ARM_Cycle_Table& table)
+{
+    for (int i = 0; i <= ARM_RFE; i++)
+        table.arm[i] = 1;
+    for (int i = 0; i <= THUMB_SWI; i++)
+        table.thumb[i] = 1;
+
+    //Block transfers are all per-register
+    table.arm[ARM_LOAD_BLOCK] = 0;
+    table.arm[ARM_STORE_BLOCK] = 0;
+    table.thumb[THUMB_PUSH] = 0;
+    table.thumb[THUMB_POP] = 0;
+    table.thumb[THUMB_LOAD_MULTIPLE] = 0;
+    table.thumb[THUMB_STORE_MULTIPLE] = 0;
+
+    table.arm[ARM_SWAP] = 2;
+    table.arm[ARM_COP_REG_TRANSFER] = 2;
+    table.arm[ARM_SRS] = 2;
+    table.arm[ARM_RFE] = 2;
+}
+
+//ARM9 at 134 MHz. Its buses run at half that, and nothing outside the TCMs and internal RAM is cached.
+constexpr ARM_Cycle_Table build_arm9_table()
+{
+    ARM_Cycle_Table table = {};
+    set_common_costs(table);
+
+    table.arm[ARM_UNDEFINED] = 3;
+    table.arm[ARM_MULTIPLY] = 2;
+    table.arm[ARM_MULTIPLY_LONG] = 3;
+    table.arm[ARM_LOAD_DOUBLEWORD] = 2;
+    table.arm[ARM_STORE_DOUBLEWORD] = 2;
+    table.thumb[THUMB_UNDEFINED] = 3;
+    table.thumb[THUMB_SWI] = 3;
+
+    table.branch = 2;
+    table.reg_shift = 1;
+    table.regs_per_cycle = 1;
+
+    set_wait_states(table, 0x10, 0x17, 4);
+    set_wait_states(table, 0x18, 0x1E, 4);
+    set_wait_states(table, 0x1F, 0x1F, 2);
+    set_wait_states(table, 0x20, 0x27, 4);
+    return table;
+}
+
+//ARM11 at 268 MHz. Its branch predictor hides some refills, so the branch cost averages hits and misses.
+//RAM goes through the L1 caches; I/O is uncached and sits on a bus a quarter of the core's speed.
+constexpr ARM_Cycle_Table build_arm11_table()
+{
+    ARM_Cycle_Table table = {};
+    set_common_costs(table);
+
+    table.arm[ARM_UNDEFINED] = 8;
+    table.arm[ARM_MULTIPLY] = 2;
+    table.arm[ARM_MULTIPLY_LONG] = 3;
+    table.thumb[THUMB_UNDEFINED] = 8;
+    table.thumb[THUMB_SWI] = 8;
+
+    table.branch = 3;
+    table.reg_shift = 1;
+    table.regs_per_cycle = 2;
+
+    set_wait_states(table, 0x10, 0x17, 8);
+    set_wait_states(table, 0x18, 0x1E, 4);
+    return table;
+}
+
+static constexpr ARM_Cycle_Table arm9_cycle_table = build_arm9_table();
+static constexpr ARM_Cycle_Table arm11_cycle_table = build_arm11_table();
+
+constexpr int block_transfer_cycles(const ARM_Cycle_Table& table, uint32_t reg_list)
+{
+    int regs = ARM_Interpreter::count_regs(reg_list);
+    return (regs + table.regs_per_cycle - 1) / table.regs_per_cycle;
+}
+
+constexpr int arm_cycles(const ARM_Cycle_Table& table, uint32_t instr, ARM_INSTR kind)
+{
+    int cycles = table.arm[kind];
+    bool writes_pc = false;
+    switch (kind)
+    {
+        case ARM_B:
+        case ARM_BL:
+        case ARM_BX:
+        case ARM_BLX:
+        case ARM_RFE:
+            writes_pc = true;
+            break;
+        case ARM_DATA_PROCESSING:
+        {
+            //TST, TEQ, CMP and CMN have no destination, and MSR shares their encodings
+            int opcode = (instr >> 21) & 0xF;
+            if (!(instr & (1 << 25)) && (instr & (1 << 4)))
+                cycles += table.reg_shift;
+            writes_pc = (opcode < 0x8 || opcode > 0xB) && ((instr >> 12) & 0xF) == 15;
+            break;
+        }
+        case ARM_LOAD_WORD:
+            writes_pc = ((instr >> 12) & 0xF) == 15;
+            break;
+        case ARM_LOAD_BLOCK:
+            cycles += block_transfer_cycles(table, instr & 0xFFFF);
+            writes_pc = instr & (1 << 15);
+            break;
+        case ARM_STORE_BLOCK:
+            cycles += block_transfer_cycles(table, instr & 0xFFFF);
+            break;
+        default:
+            break;
+    }
+
+    if (writes_pc)
+        cycles += table.branch;
+    return cycles > 0 ? cycles : 1;
+}
+
+constexpr int thumb_cycles(const ARM_Cycle_Table& table, uint16_t instr, THUMB_INSTR kind)
+{
+    int cycles = table.thumb[kind];
+    bool writes_pc = false;
+    switch (kind)
+    {
+        case THUMB_ALU_OP:
+        {
+            int opcode = (instr >> 6) & 0xF;
+            if (opcode == 0x2 || opcode == 0x3 || opcode == 0x4 || opcode == 0x7)
+                cycles += table.reg_shift;
+            else if (opcode == 0xD)
+                cycles = table.arm[ARM_MULTIPLY];
+            break;
+        }
+        case THUMB_HI_REG_OP:
+        {
+            int opcode = (instr >> 8) & 0x3;
+            int destination = (instr & 0x7) | ((instr >> 4) & 0x8);
+            writes_pc = opcode == 3 || (opcode != 1 && destination == 15);
+            break;
+        }
+        case THUMB_POP:
+            cycles += block_transfer_cycles(table, instr & 0x1FF);
+            writes_pc = instr & (1 << 8);
+            break;
+        case THUMB_PUSH:
+            cycles += block_transfer_cycles(table, instr & 0x1FF);
+            break;
+        case THUMB_LOAD_MULTIPLE:
+        case THUMB_STORE_MULTIPLE:
+            cycles += block_transfer_cycles(table, instr & 0xFF);
+            break;
+        case THUMB_BRANCH:
+        case THUMB_COND_BRANCH:
+        case THUMB_LONG_BRANCH:
+        case THUMB_LONG_BLX:
+            writes_pc = true;
+            break;
+        default:
+            break;
+    }
+
+    if (writes_pc)
+        cycles += table.branch;
+    return cycles > 0 ? cycles : 1;
+}
+
+};
+
+#endif // ARM_TIMING_HPP
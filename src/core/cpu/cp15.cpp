@@ -1,26 +1,162 @@
 #include <cstdio>
+#include <cstring>
 #include "arm.hpp"
 #include "cp15.hpp"
+#include "../memmap.hpp"
 
-CP15::CP15(int id, ARM_CPU* cpu) : id(id), cpu(cpu)
+//Control register bits. The ARM9's protection unit is enabled by the same bit as the ARM11's MMU.
+#define CP15_MMU_ENABLE (1 << 0)
+#define CP15_MPU_ENABLE (1 << 0)
+#define CP15_HIGH_VECTORS (1 << 13)
+#define CP15_DTCM_ENABLE (1 << 16)
+#define CP15_ITCM_ENABLE (1 << 18)
+
+CP15::CP15(int id, ARM_CPU* cpu, uint8_t* ITCM, uint8_t* DTCM) : id(id), cpu(cpu), ITCM(ITCM), DTCM(DTCM)
 {
+    mpu_pages = nullptr;
+    mpu_user_pages = nullptr;
+}
 
+CP15::~CP15()
+{
+    delete[] mpu_pages;
+    delete[] mpu_user_pages;
 }
 
 void CP15::reset(bool has_tcm)
 {
+    this->has_tcm = has_tcm;
+    itcm_size = 0;
+    dtcm_base = 0;
+    dtcm_size = 0;
+    ttbr0 = 0;
+    ttbr1 = 0;
+    ttbcr = 0;
+    dacr = 0;
+    memset(mpu_regions, 0, sizeof(mpu_regions));
+    dcache_bits = 0;
+    icache_bits = 0;
+    write_buffer_bits = 0;
+    data_perms = 0;
+    instr_perms = 0;
     if (has_tcm)
     {
-        itcm_size = 0x08000000;
-        dtcm_base = 0xFFF00000;
-        dtcm_size = 0x4000;
+        //Boot9's layout, enabled from the start: 128 MB of ITCM at 0 and 16 KB of DTCM at $FFF00000.
+        //The ARM9 boots from $FFFF0000, so it comes out of reset with high vectors.
+        control = 0x00000078 | CP15_HIGH_VECTORS | CP15_DTCM_ENABLE | CP15_ITCM_ENABLE;
+        dtcm_region = 0xFFF0000A;
+        itcm_region = 0x00000024;
+        update_tcm();
+
+        if (!mpu_pages)
+        {
+            mpu_pages = new uint8_t[MEMMAP_PAGES];
+            mpu_user_pages = new uint8_t[MEMMAP_PAGES];
+        }
+        update_mpu();
     }
     else
+        control = 0x00000078;
+    vector_base = (control & CP15_HIGH_VECTORS) ? 0xFFFF0000 : 0;
+}
+
+//Region sizes are 512 << n bytes, at least 4 KB. The ITCM's base is fixed at 0, and the DTCM's is aligned to its size.
+void CP15::update_tcm()
+{
+    int itcm_shift = (itcm_region >> 1) & 0x1F;
+    int dtcm_shift = (dtcm_region >> 1) & 0x1F;
+    if (itcm_shift < 3)
+        itcm_shift = 3;
+    if (dtcm_shift < 3)
+        dtcm_shift = 3;
+
+    //Sizes of 4 GB don't fit, and nothing needs them
+    if (itcm_shift > 22)
+        itcm_shift = 22;
+    if (dtcm_shift > 22)
+        dtcm_shift = 22;
+
+    itcm_size = (control & CP15_ITCM_ENABLE) ? (512 << itcm_shift) : 0;
+    dtcm_size = (control & CP15_DTCM_ENABLE) ? (512 << dtcm_shift) : 0;
+    dtcm_base = dtcm_region & ~((512 << dtcm_shift) - 1);
+    cpu->update_tcm();
+}
+
+//Regions are 2 << n bytes, at least 4 KB, with bases aligned to their size. Where they overlap, the
+//highest-numbered one wins, so they're laid down in order.
+void CP15::update_mpu()
+{
+    if (!(control & CP15_MPU_ENABLE))
     {
-        itcm_size = 0;
-        dtcm_base = 0;
-        dtcm_size = 0;
+        memset(mpu_pages, MPU_READ | MPU_WRITE | MPU_EXEC, MEMMAP_PAGES);
+        memset(mpu_user_pages, MPU_READ | MPU_WRITE | MPU_EXEC, MEMMAP_PAGES);
+    }
+    else
+    {
+        //Anything outside the regions aborts
+        memset(mpu_pages, 0, MEMMAP_PAGES);
+        memset(mpu_user_pages, 0, MEMMAP_PAGES);
+        for (int i = 0; i < 8; i++)
+        {
+            uint32_t region = mpu_regions[i];
+            if (!(region & 0x1))
+                continue;
+
+            int shift = ((region >> 1) & 0x1F) + 1;
+            if (shift < MEMMAP_PAGE_SHIFT)
+                shift = MEMMAP_PAGE_SHIFT;
+            uint64_t size = 1ULL << shift;
+            uint32_t base = region & ~(size - 1);
+
+            //Privileged access is allowed by every permission other than 0, and is read-only for 5 and 6.
+            //User mode may read with 2, 3 and 6, and write with 3 only.
+            uint8_t flags = 0, user_flags = 0;
+            int data_ap = (data_perms >> (i * 4)) & 0xF;
+            int instr_ap = (instr_perms >> (i * 4)) & 0xF;
+            if (data_ap && data_ap != 4 && data_ap < 7)
+                flags |= MPU_READ;
+            if (data_ap && data_ap < 4)
+                flags |= MPU_WRITE;
+            if (instr_ap && instr_ap != 4 && instr_ap < 7)
+                flags |= MPU_EXEC;
+            if (data_ap == 2 || data_ap == 3 || data_ap == 6)
+                user_flags |= MPU_READ;
+            if (data_ap == 3)
+                user_flags |= MPU_WRITE;
+            if (instr_ap == 2 || instr_ap == 3 || instr_ap == 6)
+                user_flags |= MPU_EXEC;
+            if (dcache_bits & (1 << i))
+                flags |= MPU_DCACHE;
+            if (icache_bits & (1 << i))
+                flags |= MPU_ICACHE;
+            if (write_buffer_bits & (1 << i))
+                flags |= MPU_BUFFER;
+            memset(mpu_pages + (base >> MEMMAP_PAGE_SHIFT), flags, size >> MEMMAP_PAGE_SHIFT);
+            memset(mpu_user_pages + (base >> MEMMAP_PAGE_SHIFT), user_flags, size >> MEMMAP_PAGE_SHIFT);
+        }
     }
+    cpu->update_mpu();
+}
+
+//The ARM9's protection unit registers, other than the legacy c5 permissions, which are translated
+uint32_t* CP15::get_mpu_reg(uint16_t op)
+{
+    if ((op & 0xF0F) == 0x600)
+        return &mpu_regions[(op >> 4) & 0x7];
+    switch (op)
+    {
+        case 0x200:
+            return &dcache_bits;
+        case 0x201:
+            return &icache_bits;
+        case 0x300:
+            return &write_buffer_bits;
+        case 0x502:
+            return &data_perms;
+        case 0x503:
+            return &instr_perms;
+    }
+    return nullptr;
 }
 
 uint32_t CP15::mrc(int operation_mode, int CP_reg, int coprocessor_info, int coprocessor_operand)
@@ -28,31 +164,149 @@ uint32_t CP15::mrc(int operation_mode, int CP_reg, int coprocessor_info, int cop
     //Don't know if operation mode is used for anything. Let's just keep it around for now
     (void)operation_mode;
     uint16_t op = (CP_reg << 8) | (coprocessor_operand << 4) | coprocessor_info;
+    if (has_tcm)
+    {
+        uint32_t* reg = get_mpu_reg(op);
+        if (reg)
+            return *reg;
+
+        //The legacy permission registers only hold the low 2 bits of each region's
+        if (op == 0x500 || op == 0x501)
+        {
+            uint32_t perms = (op == 0x500) ? data_perms : instr_perms;
+            uint32_t value = 0;
+            for (int i = 0; i < 8; i++)
+                value |= ((perms >> (i * 4)) & 0x3) << (i * 2);
+            return value;
+        }
+    }
     switch (op)
     {
         case 0x050:
             return id;
-        default:
-            printf("[CP15] Unrecognized MRC op $%04X\n", op);
-            return 0;
+        case 0x100:
+            return control;
+        case 0x200:
+            return ttbr0;
+        case 0x201:
+            return ttbr1;
+        case 0x202:
+            return ttbcr;
+        case 0x300:
+            return dacr;
+        case 0x910:
+            if (has_tcm)
+                return dtcm_region;
+            break;
+        case 0x911:
+            if (has_tcm)
+                return itcm_region;
+            break;
     }
+    printf("[CP15] Unrecognized MRC op $%04X\n", op);
+    return 0;
 }
 
+//The ARM9 has TCM and a protection unit, while the ARM11 has an MMU instead.
+//Anything that changes how the ARM11 translates addresses drops its TLB.
 void CP15::mcr(int operation_mode, int CP_reg, int coprocessor_info, int coprocessor_operand, uint32_t value)
 {
     (void)operation_mode;
-    (void)value;
     uint16_t op = (CP_reg << 8) | (coprocessor_operand << 4) | coprocessor_info;
+
+    //TLB maintenance. By-address invalidations still flush everything, as one entry may cover many pages.
+    if (CP_reg == 8 && !has_tcm)
+    {
+        cpu->flush_tlb();
+        if (coprocessor_info == 1)
+            cpu->invalidate_code(value);
+        else
+            cpu->flush_code_cache();
+        return;
+    }
+
+    if (has_tcm)
+    {
+        uint32_t* reg = get_mpu_reg(op);
+        if (op == 0x500 || op == 0x501)
+        {
+            uint32_t perms = 0;
+            for (int i = 0; i < 8; i++)
+                perms |= ((value >> (i * 2)) & 0x3) << (i * 4);
+            reg = (op == 0x500) ? &data_perms : &instr_perms;
+            value = perms;
+        }
+        if (reg)
+        {
+            *reg = value;
+            update_mpu();
+            return;
+        }
+    }
+
     switch (op)
     {
+        case 0x100:
+        {
+            uint32_t old_control = control;
+            control = value;
+            vector_base = (control & CP15_HIGH_VECTORS) ? 0xFFFF0000 : 0;
+            if (has_tcm && ((old_control ^ value) & (CP15_DTCM_ENABLE | CP15_ITCM_ENABLE)))
+                update_tcm();
+            if (has_tcm && ((old_control ^ value) & CP15_MPU_ENABLE))
+                update_mpu();
+            if (!has_tcm && ((old_control ^ value) & CP15_MMU_ENABLE))
+                cpu->set_mmu_enabled(value & CP15_MMU_ENABLE);
+            return;
+        }
+        case 0x200:
+        case 0x201:
+        case 0x202:
+        case 0x300:
+        case 0xD01:
+            if (has_tcm)
+                break;
+            if (op == 0x200)
+                ttbr0 = value;
+            else if (op == 0x201)
+                ttbr1 = value;
+            else if (op == 0x202)
+                ttbcr = value;
+            else if (op == 0x300)
+                dacr = value;
+
+            //Cached code is tagged by virtual address, so it goes along with the old translations
+            cpu->flush_tlb();
+            cpu->flush_code_cache();
+            return;
         case 0x704:
             cpu->halt();
-            break;
+            return;
+        case 0x750:
+        case 0x770:
+            //Invalidate the instruction cache. Writes are caught anyway while the MMU is off, but with it on,
+            //code written through another virtual address relies on this.
+            cpu->flush_code_cache();
+            return;
+        case 0x751:
+            cpu->invalidate_code(value);
+            return;
         case 0x7A4:
-            break;
+            return;
         case 0x7E1:
-            break;
-        default:
-            printf("[CP15] Unrecognized MCR op $%04X\n", op);
+            return;
+        case 0x910:
+            if (!has_tcm)
+                break;
+            dtcm_region = value;
+            update_tcm();
+            return;
+        case 0x911:
+            if (!has_tcm)
+                break;
+            itcm_region = value;
+            update_tcm();
+            return;
     }
+    printf("[CP15] Unrecognized MCR op $%04X\n", op);
 }
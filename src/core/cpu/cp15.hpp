@@ -2,6 +2,17 @@
 #define CP15_HPP
 #include <cstdint>
 
+//Flags of each 4 KB page in CP15::mpu_pages and mpu_user_pages. The caching bits are only set in mpu_pages.
+#define MPU_READ (1 << 0)
+#define MPU_WRITE (1 << 1)
+#define MPU_EXEC (1 << 2)
+#define MPU_DCACHE (1 << 3)
+#define MPU_ICACHE (1 << 4)
+#define MPU_BUFFER (1 << 5)
+
+#define CP15_ITCM_SIZE (1024 * 32)
+#define CP15_DTCM_SIZE (1024 * 16)
+
 class ARM_CPU;
 
 class CP15
@@ -9,12 +20,43 @@ class CP15
     private:
         int id;
         ARM_CPU* cpu;
+        bool has_tcm;
+
+        //c1 and, on the ARM9, the c9 TCM region registers
+        uint32_t control;
+        uint32_t dtcm_region, itcm_region;
+
+        //The ARM9's protection unit: c6 regions, c2/c3 cacheability and write buffer bits, and c5 permissions,
+        //kept in their extended form of 4 bits per region
+        uint32_t mpu_regions[8];
+        uint32_t dcache_bits, icache_bits, write_buffer_bits;
+        uint32_t data_perms, instr_perms;
+
+        void update_tcm();
+        void update_mpu();
+        uint32_t* get_mpu_reg(uint16_t op);
     public:
-        uint8_t ITCM[1024 * 32], DTCM[1024 * 16];
+        //Part of the emulator's guest memory, null on the ARM11
+        uint8_t* ITCM, *DTCM;
 
+        //Derived from the registers above. A disabled TCM has a size of 0.
         uint32_t itcm_size;
         uint32_t dtcm_base, dtcm_size;
-        CP15(int id, ARM_CPU* cpu);
+
+        //Where exception vectors are fetched from, $FFFF0000 while the V bit is set
+        uint32_t vector_base;
+
+        //MMU registers on the ARM11, read by the core's page table walks
+        uint32_t ttbr0, ttbr1, ttbcr;
+        uint32_t dacr;
+
+        //The protection unit's regions compiled into one byte of flags per page for privileged modes and another
+        //for user mode, null on the ARM11. Everything is allowed while it's off.
+        uint8_t* mpu_pages;
+        uint8_t* mpu_user_pages;
+
+        CP15(int id, ARM_CPU* cpu, uint8_t* ITCM = nullptr, uint8_t* DTCM = nullptr);
+        ~CP15();
 
         void reset(bool has_tcm);
 
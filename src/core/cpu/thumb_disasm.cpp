@@ -4,110 +4,6 @@
 
 using namespace std;
 
-THUMB_INSTR decode_thumb(uint16_t instr)
-{
-    uint16_t instr13 = instr >> 13;
-    uint16_t instr12 = instr >> 12;
-    uint16_t instr11 = instr >> 11;
-    uint16_t instr10 = instr >> 10;
-    switch (instr11)
-    {
-        case 0x4:
-            return THUMB_MOV_IMM;
-        case 0x5:
-            return THUMB_CMP_IMM;
-        case 0x6:
-            return THUMB_ADD_IMM;
-        case 0x7:
-            return THUMB_SUB_IMM;
-        case 0x9:
-            return THUMB_PC_REL_LOAD;
-        case 0x10:
-            return THUMB_STORE_HALFWORD;
-        case 0x11:
-            return THUMB_LOAD_HALFWORD;
-        case 0x12:
-            return THUMB_SP_REL_STORE;
-        case 0x13:
-            return THUMB_SP_REL_LOAD;
-        case 0x18:
-            return THUMB_STORE_MULTIPLE;
-        case 0x19:
-            return THUMB_LOAD_MULTIPLE;
-        case 0x1C:
-            return THUMB_BRANCH;
-        case 0x1D:
-            return THUMB_LONG_BLX;
-    }
-    if (instr13 == 0)
-    {
-        if ((instr11 & 0x3) != 0x3)
-            return THUMB_MOV_SHIFT;
-        else
-        {
-            if ((instr & (1 << 9)) != 0)
-                return THUMB_SUB_REG;
-            return THUMB_ADD_REG;
-        }
-    }
-    if (instr10 == 0x10)
-        return THUMB_ALU_OP;
-    if (instr10 == 0x11)
-        return THUMB_HI_REG_OP;
-    if (instr12 == 0x5)
-    {
-        if ((instr & (1 << 9)) == 0)
-        {
-            if ((instr & (1 << 11)) == 0)
-                return THUMB_STORE_REG_OFFSET;
-            return THUMB_LOAD_REG_OFFSET;
-        }
-        return THUMB_LOAD_STORE_SIGN_HALFWORD;
-    }
-    if (instr13 == 0x3)
-    {
-        if ((instr & (1 << 11)) == 0)
-            return THUMB_STORE_IMM_OFFSET;
-        return THUMB_LOAD_IMM_OFFSET;
-    }
-    if (instr12 == 0xA)
-        return THUMB_LOAD_ADDRESS;
-    if (instr12 == 0xB)
-    {
-        if (((instr >> 9) & 0x3) == 0x2)
-        {
-            if ((instr & (1 << 11)) != 0)
-                return THUMB_POP;
-            return THUMB_PUSH;
-        }
-        if (instr & (1 << 9))
-        {
-            int op = (instr >> 6) & 0x3;
-            switch (op)
-            {
-                case 0:
-                    return THUMB_SXTH;
-                case 1:
-                    return THUMB_SXTB;
-                case 2:
-                    return THUMB_UXTH;
-                case 3:
-                    return THUMB_UXTB;
-            }
-        }
-        return THUMB_OFFSET_SP;
-    }
-    if (instr12 == 0xD)
-        return THUMB_COND_BRANCH;
-    if (instr12 == 0xF)
-    {
-        if ((instr & (1 << 11)) == 0)
-            return THUMB_LONG_BRANCH_PREP;
-        return THUMB_LONG_BRANCH;
-    }
-    return THUMB_UNDEFINED;
-}
-
 namespace ARM_Disasm
 {
 
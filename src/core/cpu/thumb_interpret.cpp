@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <utility>
 #include "arm.hpp"
 #include "arm_interpret.hpp"
 #include "arm_disasm.hpp"
@@ -7,115 +8,291 @@
 namespace ARM_Interpreter
 {
 
-void interpret_thumb(ARM_CPU &cpu, uint16_t instr)
+static constexpr Thumb_Handler get_thumb_handler(THUMB_INSTR kind)
 {
-    switch (decode_thumb(instr))
+    switch (kind)
     {
         case THUMB_MOV_SHIFT:
-            thumb_move_shift(cpu, instr);
-            break;
+            return thumb_move_shift;
         case THUMB_ADD_REG:
-            thumb_add_reg(cpu, instr);
-            break;
+            return thumb_add_reg;
         case THUMB_SUB_REG:
-            thumb_sub_reg(cpu, instr);
-            break;
+            return thumb_sub_reg;
         case THUMB_MOV_IMM:
-            thumb_mov(cpu, instr);
-            break;
+            return thumb_mov;
         case THUMB_CMP_IMM:
-            thumb_cmp(cpu, instr);
-            break;
+            return thumb_cmp;
         case THUMB_ADD_IMM:
-            thumb_add(cpu, instr);
-            break;
+            return thumb_add;
         case THUMB_SUB_IMM:
-            thumb_sub(cpu, instr);
-            break;
+            return thumb_sub;
         case THUMB_ALU_OP:
-            thumb_alu(cpu, instr);
-            break;
+            return thumb_alu;
         case THUMB_HI_REG_OP:
-            thumb_hi_reg_op(cpu, instr);
-            break;
+            return thumb_hi_reg_op;
         case THUMB_LOAD_IMM_OFFSET:
-            thumb_load_imm(cpu, instr);
-            break;
+            return thumb_load_imm;
         case THUMB_STORE_IMM_OFFSET:
-            thumb_store_imm(cpu, instr);
-            break;
+            return thumb_store_imm;
         case THUMB_LOAD_REG_OFFSET:
-            thumb_load_reg(cpu, instr);
-            break;
+            return thumb_load_reg;
         case THUMB_STORE_REG_OFFSET:
-            thumb_store_reg(cpu, instr);
-            break;
+            return thumb_store_reg;
         case THUMB_LOAD_HALFWORD:
-            thumb_load_halfword(cpu, instr);
-            break;
+            return thumb_load_halfword;
         case THUMB_STORE_HALFWORD:
-            thumb_store_halfword(cpu, instr);
-            break;
+            return thumb_store_halfword;
         case THUMB_LOAD_STORE_SIGN_HALFWORD:
-            thumb_load_store_signed(cpu, instr);
-            break;
+            return thumb_load_store_signed;
         case THUMB_LOAD_MULTIPLE:
-            thumb_load_block(cpu, instr);
-            break;
+            return thumb_load_block;
         case THUMB_STORE_MULTIPLE:
-            thumb_store_block(cpu, instr);
-            break;
+            return thumb_store_block;
         case THUMB_PUSH:
-            thumb_push(cpu, instr);
-            break;
+            return thumb_push;
         case THUMB_POP:
-            thumb_pop(cpu, instr);
-            break;
+            return thumb_pop;
         case THUMB_PC_REL_LOAD:
-            thumb_pc_rel_load(cpu, instr);
-            break;
+            return thumb_pc_rel_load;
         case THUMB_LOAD_ADDRESS:
-            thumb_load_addr(cpu, instr);
-            break;
+            return thumb_load_addr;
         case THUMB_SP_REL_LOAD:
-            thumb_sp_rel_load(cpu, instr);
-            break;
+            return thumb_sp_rel_load;
         case THUMB_SP_REL_STORE:
-            thumb_sp_rel_store(cpu, instr);
-            break;
+            return thumb_sp_rel_store;
         case THUMB_OFFSET_SP:
-            thumb_offset_sp(cpu, instr);
-            break;
+            return thumb_offset_sp;
         case THUMB_SXTH:
-            thumb_sxth(cpu, instr);
-            break;
+            return thumb_sxth;
         case THUMB_SXTB:
-            thumb_sxtb(cpu, instr);
-            break;
+            return thumb_sxtb;
         case THUMB_UXTH:
-            thumb_uxth(cpu, instr);
-            break;
+            return thumb_uxth;
         case THUMB_UXTB:
-            thumb_uxtb(cpu, instr);
-            break;
+            return thumb_uxtb;
         case THUMB_BRANCH:
-            thumb_branch(cpu, instr);
-            break;
+            return thumb_branch;
         case THUMB_COND_BRANCH:
-            thumb_cond_branch(cpu, instr);
-            break;
+            return thumb_cond_branch;
         case THUMB_LONG_BRANCH_PREP:
-            thumb_long_branch_prep(cpu, instr);
-            break;
+            return thumb_long_branch_prep;
         case THUMB_LONG_BRANCH:
-            thumb_long_branch(cpu, instr);
-            break;
+            return thumb_long_branch;
         case THUMB_LONG_BLX:
-            thumb_long_blx(cpu, instr);
+            return thumb_long_blx;
+        default:
+            return thumb_undefined;
+    }
+}
+
+//Format 4 ALU ops, one handler per opcode. Their destination is always a low register, so none can write PC.
+template <int opcode>
+static void thumb_alu_op(ARM_CPU& cpu, uint16_t instr)
+{
+    uint32_t destination = instr & 0x7;
+    uint32_t source = cpu.get_register((instr >> 3) & 0x7);
+    uint32_t dest_value = cpu.get_register(destination);
+    uint32_t result;
+
+    switch (opcode)
+    {
+        case 0x0:
+            result = dest_value & source;
+            break;
+        case 0x1:
+            result = dest_value ^ source;
+            break;
+        case 0x2:
+            cpu.set_register(destination, cpu.lsl(dest_value, source, true));
+            return;
+        case 0x3:
+            cpu.set_register(destination, cpu.lsr(dest_value, source, true));
+            return;
+        case 0x4:
+            cpu.set_register(destination, cpu.asr(dest_value, source, true));
+            return;
+        case 0x5:
+            cpu.adc(destination, dest_value, source, true);
+            return;
+        case 0x6:
+            cpu.sbc(destination, dest_value, source, true);
+            return;
+        case 0x7:
+            cpu.set_register(destination, cpu.rotr32(dest_value, source, true));
+            return;
+        case 0x8:
+            cpu.set_zero_neg_flags(dest_value & source);
+            return;
+        case 0x9:
+            //NEG is the same thing as RSBS Rd, Rs, #0
+            cpu.set_register(destination, 0 - source);
+            cpu.cmp(0, source);
+            return;
+        case 0xA:
+            cpu.cmp(dest_value, source);
+            return;
+        case 0xB:
+            cpu.cmn(dest_value, source);
+            return;
+        case 0xC:
+            result = dest_value | source;
+            break;
+        case 0xD:
+            result = dest_value * source;
+            break;
+        case 0xE:
+            result = dest_value & ~source;
             break;
         default:
-            EmuException::die("[Thumb_Interpreter] Undefined Thumb instr $%04X\n", instr);
+            result = ~source;
+            break;
     }
+
+    cpu.set_register(destination, result);
+    cpu.set_zero_neg_flags(result);
+}
+
+//Format 5 ops, specialized on the opcode and the H1/H2 high register bits
+template <int opcode, bool high_dest, bool high_source>
+static void thumb_hi_reg(ARM_CPU& cpu, uint16_t instr)
+{
+    uint32_t source = ((instr >> 3) & 0x7) | (high_source ? 8 : 0);
+    uint32_t destination = (instr & 0x7) | (high_dest ? 8 : 0);
+
+    switch (opcode)
+    {
+        case 0x0:
+            if (high_dest && destination == REG_PC)
+                cpu.jp(cpu.get_PC() + cpu.get_register(source), false);
+            else
+                cpu.set_register(destination, cpu.get_register(destination) + cpu.get_register(source));
+            break;
+        case 0x1:
+            cpu.cmp(cpu.get_register(destination), cpu.get_register(source));
+            break;
+        case 0x2:
+            if (high_dest && destination == REG_PC)
+                cpu.jp(cpu.get_register(source), false);
+            else
+                cpu.set_register(destination, cpu.get_register(source));
+            break;
+        default:
+            if (high_dest)
+                cpu.set_register(REG_LR, cpu.get_PC() - 1);
+            cpu.jp(cpu.get_register(source), true);
+            break;
+    }
+}
+
+struct Thumb_SubTable
+{
+    Thumb_Handler handlers[16];
+};
+
+//Both ALU formats are keyed on bits 9-6, which the main table already indexes on
+template <size_t... keys>
+static constexpr Thumb_SubTable build_thumb_alu_table(std::index_sequence<keys...>)
+{
+    return {{ thumb_alu_op<keys>... }};
+}
+
+template <size_t... keys>
+static constexpr Thumb_SubTable build_thumb_hi_reg_table(std::index_sequence<keys...>)
+{
+    return {{ thumb_hi_reg<(keys >> 2), ((keys >> 1) & 0x1), (keys & 0x1)>... }};
+}
+
+static constexpr Thumb_SubTable thumb_alu_table = build_thumb_alu_table(std::make_index_sequence<16>());
+static constexpr Thumb_SubTable thumb_hi_reg_table = build_thumb_hi_reg_table(std::make_index_sequence<16>());
+
+static constexpr Thumb_Handler get_thumb_instr_handler(uint16_t instr)
+{
+    THUMB_INSTR kind = decode_thumb(instr);
+    if (kind == THUMB_ALU_OP)
+        return thumb_alu_table.handlers[(instr >> 6) & 0xF];
+    if (kind == THUMB_HI_REG_OP)
+        return thumb_hi_reg_table.handlers[(instr >> 6) & 0xF];
+    return get_thumb_handler(kind);
+}
+
+//Every Thumb encoding decodes the same way as all others sharing its top 10 bits,
+//so one table slot per (instr >> 6) covers the whole instruction space
+struct Thumb_Table
+{
+    Thumb_Handler handlers[1024];
+};
+
+static constexpr Thumb_Table build_thumb_table()
+{
+    Thumb_Table table = {};
+    for (int i = 0; i < 1024; i++)
+        table.handlers[i] = get_thumb_instr_handler(i << 6);
+    return table;
+}
+
+static constexpr Thumb_Table thumb_table = build_thumb_table();
+
+static constexpr bool thumb_table_matches(uint32_t start, uint32_t end)
+{
+    for (uint32_t instr = start; instr < end; instr++)
+    {
+        if (thumb_table.handlers[instr >> 6] != get_thumb_instr_handler(instr))
+            return false;
+    }
+    return true;
+}
+
+//Split into quarters to stay within the compilers' constexpr evaluation limits
+static_assert(thumb_table_matches(0x0000, 0x4000), "Thumb dispatch table disagrees with decode_thumb");
+static_assert(thumb_table_matches(0x4000, 0x8000), "Thumb dispatch table disagrees with decode_thumb");
+static_assert(thumb_table_matches(0x8000, 0xC000), "Thumb dispatch table disagrees with decode_thumb");
+static_assert(thumb_table_matches(0xC000, 0x10000), "Thumb dispatch table disagrees with decode_thumb");
+
+void interpret_thumb(ARM_CPU &cpu, uint16_t instr)
+{
+    thumb_table.handlers[instr >> 6](cpu, instr);
+}
+
+void predecode_thumb(ARM_CPU &cpu, uint16_t instr, ARM_Predecoded &entry)
+{
+    entry.instr = instr;
+    entry.thumb_handler = thumb_table.handlers[instr >> 6];
+    entry.thumb_kind = decode_thumb(instr);
+    entry.cond = 0xE;
+    entry.dispatch = entry.thumb_kind;
+    entry.ends_block = thumb_ends_block(instr, entry.thumb_kind);
+    entry.cycles = ARM_Timing::thumb_cycles(cpu.get_cycle_table(), instr, entry.thumb_kind);
+}
+
+bool thumb_ends_block(uint16_t instr, THUMB_INSTR kind)
+{
+    switch (kind)
+    {
+        case THUMB_HI_REG_OP:
+        {
+            //BX/BLX, or an ADD/MOV into PC
+            int opcode = (instr >> 8) & 0x3;
+            int destination = (instr & 0x7) | ((instr >> 4) & 0x8);
+            return opcode == 3 || (opcode != 1 && destination == REG_PC);
+        }
+        case THUMB_POP:
+            return instr & (1 << 8);
+        case THUMB_BRANCH:
+        case THUMB_COND_BRANCH:
+        case THUMB_LONG_BRANCH:
+        case THUMB_LONG_BLX:
+        case THUMB_SWI:
+        case THUMB_UNDEFINED:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void thumb_undefined(ARM_CPU &cpu, uint16_t instr)
+{
+    (void)cpu;
+    EmuException::die("[Thumb_Interpreter] Undefined Thumb instr $%04X\n", instr);
 }
 
 void thumb_move_shift(ARM_CPU &cpu, uint16_t instr)
@@ -209,132 +386,12 @@ void thumb_sub(ARM_CPU &cpu, uint16_t instr)
 
 void thumb_alu(ARM_CPU &cpu, uint16_t instr)
 {
-    uint32_t destination = instr & 0x7;
-    uint32_t source = (instr >> 3) & 0x7;
-    int opcode = (instr >> 6) & 0xF;
-
-    switch (opcode)
-    {
-        case 0x0:
-            cpu.andd(destination, cpu.get_register(destination), cpu.get_register(source), true);
-            break;
-        case 0x1:
-            cpu.eor(destination, cpu.get_register(destination), cpu.get_register(source), true);
-            break;
-        case 0x2:
-        {
-            uint32_t reg = cpu.get_register(destination);
-            reg = cpu.lsl(reg, cpu.get_register(source), true);
-            cpu.set_register(destination, reg);
-        }
-            break;
-        case 0x3:
-        {
-            uint32_t reg = cpu.get_register(destination);
-            reg = cpu.lsr(reg, cpu.get_register(source), true);
-            cpu.set_register(destination, reg);
-        }
-            break;
-        case 0x4:
-        {
-            uint32_t reg = cpu.get_register(destination);
-            reg = cpu.asr(reg, cpu.get_register(source), true);
-            cpu.set_register(destination, reg);
-        }
-            break;
-        case 0x5:
-            cpu.adc(destination, cpu.get_register(destination), cpu.get_register(source), true);
-            break;
-        case 0x6:
-            cpu.sbc(destination, cpu.get_register(destination), cpu.get_register(source), true);
-            break;
-        case 0x7:
-        {
-            uint32_t reg = cpu.get_register(destination);
-            reg = cpu.rotr32(reg, cpu.get_register(source), true);
-            cpu.set_register(destination, reg);
-        }
-            break;
-        case 0x8:
-            cpu.tst(cpu.get_register(destination), cpu.get_register(source));
-            break;
-        case 0x9:
-            //NEG is the same thing as RSBS Rd, Rs, #0
-            cpu.sub(destination, 0, cpu.get_register(source), true);
-            break;
-        case 0xA:
-            cpu.cmp(cpu.get_register(destination), cpu.get_register(source));
-            break;
-        case 0xB:
-            cpu.cmn(cpu.get_register(destination), cpu.get_register(source));
-            break;
-        case 0xC:
-            cpu.orr(destination, cpu.get_register(destination), cpu.get_register(source), true);
-            break;
-        case 0xD:
-            cpu.mul(destination, cpu.get_register(destination), cpu.get_register(source), true);
-            /*if (!cpu.get_id())
-                cpu.add_internal_cycles(3);
-            else
-            {
-                uint32_t multiplicand = cpu.get_register(destination);
-                if (multiplicand & 0xFF000000)
-                    cpu.add_internal_cycles(4);
-                else if (multiplicand & 0x00FF0000)
-                    cpu.add_internal_cycles(3);
-                else if (multiplicand & 0x0000FF00)
-                    cpu.add_internal_cycles(2);
-                else
-                    cpu.add_internal_cycles(1);
-            }*/
-            break;
-        case 0xE:
-            cpu.bic(destination, cpu.get_register(destination), cpu.get_register(source), true);
-            break;
-        case 0xF:
-            cpu.mvn(destination, cpu.get_register(source), true);
-            break;
-        default:
-            printf("Invalid thumb alu op %d\n", opcode);
-    }
+    thumb_alu_table.handlers[(instr >> 6) & 0xF](cpu, instr);
 }
 
 void thumb_hi_reg_op(ARM_CPU &cpu, uint16_t instr)
 {
-    int opcode = (instr >> 8) & 0x3;
-    bool high_source = (instr & (1 << 6)) != 0;
-    bool high_dest = (instr & (1 << 7)) != 0;
-
-    uint32_t source = (instr >> 3) & 0x7;
-    source |= high_source * 8;
-    uint32_t destination = instr & 0x7;
-    destination |= high_dest * 8;
-
-    switch (opcode)
-    {
-        case 0x0:
-            if (destination == REG_PC)
-                cpu.jp(cpu.get_PC() + cpu.get_register(source), false);
-            else
-                cpu.add(destination, cpu.get_register(destination), cpu.get_register(source), false);
-            break;
-        case 0x1:
-            cpu.cmp(cpu.get_register(destination), cpu.get_register(source));
-            break;
-        case 0x2:
-            if (destination == REG_PC)
-                cpu.jp(cpu.get_register(source), false);
-            else
-                cpu.mov(destination, cpu.get_register(source), false);
-            break;
-        case 0x3:
-            if (high_dest)
-                cpu.set_register(REG_LR, cpu.get_PC() - 1);
-            cpu.jp(cpu.get_register(source), true);
-            break;
-        default:
-            printf("High-reg Thumb opcode $%02X not recognized\n", opcode);
-    }
+    thumb_hi_reg_table.handlers[(instr >> 6) & 0xF](cpu, instr);
 }
 
 void thumb_load_imm(ARM_CPU &cpu, uint16_t instr)
@@ -513,6 +570,25 @@ void thumb_load_block(ARM_CPU &cpu, uint16_t instr)
 
     uint32_t address = cpu.get_register(base);
 
+    //Fast path: when the whole range is plain RAM, resolve it once and copy the registers directly
+    int count = count_regs(reg_list);
+    uint8_t* mem = count ? cpu.get_ram_block(address, count * 4, false) : nullptr;
+    if (mem)
+    {
+        for (int reg = 0; reg < 8; reg++)
+        {
+            if (reg_list & (1 << reg))
+            {
+                cpu.set_register(reg, *(uint32_t*)mem);
+                mem += 4;
+            }
+        }
+
+        if (!(reg_list & (1 << base)))
+            cpu.set_register(base, address + (count * 4));
+        return;
+    }
+
     int regs = 0;
     for (int reg = 0; reg < 8; reg++)
     {
@@ -542,6 +618,23 @@ void thumb_store_block(ARM_CPU &cpu, uint16_t instr)
 
     uint32_t address = cpu.get_register(base);
 
+    int count = count_regs(reg_list);
+    uint8_t* mem = count ? cpu.get_ram_block(address, count * 4, true) : nullptr;
+    if (mem)
+    {
+        for (int reg = 0; reg < 8; reg++)
+        {
+            if (reg_list & (1 << reg))
+            {
+                *(uint32_t*)mem = cpu.get_register(reg);
+                mem += 4;
+            }
+        }
+
+        cpu.set_register(base, address + (count * 4));
+        return;
+    }
+
     int regs = 0;
     for (int reg = 0; reg < 8; reg++)
     {
@@ -565,6 +658,26 @@ void thumb_push(ARM_CPU &cpu, uint16_t instr)
     int reg_list = instr & 0xFF;
     uint32_t stack_pointer = cpu.get_register(REG_SP);
 
+    //Registers are stored in ascending order at ascending addresses, with LR on top
+    int count = count_regs(instr & 0x1FF);
+    uint8_t* mem = count ? cpu.get_ram_block(stack_pointer - (count * 4), count * 4, true) : nullptr;
+    if (mem)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            if (reg_list & (1 << i))
+            {
+                *(uint32_t*)mem = cpu.get_register(i);
+                mem += 4;
+            }
+        }
+        if (instr & (1 << 8))
+            *(uint32_t*)mem = cpu.get_register(REG_LR);
+
+        cpu.set_register(REG_SP, stack_pointer - (count * 4));
+        return;
+    }
+
     int regs = 0;
     if (instr & (1 << 8))
     {
@@ -596,6 +709,26 @@ void thumb_pop(ARM_CPU &cpu, uint16_t instr)
     int reg_list = instr & 0xFF;
     uint32_t stack_pointer = cpu.get_register(REG_SP);
 
+    int count = count_regs(instr & 0x1FF);
+    uint8_t* mem = count ? cpu.get_ram_block(stack_pointer, count * 4, false) : nullptr;
+    if (mem)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            if (reg_list & (1 << i))
+            {
+                cpu.set_register(i, *(uint32_t*)mem);
+                mem += 4;
+            }
+        }
+
+        if (instr & (1 << 8))
+            cpu.jp(*(uint32_t*)mem, true);
+
+        cpu.set_register(REG_SP, stack_pointer + (count * 4));
+        return;
+    }
+
     int regs = 0;
     for (int i = 0; i < 8; i++)
     {
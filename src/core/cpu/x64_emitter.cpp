@@ -0,0 +1,454 @@
+#include <cstring>
+#include "x64_emitter.hpp"
+
+X64_Emitter::X64_Emitter()
+{
+    start = nullptr;
+    ptr = nullptr;
+    size = 0;
+}
+
+void X64_Emitter::set_buffer(uint8_t *buffer, size_t size)
+{
+    start = buffer;
+    ptr = buffer;
+    this->size = size;
+}
+
+void X64_Emitter::emit16(uint16_t value)
+{
+    memcpy(ptr, &value, sizeof(value));
+    ptr += sizeof(value);
+}
+
+void X64_Emitter::emit32(uint32_t value)
+{
+    memcpy(ptr, &value, sizeof(value));
+    ptr += sizeof(value);
+}
+
+void X64_Emitter::emit64(uint64_t value)
+{
+    memcpy(ptr, &value, sizeof(value));
+    ptr += sizeof(value);
+}
+
+void X64_Emitter::rex(bool w, int reg, int index, int base)
+{
+    uint8_t value = 0x40 | (w << 3) | ((reg & 0x8) >> 1) | ((index & 0x8) >> 2) | ((base & 0x8) >> 3);
+    if (value != 0x40)
+        emit8(value);
+}
+
+void X64_Emitter::modrm_reg(int reg, int rm)
+{
+    emit8(0xC0 | ((reg & 0x7) << 3) | (rm & 0x7));
+}
+
+void X64_Emitter::modrm_mem(int reg, X64_REG base, int32_t disp)
+{
+    int mod;
+    if (disp == 0 && (base & 0x7) != RBP)
+        mod = 0;
+    else if (disp >= -128 && disp <= 127)
+        mod = 1;
+    else
+        mod = 2;
+
+    emit8((mod << 6) | ((reg & 0x7) << 3) | (base & 0x7));
+
+    //RSP and R12 as a base can only be encoded through a SIB byte
+    if ((base & 0x7) == RSP)
+        emit8(0x24);
+
+    if (mod == 1)
+        emit8(disp);
+    else if (mod == 2)
+        emit32(disp);
+}
+
+void X64_Emitter::modrm_index(int reg, X64_REG base, X64_REG index)
+{
+    if ((base & 0x7) == RBP)
+    {
+        emit8(0x44 | ((reg & 0x7) << 3));
+        emit8(((index & 0x7) << 3) | (base & 0x7));
+        emit8(0);
+    }
+    else
+    {
+        emit8(0x04 | ((reg & 0x7) << 3));
+        emit8(((index & 0x7) << 3) | (base & 0x7));
+    }
+}
+
+void X64_Emitter::mov32_reg_reg(X64_REG dest, X64_REG source)
+{
+    rex(false, source, 0, dest);
+    emit8(0x89);
+    modrm_reg(source, dest);
+}
+
+void X64_Emitter::mov32_reg_imm(X64_REG dest, uint32_t imm)
+{
+    rex(false, 0, 0, dest);
+    emit8(0xB8 + (dest & 0x7));
+    emit32(imm);
+}
+
+void X64_Emitter::mov64_reg_imm(X64_REG dest, uint64_t imm)
+{
+    rex(true, 0, 0, dest);
+    emit8(0xB8 + (dest & 0x7));
+    emit64(imm);
+}
+
+void X64_Emitter::mov64_reg_reg(X64_REG dest, X64_REG source)
+{
+    rex(true, source, 0, dest);
+    emit8(0x89);
+    modrm_reg(source, dest);
+}
+
+void X64_Emitter::mov32_reg_mem(X64_REG dest, X64_REG base, int32_t disp)
+{
+    rex(false, dest, 0, base);
+    emit8(0x8B);
+    modrm_mem(dest, base, disp);
+}
+
+void X64_Emitter::mov32_mem_reg(X64_REG base, int32_t disp, X64_REG source)
+{
+    rex(false, source, 0, base);
+    emit8(0x89);
+    modrm_mem(source, base, disp);
+}
+
+void X64_Emitter::mov32_mem_imm(X64_REG base, int32_t disp, uint32_t imm)
+{
+    rex(false, 0, 0, base);
+    emit8(0xC7);
+    modrm_mem(0, base, disp);
+    emit32(imm);
+}
+
+void X64_Emitter::mov32_reg_index(X64_REG dest, X64_REG base, X64_REG index)
+{
+    rex(false, dest, index, base);
+    emit8(0x8B);
+    modrm_index(dest, base, index);
+}
+
+void X64_Emitter::mov32_index_reg(X64_REG base, X64_REG index, X64_REG source)
+{
+    rex(false, source, index, base);
+    emit8(0x89);
+    modrm_index(source, base, index);
+}
+
+void X64_Emitter::mov16_index_reg(X64_REG base, X64_REG index, X64_REG source)
+{
+    emit8(0x66);
+    rex(false, source, index, base);
+    emit8(0x89);
+    modrm_index(source, base, index);
+}
+
+void X64_Emitter::mov8_index_reg(X64_REG base, X64_REG index, X64_REG source)
+{
+    rex(false, source, index, base);
+    emit8(0x88);
+    modrm_index(source, base, index);
+}
+
+void X64_Emitter::movzx16_reg_index(X64_REG dest, X64_REG base, X64_REG index)
+{
+    rex(false, dest, index, base);
+    emit8(0x0F);
+    emit8(0xB7);
+    modrm_index(dest, base, index);
+}
+
+void X64_Emitter::movzx8_reg_index(X64_REG dest, X64_REG base, X64_REG index)
+{
+    rex(false, dest, index, base);
+    emit8(0x0F);
+    emit8(0xB6);
+    modrm_index(dest, base, index);
+}
+
+void X64_Emitter::movzx8_reg_mem(X64_REG dest, X64_REG base, int32_t disp)
+{
+    rex(false, dest, 0, base);
+    emit8(0x0F);
+    emit8(0xB6);
+    modrm_mem(dest, base, disp);
+}
+
+void X64_Emitter::movzx8_reg_reg(X64_REG dest, X64_REG source)
+{
+    rex(false, dest, 0, source);
+    emit8(0x0F);
+    emit8(0xB6);
+    modrm_reg(dest, source);
+}
+
+void X64_Emitter::mov8_mem_imm(X64_REG base, int32_t disp, uint8_t imm)
+{
+    rex(false, 0, 0, base);
+    emit8(0xC6);
+    modrm_mem(0, base, disp);
+    emit8(imm);
+}
+
+void X64_Emitter::mov8_mem_reg(X64_REG base, int32_t disp, X64_REG source)
+{
+    rex(false, source, 0, base);
+    emit8(0x88);
+    modrm_mem(source, base, disp);
+}
+
+void X64_Emitter::alu32_reg_reg(X64_ALU op, X64_REG dest, X64_REG source)
+{
+    rex(false, source, 0, dest);
+    emit8((op << 3) | 0x1);
+    modrm_reg(source, dest);
+}
+
+void X64_Emitter::alu32_reg_imm(X64_ALU op, X64_REG dest, uint32_t imm)
+{
+    rex(false, 0, 0, dest);
+    if ((int32_t)imm >= -128 && (int32_t)imm <= 127)
+    {
+        emit8(0x83);
+        modrm_reg(op, dest);
+        emit8(imm);
+    }
+    else
+    {
+        emit8(0x81);
+        modrm_reg(op, dest);
+        emit32(imm);
+    }
+}
+
+void X64_Emitter::alu64_reg_imm(X64_ALU op, X64_REG dest, uint32_t imm)
+{
+    rex(true, 0, 0, dest);
+    emit8(0x81);
+    modrm_reg(op, dest);
+    emit32(imm);
+}
+
+void X64_Emitter::alu32_reg_mem(X64_ALU op, X64_REG dest, X64_REG base, int32_t disp)
+{
+    rex(false, dest, 0, base);
+    emit8((op << 3) | 0x3);
+    modrm_mem(dest, base, disp);
+}
+
+void X64_Emitter::alu32_mem_imm(X64_ALU op, X64_REG base, int32_t disp, uint32_t imm)
+{
+    rex(false, 0, 0, base);
+    if ((int32_t)imm >= -128 && (int32_t)imm <= 127)
+    {
+        emit8(0x83);
+        modrm_mem(op, base, disp);
+        emit8(imm);
+    }
+    else
+    {
+        emit8(0x81);
+        modrm_mem(op, base, disp);
+        emit32(imm);
+    }
+}
+
+void X64_Emitter::alu8_mem_imm(X64_ALU op, X64_REG base, int32_t disp, uint8_t imm)
+{
+    rex(false, 0, 0, base);
+    emit8(0x80);
+    modrm_mem(op, base, disp);
+    emit8(imm);
+}
+
+void X64_Emitter::alu8_mem_reg(X64_ALU op, X64_REG base, int32_t disp, X64_REG source)
+{
+    rex(false, source, 0, base);
+    emit8(op << 3);
+    modrm_mem(source, base, disp);
+}
+
+void X64_Emitter::cmp8_reg_mem(X64_REG reg, X64_REG base, int32_t disp)
+{
+    rex(false, reg, 0, base);
+    emit8(0x3A);
+    modrm_mem(reg, base, disp);
+}
+
+void X64_Emitter::test32_reg_reg(X64_REG a, X64_REG b)
+{
+    rex(false, b, 0, a);
+    emit8(0x85);
+    modrm_reg(b, a);
+}
+
+void X64_Emitter::shift32_imm(X64_SHIFT op, X64_REG reg, int count)
+{
+    rex(false, 0, 0, reg);
+    if (count == 1)
+    {
+        emit8(0xD1);
+        modrm_reg(op, reg);
+    }
+    else
+    {
+        emit8(0xC1);
+        modrm_reg(op, reg);
+        emit8(count);
+    }
+}
+
+void X64_Emitter::shift32_cl(X64_SHIFT op, X64_REG reg)
+{
+    rex(false, 0, 0, reg);
+    emit8(0xD3);
+    modrm_reg(op, reg);
+}
+
+void X64_Emitter::not32(X64_REG reg)
+{
+    rex(false, 0, 0, reg);
+    emit8(0xF7);
+    modrm_reg(2, reg);
+}
+
+void X64_Emitter::imul32_reg_reg(X64_REG dest, X64_REG source)
+{
+    rex(false, dest, 0, source);
+    emit8(0x0F);
+    emit8(0xAF);
+    modrm_reg(dest, source);
+}
+
+void X64_Emitter::bt32_reg_imm(X64_REG reg, int bit)
+{
+    rex(false, 0, 0, reg);
+    emit8(0x0F);
+    emit8(0xBA);
+    modrm_reg(4, reg);
+    emit8(bit);
+}
+
+void X64_Emitter::bt32_reg_reg(X64_REG reg, X64_REG bit)
+{
+    rex(false, bit, 0, reg);
+    emit8(0x0F);
+    emit8(0xA3);
+    modrm_reg(bit, reg);
+}
+
+void X64_Emitter::bt32_mem_reg(X64_REG base, int32_t disp, X64_REG bit)
+{
+    rex(false, bit, 0, base);
+    emit8(0x0F);
+    emit8(0xA3);
+    modrm_mem(bit, base, disp);
+}
+
+void X64_Emitter::setcc_mem(X64_COND cond, X64_REG base, int32_t disp)
+{
+    rex(false, 0, 0, base);
+    emit8(0x0F);
+    emit8(0x90 + cond);
+    modrm_mem(0, base, disp);
+}
+
+void X64_Emitter::setcc_reg(X64_COND cond, X64_REG reg)
+{
+    rex(false, 0, 0, reg);
+    emit8(0x0F);
+    emit8(0x90 + cond);
+    modrm_reg(0, reg);
+}
+
+void X64_Emitter::push(X64_REG reg)
+{
+    rex(false, 0, 0, reg);
+    emit8(0x50 + (reg & 0x7));
+}
+
+void X64_Emitter::pop(X64_REG reg)
+{
+    rex(false, 0, 0, reg);
+    emit8(0x58 + (reg & 0x7));
+}
+
+void X64_Emitter::ret()
+{
+    emit8(0xC3);
+}
+
+void X64_Emitter::nop()
+{
+    emit8(0x90);
+}
+
+void X64_Emitter::call_reg(X64_REG reg)
+{
+    rex(false, 0, 0, reg);
+    emit8(0xFF);
+    modrm_reg(2, reg);
+}
+
+void X64_Emitter::jmp_reg(X64_REG reg)
+{
+    rex(false, 0, 0, reg);
+    emit8(0xFF);
+    modrm_reg(4, reg);
+}
+
+void X64_Emitter::jmp_mem(X64_REG base, int32_t disp)
+{
+    rex(false, 0, 0, base);
+    emit8(0xFF);
+    modrm_mem(4, base, disp);
+}
+
+uint8_t* X64_Emitter::jcc(X64_COND cond)
+{
+    emit8(0x0F);
+    emit8(0x80 + cond);
+    uint8_t* branch = ptr;
+    emit32(0);
+    return branch;
+}
+
+uint8_t* X64_Emitter::jmp()
+{
+    emit8(0xE9);
+    uint8_t* branch = ptr;
+    emit32(0);
+    return branch;
+}
+
+void X64_Emitter::jcc(X64_COND cond, uint8_t *target)
+{
+    set_target(jcc(cond), target);
+}
+
+void X64_Emitter::jmp(uint8_t *target)
+{
+    set_target(jmp(), target);
+}
+
+void X64_Emitter::set_target(uint8_t *branch)
+{
+    set_target(branch, ptr);
+}
+
+void X64_Emitter::set_target(uint8_t *branch, uint8_t *target)
+{
+    int32_t offset = (int32_t)(target - (branch + 4));
+    memcpy(branch, &offset, sizeof(offset));
+}
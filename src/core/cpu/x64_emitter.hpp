@@ -0,0 +1,145 @@
+#ifndef X64_EMITTER_HPP
+#define X64_EMITTER_HPP
+#include <cstddef>
+#include <cstdint>
+
+enum X64_REG
+{
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+enum X64_COND
+{
+    CC_O, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+    CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G
+};
+
+enum X64_ALU
+{
+    ALU_ADD = 0,
+    ALU_OR = 1,
+    ALU_ADC = 2,
+    ALU_SBB = 3,
+    ALU_AND = 4,
+    ALU_SUB = 5,
+    ALU_XOR = 6,
+    ALU_CMP = 7
+};
+
+enum X64_SHIFT
+{
+    SHIFT_ROL = 0,
+    SHIFT_ROR = 1,
+    SHIFT_RCL = 2,
+    SHIFT_RCR = 3,
+    SHIFT_SHL = 4,
+    SHIFT_SHR = 5,
+    SHIFT_SAR = 7
+};
+
+#ifdef _WIN32
+#define ABI_PARAM1 RCX
+#define ABI_PARAM2 RDX
+#define ABI_PARAM3 R8
+#else
+#define ABI_PARAM1 RDI
+#define ABI_PARAM2 RSI
+#define ABI_PARAM3 RDX
+#endif
+
+//Byte operands can't be SPL, BPL, SIL or DIL, as those would need an otherwise empty REX prefix
+class X64_Emitter
+{
+    private:
+        uint8_t* start;
+        uint8_t* ptr;
+        size_t size;
+
+        void rex(bool w, int reg, int index, int base);
+        void modrm_reg(int reg, int rm);
+        void modrm_mem(int reg, X64_REG base, int32_t disp);
+        void modrm_index(int reg, X64_REG base, X64_REG index);
+    public:
+        X64_Emitter();
+
+        void set_buffer(uint8_t* buffer, size_t size);
+        uint8_t* get_ptr();
+        size_t get_space_left();
+
+        void emit8(uint8_t value);
+        void emit16(uint16_t value);
+        void emit32(uint32_t value);
+        void emit64(uint64_t value);
+
+        void mov32_reg_reg(X64_REG dest, X64_REG source);
+        void mov32_reg_imm(X64_REG dest, uint32_t imm);
+        void mov64_reg_imm(X64_REG dest, uint64_t imm);
+        void mov64_reg_reg(X64_REG dest, X64_REG source);
+        void mov32_reg_mem(X64_REG dest, X64_REG base, int32_t disp);
+        void mov32_mem_reg(X64_REG base, int32_t disp, X64_REG source);
+        void mov32_mem_imm(X64_REG base, int32_t disp, uint32_t imm);
+        void mov32_reg_index(X64_REG dest, X64_REG base, X64_REG index);
+        void mov32_index_reg(X64_REG base, X64_REG index, X64_REG source);
+        void mov16_index_reg(X64_REG base, X64_REG index, X64_REG source);
+        void mov8_index_reg(X64_REG base, X64_REG index, X64_REG source);
+        void movzx16_reg_index(X64_REG dest, X64_REG base, X64_REG index);
+        void movzx8_reg_index(X64_REG dest, X64_REG base, X64_REG index);
+        void movzx8_reg_mem(X64_REG dest, X64_REG base, int32_t disp);
+        void movzx8_reg_reg(X64_REG dest, X64_REG source);
+        void mov8_mem_imm(X64_REG base, int32_t disp, uint8_t imm);
+        void mov8_mem_reg(X64_REG base, int32_t disp, X64_REG source);
+
+        void alu32_reg_reg(X64_ALU op, X64_REG dest, X64_REG source);
+        void alu32_reg_imm(X64_ALU op, X64_REG dest, uint32_t imm);
+        void alu64_reg_imm(X64_ALU op, X64_REG dest, uint32_t imm);
+        void alu32_reg_mem(X64_ALU op, X64_REG dest, X64_REG base, int32_t disp);
+        void alu32_mem_imm(X64_ALU op, X64_REG base, int32_t disp, uint32_t imm);
+        void alu8_mem_imm(X64_ALU op, X64_REG base, int32_t disp, uint8_t imm);
+        void alu8_mem_reg(X64_ALU op, X64_REG base, int32_t disp, X64_REG source);
+        void cmp8_reg_mem(X64_REG reg, X64_REG base, int32_t disp);
+        void test32_reg_reg(X64_REG a, X64_REG b);
+        void shift32_imm(X64_SHIFT op, X64_REG reg, int count);
+        void shift32_cl(X64_SHIFT op, X64_REG reg);
+        void not32(X64_REG reg);
+        void imul32_reg_reg(X64_REG dest, X64_REG source);
+        void bt32_reg_imm(X64_REG reg, int bit);
+        void bt32_reg_reg(X64_REG reg, X64_REG bit);
+        void bt32_mem_reg(X64_REG base, int32_t disp, X64_REG bit);
+        void setcc_mem(X64_COND cond, X64_REG base, int32_t disp);
+        void setcc_reg(X64_COND cond, X64_REG reg);
+
+        void push(X64_REG reg);
+        void pop(X64_REG reg);
+        void ret();
+        void nop();
+        void call_reg(X64_REG reg);
+        void jmp_reg(X64_REG reg);
+        void jmp_mem(X64_REG base, int32_t disp);
+
+        //Branches return the location of their rel32 field, for set_target
+        uint8_t* jcc(X64_COND cond);
+        uint8_t* jmp();
+        void jcc(X64_COND cond, uint8_t* target);
+        void jmp(uint8_t* target);
+        void set_target(uint8_t* branch);
+        void set_target(uint8_t* branch, uint8_t* target);
+};
+
+inline uint8_t* X64_Emitter::get_ptr()
+{
+    return ptr;
+}
+
+inline size_t X64_Emitter::get_space_left()
+{
+    return size - (ptr - start);
+}
+
+inline void X64_Emitter::emit8(uint8_t value)
+{
+    *ptr = value;
+    ptr++;
+}
+
+#endif // X64_EMITTER_HPP
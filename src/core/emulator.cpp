@@ -1,41 +1,68 @@
 #include <cstdio>
 #include <cstring>
 #include "common/common.hpp"
+#include "core_thread.hpp"
 #include "emulator.hpp"
 
 Emulator::Emulator() :
+    guest_memory(GUEST_MEMORY_SIZE),
+    arm9_mmio("ARM9"),
+    arm11_mmio("ARM11"),
     arm9(this, 9, &arm9_cp15),
     arm11(this, 11, &app_cp15),
-    arm9_cp15(0, &arm9),
+    arm9_cp15(0, &arm9, guest_memory.get_ptr() + ITCM_OFFSET, guest_memory.get_ptr() + DTCM_OFFSET),
     app_cp15(0, &arm11),
     sys_cp15(1, &arm11),
     dma9(this),
     emmc(&int9),
+    gpu(guest_memory.get_ptr() + VRAM_OFFSET, &guest_memory),
     int9(&arm9),
     mpcore_pmr(&arm11),
     pxi(&mpcore_pmr, &int9),
     timers(&int9)
 {
-    arm9_RAM = nullptr;
-    axi_RAM = nullptr;
-    fcram = nullptr;
+    uint8_t* mem = guest_memory.get_ptr();
+    fcram = mem + FCRAM_OFFSET;
+    arm9_RAM = mem + ARM9_RAM_OFFSET;
+    axi_RAM = mem + AXI_RAM_OFFSET;
+    boot9_free = mem + BOOT9_FREE_OFFSET;
+    boot9_locked = mem + BOOT9_LOCKED_OFFSET;
+    boot11_free = mem + BOOT11_FREE_OFFSET;
+    boot11_locked = mem + BOOT11_LOCKED_OFFSET;
+    otp_free = mem + OTP_FREE_OFFSET;
+    otp_locked = mem + OTP_LOCKED_OFFSET;
+    sysprot9 = 0;
+    sysprot11 = 0;
+
+    arm9.set_memory_map(&arm9_map, true);
+    arm11.set_memory_map(&arm11_map, false);
+    arm9.set_other_core(&arm11);
+    arm11.set_other_core(&arm9);
+    map_mmio();
+    set_jit_enabled(true);
+    set_huge_pages_enabled(true);
+    set_fastmem_enabled(true);
+    sync_quantum = CYCLES_PER_SLICE;
+    arm11_thread = nullptr;
 }
 
 Emulator::~Emulator()
 {
-    delete[] arm9_RAM;
-    delete[] axi_RAM;
-    delete[] fcram;
+    delete arm11_thread;
 }
 
 void Emulator::reset(bool cold_boot)
 {
-    if (!arm9_RAM)
-        arm9_RAM = new uint8_t[1024 * 1024];
-    if (!axi_RAM)
-        axi_RAM = new uint8_t[1024 * 512];
-    if (!fcram)
-        fcram = new uint8_t[1024 * 1024 * 128];
+    //RAM comes up zeroed after a power cycle, and the host gets back whatever the last run touched
+    if (cold_boot)
+    {
+        guest_memory.discard(FCRAM_OFFSET, FCRAM_SIZE);
+        guest_memory.discard(VRAM_OFFSET, VRAM_SIZE);
+        guest_memory.discard(ARM9_RAM_OFFSET, ARM9_RAM_SIZE);
+        guest_memory.discard(AXI_RAM_OFFSET, AXI_RAM_SIZE);
+        guest_memory.discard(ITCM_OFFSET, CP15_ITCM_SIZE + CP15_DTCM_SIZE);
+    }
+
     arm9.reset();
     arm11.reset();
     arm9_cp15.reset(true);
@@ -43,9 +70,9 @@ void Emulator::reset(bool cold_boot)
     app_cp15.reset(false);
     mpcore_pmr.reset();
 
-    boot9 = boot9_free;
-    boot11 = boot11_free;
-    otp = otp_free;
+    //The ARM9 may also run code from AXI RAM, so the ARM11 only gets direct loads from it
+    arm9.set_fast_ram(0x08000000, ARM9_RAM_SIZE, arm9_RAM, true);
+    arm11.set_fast_ram(0x1FF80000, AXI_RAM_SIZE, axi_RAM, false);
 
     HID_PAD = 0xFFF;
 
@@ -58,6 +85,7 @@ void Emulator::reset(bool cold_boot)
 
     sysprot9 = 0;
     sysprot11 = 0;
+    map_memory();
 
     if (cold_boot)
         config_bootenv = 0;
@@ -66,679 +94,585 @@ void Emulator::reset(bool cold_boot)
 void Emulator::run()
 {
     i2c.update_time();
-    for (int i = 0; i < 200000; i++)
-    {
-        arm9.run();
-        arm11.run();
+    for (int i = 0; i < CYCLES_PER_FRAME; )
+    {
+        //With both cores halted or spinning, nothing happens until the next timer event.
+        //End the slice early when a timer is about to overflow, so its IRQ isn't delayed by a large quantum.
+        int slice = sync_quantum;
+        if (arm9.is_idle() && arm11.is_idle())
+            slice = CYCLES_PER_FRAME - i;
+        int timer_cycles = timers.cycles_until_overflow();
+        if (timer_cycles < slice)
+            slice = timer_cycles > 0 ? timer_cycles : 1;
+
+        if (arm11_thread)
+            run_cores_threaded(slice);
+        else
+        {
+            arm9.run(slice);
+            arm11.run(slice * ARM11_CLOCK_RATIO);
+        }
         dma9.run_xdma();
-        timers.run();
+        timers.run(slice);
+        i += slice;
     }
     gpu.render_frame();
 }
 
-void Emulator::print_state()
+//Both cores run the slice at the same time and meet again before the devices catch up
+void Emulator::run_cores_threaded(int slice)
 {
-    printf("--PRINTING STATE--\n");
-    printf("ARM9 state\n");
-    arm9.print_state();
-
-    printf("\nARM11 state\n");
-    arm11.print_state();
+    arm11_thread->start(slice * ARM11_CLOCK_RATIO);
+    std::exception_ptr error;
+    try
+    {
+        arm9.run(slice);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    arm11_thread->wait();
+    if (error)
+        std::rethrow_exception(error);
 
-    printf("\n--END LOG--\n");
+    //A core that didn't touch I/O during the slice still has to see code the other one wrote
+    apply_remote_code_writes(arm9);
+    apply_remote_code_writes(arm11);
 }
 
-void Emulator::load_roms(uint8_t *boot9, uint8_t *boot11, uint8_t *otp, uint8_t* cid)
+//Falls back to the interpreter on hosts without a recompiler
+void Emulator::set_jit_enabled(bool enabled)
 {
-    memset(boot9_locked, 0, 1024 * 64);
-    memset(boot11_locked, 0, 1024 * 64);
+    arm9.set_jit_enabled(enabled);
+    arm11.set_jit_enabled(enabled);
+}
 
-    memcpy(boot9_free, boot9, 1024 * 64);
-    memcpy(boot11_free, boot11, 1024 * 64);
+//Lets generated code access plain memory through a host mirror of each bus, with faults catching everything
+//else. Stays off where the host can't share memory or spare the address space, leaving the page tables to it.
+//Without it, guest memory goes back to a private mapping, whose huge pages don't hinge on the shmem setting.
+void Emulator::set_fastmem_enabled(bool enabled)
+{
+    if (enabled && guest_memory.set_shareable(true) && arm9_fastmem.reserve() && arm11_fastmem.reserve())
+    {
+        arm9.set_fastmem(&arm9_fastmem);
+        arm11.set_fastmem(&arm11_fastmem);
+    }
+    else
+    {
+        arm9.set_fastmem(nullptr);
+        arm11.set_fastmem(nullptr);
+        arm9_fastmem.release();
+        arm11_fastmem.release();
+        guest_memory.set_shareable(false);
+    }
+    map_memory();
+}
 
-    memcpy(boot9_locked, boot9, 1024 * 32);
-    memcpy(boot11_locked, boot11, 1024 * 32);
+//Runs the ARM11 on its own host thread, synchronizing with the ARM9 at the end of every slice
+//and whenever either of them accesses I/O
+void Emulator::set_threaded(bool enabled)
+{
+    if (enabled == (arm11_thread != nullptr))
+        return;
 
-    memcpy(otp_free, otp, 256);
-    memset(otp_locked, 0xFF, 256);
-    emmc.load_cid(cid);
+    if (enabled)
+        arm11_thread = new Core_Thread(&arm11);
+    else
+    {
+        delete arm11_thread;
+        arm11_thread = nullptr;
+        apply_remote_code_writes(arm9);
+        apply_remote_code_writes(arm11);
+    }
+    arm9.set_threaded(enabled);
+    arm11.set_threaded(enabled);
 }
 
-bool Emulator::mount_nand(std::string file_name)
+//Huge pages cut host TLB misses on scattered FCRAM accesses, but back memory 2 MB at a time once touched.
+//Instances packed tightly on a host may prefer to leave them off. Fastmem views pick it up at the next reset.
+void Emulator::set_huge_pages_enabled(bool enabled)
 {
-    return emmc.mount_nand(file_name);
+    guest_memory.set_huge_pages(enabled);
 }
 
-bool Emulator::mount_sd(std::string file_name)
+//Larger quanta mean fewer switches between the cores, smaller ones tighter synchronization
+void Emulator::set_sync_quantum(int cycles)
 {
-    return emmc.mount_sd(file_name);
+    if (cycles < 1)
+        cycles = 1;
+    sync_quantum = cycles;
 }
 
-uint8_t Emulator::arm9_read8(uint32_t addr)
+//Disassembly of the given core starts once it reaches addr
+void Emulator::add_trace_trigger(int core, uint32_t addr)
 {
-    if (addr >= 0xFFFF0000)
-        return boot9[addr & 0xFFFF];
-
-    if (addr >= 0x08000000 && addr < 0x08100000)
-        return arm9_RAM[addr & 0xFFFFF];
+    if (core == 9)
+        arm9.add_trace_trigger(addr);
+    else
+        arm11.add_trace_trigger(addr);
+}
 
-    if (addr >= 0x20000000 && addr < 0x28000000)
-        return fcram[addr & 0x07FFFFFF];
+Guest_RAM_Usage Emulator::get_ram_usage()
+{
+    Guest_RAM_Usage usage;
+    usage.fcram = guest_memory.get_resident_size(FCRAM_OFFSET, FCRAM_SIZE);
+    usage.vram = guest_memory.get_resident_size(VRAM_OFFSET, VRAM_SIZE);
+    usage.arm9_ram = guest_memory.get_resident_size(ARM9_RAM_OFFSET, ARM9_RAM_SIZE);
+    usage.axi_ram = guest_memory.get_resident_size(AXI_RAM_OFFSET, AXI_RAM_SIZE);
+    return usage;
+}
 
-    if (addr >= 0x18000000 && addr < 0x18600000)
-        return gpu.read_vram<uint8_t>(addr);
+//GUEST_MEMORY_SIZE bytes, laid out as in emulator.hpp
+uint8_t* Emulator::get_guest_memory()
+{
+    return guest_memory.get_ptr();
+}
 
-    if (addr >= 0x1000A040 && addr < 0x1000A080)
-        return sha.read_hash(addr);
+//Fills bitmap with one bit per page of guest memory, (GUEST_MEMORY_PAGES + 7) / 8 bytes, set for pages written
+//since the last call. Tracking then starts over, so only call it while the cores are stopped.
+void Emulator::take_dirty_pages(uint8_t* bitmap)
+{
+    guest_memory.take_dirty_pages(bitmap);
+    arm9.reset_clean_pages();
+    arm11.reset_clean_pages();
+}
 
-    if (addr >= 0x1000B000 && addr < 0x1000C000)
-        return rsa.read8(addr);
+//Taking the bus lock is also when a core catches up on code the other one overwrote
+Bus_Lock Emulator::lock_bus(ARM_CPU& core)
+{
+    if (!arm11_thread)
+        return Bus_Lock();
 
-    if (addr >= 0x10144000 && addr < 0x10145000)
-        return i2c.read8(addr);
+    Bus_Lock bus(bus_lock);
+    apply_remote_code_writes(core);
+    return bus;
+}
 
-    if (addr >= 0x10148000 && addr < 0x10149000)
-        return i2c.read8(addr);
+std::vector<uint32_t>& Emulator::get_remote_code_writes(ARM_CPU& core)
+{
+    return remote_code_writes[(&core == &arm9) ? 0 : 1];
+}
 
-    if (addr >= 0x10160000 && addr < 0x10161000)
+//Called with the bus lock held, or with both cores stopped
+void Emulator::apply_remote_code_writes(ARM_CPU& core)
+{
+    std::vector<uint32_t>& pages = get_remote_code_writes(core);
+    for (unsigned int i = 0; i < pages.size(); i++)
     {
-        printf("[SPI2] Unrecognized read8 $%08X\n", addr);
-        return 0;
+        if (pages[i] == ALL_CODE_PAGES)
+        {
+            core.flush_code_cache();
+            core.flush_tlb();
+        }
+        else
+            core.invalidate_code(pages[i] << 12);
     }
+    pages.clear();
+}
 
-    if (addr >= 0x10161000 && addr < 0x10162000)
-        return i2c.read8(addr);
+//Drops cached code from a core that may be running on the other thread. Its cache is only touched by its own
+//thread, so there the page is queued until the core next takes the bus lock or the slice ends.
+void Emulator::invalidate_remote_code(ARM_CPU& core, uint32_t page)
+{
+    if (!arm11_thread)
+    {
+        if (page == ALL_CODE_PAGES)
+        {
+            core.flush_code_cache();
+            core.flush_tlb();
+        }
+        else
+            core.invalidate_code(page << 12);
+        return;
+    }
 
-    if (addr >= 0x18000000 && addr < 0x18600000)
-        return gpu.read_vram<uint8_t>(addr);
+    Bus_Lock bus(bus_lock);
+    std::vector<uint32_t>& pages = get_remote_code_writes(core);
+    if (pages.empty() || pages.back() != page)
+        pages.push_back(page);
+}
 
-    if (addr >= 0x1FF80000 && addr < 0x20000000)
-        return axi_RAM[addr & 0x7FFFF];
+//Plain memory of both buses, with the ROMs sysprot has locked so far. Everything else is left to the device
+//handlers below. Only called while neither core runs.
+void Emulator::map_memory()
+{
+    uint8_t* vram = gpu.get_vram();
+    uint8_t* boot9 = (sysprot9 & 0x1) ? boot9_locked : boot9_free;
+    uint8_t* otp = (sysprot9 & 0x2) ? otp_locked : otp_free;
+    uint8_t* boot11 = (sysprot11 & 0x1) ? boot11_locked : boot11_free;
+
+    arm9_map.clear();
+    arm9_fastmem.clear();
+    map_pages(9, 0x08000000, ARM9_RAM_SIZE, arm9_RAM, ARM9_RAM_SIZE, true);
+    map_pages(9, 0x10012000, MEMMAP_PAGE_SIZE, otp, MEMMAP_PAGE_SIZE, false);
+    map_pages(9, 0x18000000, VRAM_SIZE, vram, VRAM_SIZE, true);
+    map_pages(9, 0x1FF80000, AXI_RAM_SIZE, axi_RAM, AXI_RAM_SIZE, true);
+    map_pages(9, 0x20000000, FCRAM_SIZE, fcram, FCRAM_SIZE, true);
+    map_pages(9, 0xFFFF0000, BOOT_ROM_SIZE, boot9, BOOT_ROM_SIZE, false);
+
+    //Boot ROM is mirrored once
+    arm11_map.clear();
+    arm11_fastmem.clear();
+    map_pages(11, 0x00000000, BOOT_ROM_SIZE * 2, boot11, BOOT_ROM_SIZE, false);
+    map_pages(11, 0x18000000, VRAM_SIZE, vram, VRAM_SIZE, true);
+    map_pages(11, 0x1FF80000, AXI_RAM_SIZE, axi_RAM, AXI_RAM_SIZE, true);
+
+    arm9.update_memory_map();
+}
 
-    switch (addr)
+//Plain memory shows up in the bus's page table and, with fastmem on, in its host mirror as well
+void Emulator::map_pages(int core, uint32_t start, uint32_t size, uint8_t* mem, uint32_t mem_size, bool writable)
+{
+    if (core == 9)
     {
-        case 0x10000000:
-            return sysprot9;
-        case 0x10000001:
-            return sysprot11;
-        case 0x10000002:
-            return 0; //Related to powering on ARM11?
-        case 0x10000008:
-            return 0; //AES related
-        case 0x10000010:
-            return 1; //Cartridge not inserted
-        case 0x10000200:
-            return 0; //New3DS memory hidden
-        case 0x10008000:
-            return pxi.read_sync9() & 0xFF;
-        case 0x10008003:
-            return pxi.read_sync9() >> 24;
-        case 0x10009011:
-            return aes.read_keycnt();
-        case 0x10010010:
-            return 0; //0=retail, 1=dev
-        case 0x10010014:
-            return 0;
-        case 0x10141200:
-            return 1;
+        arm9_map.map(start, size, mem, mem_size, writable);
+        arm9_fastmem.map(start, size, guest_memory, mem, mem_size, writable);
+        arm9.update_memory_map(start, size);
+    }
+    else
+    {
+        arm11_map.map(start, size, mem, mem_size, writable);
+        arm11_fastmem.map(start, size, guest_memory, mem, mem_size, writable);
     }
-
-    EmuException::die("[ARM9] Invalid read8 $%08X\n", addr);
-    return 0;
 }
 
-uint16_t Emulator::arm9_read16(uint32_t addr)
+//Registers of every device on both buses. Stubs covering whole ranges go first, so the devices and registers
+//inside them take precedence. Only called once, as the handlers stay bound to the same devices.
+void Emulator::map_mmio()
 {
-    if (addr >= 0xFFFF0000)
-        return *(uint16_t*)&boot9[addr & 0xFFFF];
+    arm9_mmio.on_read<uint8_t>(0x10160000, 0x1000, [](uint32_t addr)
+    {
+        printf("[SPI2] Unrecognized read8 $%08X\n", addr);
+        return 0;
+    });
+    arm9_mmio.on_read<uint16_t>(0x10160000, 0x1000, [](uint32_t addr)
+    {
+        printf("[SPI2] Unrecognized read16 $%08X\n", addr);
+        return 0;
+    });
+    arm9_mmio.on_write<uint8_t>(0x10160000, 0x10000, [](uint32_t addr, uint32_t value)
+    {
+        printf("[SPI2] Unrecognized write8 $%08X: $%02X\n", addr, value);
+    });
+    arm9_mmio.on_write<uint16_t>(0x10160000, 0x10000, [](uint32_t addr, uint32_t value)
+    {
+        printf("[SPI2] Unrecognized write16 $%08X: $%04X\n", addr, value);
+    });
 
-    if (addr >= 0x08000000 && addr < 0x08100000)
-        return *(uint16_t*)&arm9_RAM[addr & 0xFFFFF];
+    //DSP memory
+    arm9_mmio.on_write<uint32_t>(0x1FF00000, 0x80000, [](uint32_t, uint32_t) {});
 
-    if (addr >= 0x20000000 && addr < 0x28000000)
-        return *(uint16_t*)&fcram[addr & 0x07FFFFFF];
+    arm11_mmio.on_read<uint8_t>(0x10147000, 0x1000, [](uint32_t addr)
+    {
+        printf("[GPIO] Unrecognized read8 $%08X\n", addr);
+        return 0;
+    });
+    arm11_mmio.on_read<uint32_t>(0x10200000, 0x1000, [](uint32_t addr)
+    {
+        printf("[CDMA] Unrecognized read32 $%08X\n", addr);
+        return 0;
+    });
+    arm11_mmio.on_write<uint32_t>(0x10200000, 0x1000, [](uint32_t addr, uint32_t value)
+    {
+        printf("[CDMA] Unrecognized write32 $%08X: $%08X\n", addr, value);
+    });
+    arm11_mmio.on_read<uint32_t>(0x10202000, 0x1000, [](uint32_t addr)
+    {
+        printf("[LCD] Unrecognized read $%08X\n", addr);
+        return 0;
+    });
+    arm11_mmio.on_write<uint32_t>(0x10202000, 0x1000, [](uint32_t addr, uint32_t value)
+    {
+        printf("[LCD] Unrecognized write32 $%08X: $%08X\n", addr, value);
+    });
 
-    if (addr >= 0x10003000 && addr < 0x10004000)
-        return timers.arm9_read16(addr);
+    //Mapping data to DSP
+    arm11_mmio.on_write<uint8_t>(0x10140000, 0x10, [](uint32_t, uint32_t) {});
+
+    aes.register_mmio(arm9_mmio);
+    dma9.register_mmio(arm9_mmio);
+    emmc.register_mmio(arm9_mmio);
+    int9.register_mmio(arm9_mmio);
+    rsa.register_mmio(arm9_mmio);
+    sha.register_mmio(arm9_mmio);
+    timers.register_mmio(arm9_mmio);
+    gpu.register_mmio(arm11_mmio);
+    mpcore_pmr.register_mmio(arm11_mmio);
+    i2c.register_mmio(arm9_mmio, arm11_mmio);
+    pxi.register_mmio(arm9_mmio, arm11_mmio);
+
+    //CFG9
+    arm9_mmio.on_read<uint8_t>(0x10000000, 1, [this](uint32_t) { return sysprot9; });
+    arm9_mmio.on_read<uint8_t>(0x10000001, 1, [this](uint32_t) { return sysprot11; });
+    arm9_mmio.on_read<uint8_t>(0x10000002, 1, [](uint32_t) { return 0; }); //Related to powering on ARM11?
+    arm9_mmio.on_read<uint16_t>(0x10000004, 2, [](uint32_t) { return 0; }); //debug control?
+    arm9_mmio.on_read<uint8_t>(0x10000008, 1, [](uint32_t) { return 0; }); //AES related
+    arm9_mmio.on_read<uint8_t>(0x10000010, 1, [](uint32_t) { return 1; }); //Cartridge not inserted
+    arm9_mmio.on_read<uint8_t>(0x10000200, 1, [](uint32_t) { return 0; }); //New3DS memory hidden
+    arm9_mmio.on_write<uint8_t>(0x10000000, 1, [this](uint32_t, uint32_t value)
+    {
+        //Disable access to sensitive parts of boot ROM
+        if (value & 0x1)
+        {
+            map_pages(9, 0xFFFF0000, BOOT_ROM_SIZE, boot9_locked, BOOT_ROM_SIZE, false);
+            arm9.flush_code_cache();
+        }
 
-    if (addr >= 0x10006000 && addr < 0x10007000)
-        return emmc.read16(addr);
+        //Disable access to OTP
+        if (value & 0x2)
+            map_pages(9, 0x10012000, MEMMAP_PAGE_SIZE, otp_locked, MEMMAP_PAGE_SIZE, false);
 
-    if (addr >= 0x10160000 && addr < 0x10161000)
+        sysprot9 = value;
+    });
+    arm9_mmio.on_write<uint8_t>(0x10000001, 1, [this](uint32_t, uint32_t value)
     {
-        printf("[SPI2] Unrecognized read16 $%08X\n", addr);
-        return 0;
-    }
+        //The ARM11 may be reading through the old pages on its own thread, which is no different
+        //from its access landing just before the lock
+        if (value & 0x1)
+        {
+            map_pages(11, 0x00000000, BOOT_ROM_SIZE * 2, boot11_locked, BOOT_ROM_SIZE, false);
+            invalidate_remote_code(arm11, ALL_CODE_PAGES);
+            printf("Boot11 locked: $%08X\n", *(uint32_t*)&boot11_locked[0x8000]);
+        }
 
-    switch (addr)
+        sysprot11 = value;
+    });
+    arm9_mmio.on_write<uint8_t>(0x10000002, 1, [](uint32_t, uint32_t) {});
+    arm9_mmio.on_write<uint16_t>(0x10000004, 2, [](uint32_t, uint32_t) {});
+    arm9_mmio.on_write<uint8_t>(0x10000008, 1, [](uint32_t, uint32_t) {});
+    arm9_mmio.on_write<uint16_t>(0x10000020, 2, [](uint32_t, uint32_t) {});
+    arm9_mmio.on_write<uint32_t>(0x10000020, 4, [](uint32_t, uint32_t value)
     {
-        case 0x10000004:
-            return 0; //debug control?
-        case 0x10008004:
-            return pxi.read_cnt9();
-        case 0x10146000:
-            return HID_PAD; //bits on = keys not pressed
-    }
+        printf("[ARM9] Set SDMMCCTL: $%08X\n", value);
+    });
+
+    //Config
+    arm9_mmio.on_read<uint32_t>(0x10010000, 4, [this](uint32_t) { return config_bootenv; });
+    arm9_mmio.on_write<uint32_t>(0x10010000, 4, [this](uint32_t, uint32_t value) { config_bootenv = value; });
+    arm9_mmio.on_read<uint8_t>(0x10010010, 1, [](uint32_t) { return 0; }); //0=retail, 1=dev
+    arm9_mmio.on_read<uint8_t>(0x10010014, 1, [](uint32_t) { return 0; });
+    arm9_mmio.on_write<uint8_t>(0x10010014, 1, [](uint32_t, uint32_t) {});
 
-    EmuException::die("[ARM9] Invalid read16 $%08X\n", addr);
-    return 0;
+    arm9_mmio.on_write<uint32_t>(0x10012100, 8, [this](uint32_t addr, uint32_t value)
+    {
+        *(uint32_t*)&twl_consoleid[addr & 0x7] = value;
+    });
+
+    //CFG11, as far as the ARM9 sees it
+    arm9_mmio.on_read<uint32_t>(0x101401C0, 4, [](uint32_t) { return 0; }); //SPI control
+    arm9_mmio.on_read<uint32_t>(0x10140FFC, 4, [](uint32_t) { return 0x1; }); //bit 1 = New3DS (we're only emulating Old3DS for now)
+    arm9_mmio.on_read<uint8_t>(0x10141200, 1, [](uint32_t) { return 1; });
+
+    //HID, bits on = keys not pressed
+    arm9_mmio.on_read<uint16_t>(0x10146000, 2, [this](uint32_t) { return HID_PAD; });
+    arm9_mmio.on_read<uint32_t>(0x10146000, 4, [this](uint32_t) { return HID_PAD; });
+    arm11_mmio.on_read<uint16_t>(0x10146000, 2, [this](uint32_t) { return HID_PAD; });
+
+    //CFG11
+    arm11_mmio.on_read<uint16_t>(0x10140FFC, 2, [](uint32_t) { return 0x1; }); //Clock multiplier; bit 2 off = 2x
+    arm11_mmio.on_read<uint32_t>(0x10141200, 4, [](uint32_t) { return 0; }); //GPU power config
+    arm11_mmio.on_write<uint32_t>(0x10141200, 4, [](uint32_t, uint32_t) {});
+    arm11_mmio.on_read<uint8_t>(0x10141204, 1, [](uint32_t) { return 1; }); //GPU power
+    arm11_mmio.on_read<uint8_t>(0x10141208, 1, [](uint32_t) { return 0; }); //Unk GPU power reg
+    arm11_mmio.on_read<uint8_t>(0x10141220, 1, [](uint32_t) { return 0; }); //Enable FCRAM?
+    arm11_mmio.on_write<uint8_t>(0x10141204, 1, [](uint32_t, uint32_t) {});
+    arm11_mmio.on_write<uint8_t>(0x10141208, 1, [](uint32_t, uint32_t) {});
+    arm11_mmio.on_write<uint8_t>(0x10141220, 1, [](uint32_t, uint32_t) {});
 }
 
-uint32_t Emulator::arm9_read32(uint32_t addr)
+void Emulator::print_state()
 {
-    if (addr >= 0xFFFF0000)
-        return *(uint32_t*)&boot9[addr & 0xFFFF];
+    printf("--PRINTING STATE--\n");
+    printf("ARM9 state\n");
+    arm9.print_state();
 
-    if (addr >= 0x08000000 && addr < 0x08100000)
-        return *(uint32_t*)&arm9_RAM[addr & 0xFFFFF];
+    printf("\nARM11 state\n");
+    arm11.print_state();
+
+    printf("\n--END LOG--\n");
+}
+
+void Emulator::load_roms(uint8_t *boot9, uint8_t *boot11, uint8_t *otp, uint8_t* cid)
+{
+    memset(boot9_locked, 0, 1024 * 64);
+    memset(boot11_locked, 0, 1024 * 64);
 
-    if (addr >= 0x18000000 && addr < 0x18600000)
-        return gpu.read_vram<uint32_t>(addr);
+    memcpy(boot9_free, boot9, 1024 * 64);
+    memcpy(boot11_free, boot11, 1024 * 64);
 
-    if (addr >= 0x20000000 && addr < 0x28000000)
-        return *(uint32_t*)&fcram[addr & 0x07FFFFFF];
+    memcpy(boot9_locked, boot9, 1024 * 32);
+    memcpy(boot11_locked, boot11, 1024 * 32);
 
-    if (addr >= 0x10002000 && addr < 0x10003000)
-        return dma9.read32_ndma(addr);
+    memset(otp_free, 0, MEMMAP_PAGE_SIZE);
+    memset(otp_locked, 0, MEMMAP_PAGE_SIZE);
+    memcpy(otp_free, otp, 256);
+    memset(otp_locked, 0xFF, 256);
 
-    if (addr >= 0x10006000 && addr < 0x10007000)
-        return emmc.read32(addr);
+    //Counted as written, so save states taken from the dirty pages pick up the ROMs as well
+    guest_memory.mark_dirty(boot9_free, BOOT11_LOCKED_OFFSET + BOOT_ROM_SIZE - BOOT9_FREE_OFFSET);
+    guest_memory.mark_dirty(otp_free, MEMMAP_PAGE_SIZE * 2);
+    emmc.load_cid(cid);
+}
 
-    if (addr >= 0x10009000 && addr < 0x1000A000)
-        return aes.read32(addr);
+bool Emulator::mount_nand(std::string file_name)
+{
+    return emmc.mount_nand(file_name);
+}
 
-    if (addr >= 0x1000A000 && addr < 0x1000B000)
-        return sha.read32(addr);
+bool Emulator::mount_sd(std::string file_name)
+{
+    return emmc.mount_sd(file_name);
+}
 
-    if (addr >= 0x1000B000 && addr < 0x1000C000)
-        return rsa.read32(addr);
+uint8_t Emulator::arm9_read8(uint32_t addr)
+{
+    uint8_t* page = arm9_map.get_read_page(addr);
+    if (page)
+        return page[addr & MEMMAP_PAGE_MASK];
 
-    if (addr >= 0x1000C000 && addr < 0x1000D000)
-        return dma9.read32_xdma(addr);
+    Bus_Lock bus = lock_bus(arm9);
+    return arm9_mmio.read<uint8_t>(addr);
+}
 
-    if (addr >= 0x10012000 && addr < 0x10012100)
-        return *(uint32_t*)&otp[addr & 0xFF];
+uint16_t Emulator::arm9_read16(uint32_t addr)
+{
+    uint8_t* page = arm9_map.get_read_page(addr);
+    if (page)
+        return *(uint16_t*)&page[addr & MEMMAP_PAGE_MASK];
 
-    if (addr >= 0x1FF80000 && addr < 0x20000000)
-        return *(uint32_t*)&axi_RAM[addr & 0x7FFFF];
+    Bus_Lock bus = lock_bus(arm9);
+    return arm9_mmio.read<uint16_t>(addr);
+}
 
-    switch (addr)
-    {
-        case 0x10001000:
-            return int9.read_ie();
-        case 0x10001004:
-            return int9.read_if();
-        case 0x10008000:
-            return pxi.read_sync9();
-        case 0x1000800C:
-            return pxi.read_msg9();
-        case 0x10010000:
-            return config_bootenv;
-        case 0x101401C0:
-            return 0; //SPI control
-        case 0x10140FFC:
-            return 0x1; //bit 1 = New3DS (we're only emulating Old3DS for now)
-        case 0x10146000:
-            return HID_PAD;
-    }
+uint32_t Emulator::arm9_read32(uint32_t addr)
+{
+    uint8_t* page = arm9_map.get_read_page(addr);
+    if (page)
+        return *(uint32_t*)&page[addr & MEMMAP_PAGE_MASK];
 
-    EmuException::die("[ARM9] Invalid read32 $%08X\n", addr);
-    return 0;
+    Bus_Lock bus = lock_bus(arm9);
+    return arm9_mmio.read<uint32_t>(addr);
 }
 
 void Emulator::arm9_write8(uint32_t addr, uint8_t value)
 {
-    if (addr >= 0x08000000 && addr < 0x08100000)
-    {
-        arm9_RAM[addr & 0xFFFFF] = value;
-        return;
-    }
-    if (addr >= 0x1FF80000 && addr < 0x20000000)
-    {
-        axi_RAM[addr & 0x7FFFF] = value;
-        return;
-    }
-    if (addr >= 0x20000000 && addr < 0x28000000)
-    {
-        fcram[addr & 0x07FFFFFF] = value;
-        return;
-    }
-    if (addr >= 0x18000000 && addr < 0x18600000)
+    uint8_t* page = arm9_map.get_write_page(addr);
+    if (page)
     {
-        gpu.write_vram<uint8_t>(addr, value);
+        page[addr & MEMMAP_PAGE_MASK] = value;
+        guest_memory.mark_dirty(page);
+        invalidate_code(arm9, addr);
         return;
     }
-    if (addr >= 0x10144000 && addr < 0x10145000)
-    {
-        i2c.write8(addr, value);
-        return;
-    }
-    if (addr >= 0x10160000 && addr < 0x10170000)
-    {
-        printf("[SPI2] Unrecognized write8 $%08X: $%02X\n", addr, value);
-        return;
-    }
-    if (addr >= 0x1000B000 && addr < 0x1000C000)
-    {
-        rsa.write8(addr, value);
-        return;
-    }
-    if (addr >= 0x10008000 && addr < 0x10008004)
-    {
-        uint32_t sync = pxi.read_sync9();
-        int shift = (addr & 0x3) * 8;
-        int mask = ~(0xFF << shift);
-        sync &= mask;
-        pxi.write_sync9(sync | (value << shift));
-        return;
-    }
-    switch (addr)
-    {
-        case 0x10000000:
-            //Disable access to sensitive parts of boot ROM
-            if (value & 0x1)
-                boot9 = boot9_locked;
-
-            //Disable access to OTP
-            if (value & 0x2)
-                otp = otp_locked;
-
-            sysprot9 = value;
-            return;
-        case 0x10000001:
-            if (value & 0x1)
-            {
-                boot11 = boot11_locked;
-                printf("Boot11 locked: $%08X\n", *(uint32_t*)&boot11[0x8000]);
-            }
-
-            sysprot11 = value;
-            return;
-        case 0x10000002:
-            return;
-        case 0x10000008:
-            return;
-        case 0x10009010:
-            aes.write_keysel(value);
-            return;
-        case 0x10009011:
-            aes.write_keycnt(value);
-            return;
-        case 0x10010014:
-            return;
-    }
-    EmuException::die("[ARM9] Invalid write8 $%08X: $%02X\n", addr, value);
+
+    Bus_Lock bus = lock_bus(arm9);
+    arm9_mmio.write<uint8_t>(addr, value);
 }
 
 void Emulator::arm9_write16(uint32_t addr, uint16_t value)
 {
-    if (addr >= 0x08000000 && addr < 0x08100000)
+    uint8_t* page = arm9_map.get_write_page(addr);
+    if (page)
     {
-        *(uint16_t*)&arm9_RAM[addr & 0xFFFFF] = value;
+        *(uint16_t*)&page[addr & MEMMAP_PAGE_MASK] = value;
+        guest_memory.mark_dirty(page);
+        invalidate_code(arm9, addr);
         return;
     }
-    if (addr >= 0x1FF80000 && addr < 0x20000000)
-    {
-        *(uint16_t*)&axi_RAM[addr & 0x7FFFF] = value;
-        return;
-    }
-    if (addr >= 0x20000000 && addr < 0x28000000)
-    {
-        *(uint16_t*)&fcram[addr & 0x07FFFFFF] = value;
-        return;
-    }
-    if (addr >= 0x10003000 && addr < 0x10004000)
-    {
-        timers.arm9_write16(addr, value);
-        return;
-    }
-    if (addr >= 0x10006000 && addr < 0x10007000)
-    {
-        emmc.write16(addr, value);
-        return;
-    }
-    if (addr >= 0x10144000 && addr < 0x10145000)
-    {
-        printf("[A9 I2C] Unrecognized write16 $%08X: $%04X\n", addr, value);
-        return;
-    }
-    if (addr >= 0x10148000 && addr < 0x10149000)
-    {
-        printf("[A9 I2C] Unrecognized write16 $%08X: $%04X\n", addr, value);
-        return;
-    }
-    if (addr >= 0x10160000 && addr < 0x10170000)
-    {
-        printf("[SPI2] Unrecognized write16 $%08X: $%04X\n", addr, value);
-        return;
-    }
-    switch (addr)
-    {
-        case 0x10000004:
-            return;
-        case 0x10000020:
-            return;
-        case 0x10008004:
-            pxi.write_cnt9(value);
-            return;
-        case 0x10009006:
-            aes.write_block_count(value);
-            return;
-    }
-    EmuException::die("[ARM9] Invalid write16 $%08X: $%04X\n", addr, value);
+
+    Bus_Lock bus = lock_bus(arm9);
+    arm9_mmio.write<uint16_t>(addr, value);
 }
 
 void Emulator::arm9_write32(uint32_t addr, uint32_t value)
 {
-    if (addr >= 0x08000000 && addr < 0x08100000)
-    {
-        *(uint32_t*)&arm9_RAM[addr & 0xFFFFF] = value;
-        return;
-    }
-    if (addr >= 0x1FF80000 && addr < 0x20000000)
-    {
-        *(uint32_t*)&axi_RAM[addr & 0x7FFFF] = value;
-        return;
-    }
-    if (addr >= 0x18000000 && addr < 0x18600000)
-    {
-        gpu.write_vram<uint32_t>(addr, value);
-        return;
-    }
-    if (addr >= 0x20000000 && addr < 0x28000000)
-    {
-        *(uint32_t*)&fcram[addr & 0x07FFFFFF] = value;
-        return;
-    }
-    if (addr >= 0x10002000 && addr < 0x10003000)
-    {
-        dma9.write32_ndma(addr, value);
-        return;
-    }
-    if (addr >= 0x10006000 && addr < 0x10007000)
+    uint8_t* page = arm9_map.get_write_page(addr);
+    if (page)
     {
-        emmc.write32(addr, value);
+        *(uint32_t*)&page[addr & MEMMAP_PAGE_MASK] = value;
+        guest_memory.mark_dirty(page);
+        invalidate_code(arm9, addr);
         return;
     }
-    if (addr >= 0x10009000 && addr < 0x1000A000)
-    {
-        aes.write32(addr, value);
-        return;
-    }
-    if (addr >= 0x1000A000 && addr < 0x1000B000)
-    {
-        sha.write32(addr, value);
-        return;
-    }
-    if (addr >= 0x1000B000 && addr < 0x1000C000)
-    {
-        rsa.write32(addr, value);
-        return;
-    }
-    if (addr >= 0x1000C000 && addr < 0x1000D000)
-    {
-        dma9.write32_xdma(addr, value);
-        return;
-    }
-
-    if (addr >= 0x10012100 && addr < 0x10012108)
-    {
-        *(uint32_t*)&twl_consoleid[addr & 0x7] = value;
-        return;
-    }
-
-    //DSP memory
-    if (addr >= 0x1FF00000 && addr < 0x1FF80000)
-        return;
 
-    //B9S writes here to cause a data abort during boot9 exec, which allows it to dump the boot ROMs.
-    //Data aborts not implemented yet, so just ignore
-    if (addr >= 0xC0000000 && addr < 0xC0000200)
-    {
-        return;
-    }
-    switch (addr)
-    {
-        case 0x10000020:
-            printf("[ARM9] Set SDMMCCTL: $%08X\n", value);
-            return;
-        case 0x10001000:
-            printf("[ARM9] Set IE: $%08X\n", value);
-            int9.write_ie(value);
-            return;
-        case 0x10001004:
-            int9.write_if(value);
-            return;
-        case 0x10008000:
-            pxi.write_sync9(value);
-            return;
-        case 0x10008008:
-            pxi.send_to_11(value);
-            return;
-        case 0x10010000:
-            config_bootenv = value;
-            return;
-    }
-    EmuException::die("[ARM9] Invalid write32 $%08X: $%08X\n", addr, value);
+    Bus_Lock bus = lock_bus(arm9);
+    arm9_mmio.write<uint32_t>(addr, value);
 }
 
 uint8_t Emulator::arm11_read8(uint32_t addr)
 {
-    if (addr < 0x20000)
-        return boot11[addr & 0xFFFF];
-    if (addr >= 0x1FF80000 && addr < 0x20000000)
-        return axi_RAM[addr & 0x7FFFF];
-    if (addr >= 0x10144000 && addr < 0x10145000)
-        return i2c.read8(addr);
-    if (addr >= 0x10147000 && addr < 0x10148000)
-    {
-        printf("[GPIO] Unrecognized read8 $%08X\n", addr);
-        return 0;
-    }
-    if (addr >= 0x10161000 && addr < 0x10162000)
-        return i2c.read8(addr);
-    if (addr >= 0x17E00000 && addr < 0x17E02000)
-        return mpcore_pmr.read8(addr);
-    switch (addr)
-    {
-        case 0x10141204:
-            return 1; //GPU power
-        case 0x10141208:
-            return 0; //Unk GPU power reg
-        case 0x10141220:
-            return 0; //Enable FCRAM?
-        case 0x10163000:
-            return pxi.read_sync11() & 0xFF;
-    }
-    EmuException::die("[ARM9] Invalid read8 $%08X\n");
-    return 0;
+    uint8_t* page = arm11_map.get_read_page(addr);
+    if (page)
+        return page[addr & MEMMAP_PAGE_MASK];
+
+    Bus_Lock bus = lock_bus(arm11);
+    return arm11_mmio.read<uint8_t>(addr);
 }
 
 uint16_t Emulator::arm11_read16(uint32_t addr)
 {
-    if (addr < 0x20000)
-        return *(uint16_t*)&boot11[addr & 0xFFFF];
-    if (addr >= 0x1FF80000 && addr < 0x20000000)
-        return *(uint16_t*)&axi_RAM[addr & 0x7FFFF];
-    if (addr >= 0x10161000 && addr < 0x10162000)
-    {
-        printf("[I2C] Unrecognized read8 $%08X\n", addr);
-        return 0;
-    }
-    switch (addr)
-    {
-        case 0x10140FFC:
-            return 0x1; //Clock multiplier; bit 2 off = 2x
-        case 0x10146000:
-            return HID_PAD;
-        case 0x10163004:
-            return pxi.read_cnt11();
-    }
-    EmuException::die("[ARM9] Invalid read16 $%08X\n");
-    return 0;
+    uint8_t* page = arm11_map.get_read_page(addr);
+    if (page)
+        return *(uint16_t*)&page[addr & MEMMAP_PAGE_MASK];
+
+    Bus_Lock bus = lock_bus(arm11);
+    return arm11_mmio.read<uint16_t>(addr);
 }
 
 uint32_t Emulator::arm11_read32(uint32_t addr)
 {
-    if (addr < 0x20000)
-        return *(uint32_t*)&boot11[addr & 0xFFFF];
-    if (addr >= 0x17E00000 && addr < 0x17E02000)
-        return mpcore_pmr.read32(addr);
-    if (addr >= 0x1FF80000 && addr < 0x20000000)
-        return *(uint32_t*)&axi_RAM[addr & 0x7FFFF];
-    if (addr >= 0x10200000 && addr < 0x10201000)
-    {
-        printf("[CDMA] Unrecognized read32 $%08X\n", addr);
-        return 0;
-    }
-    if (addr >= 0x10400000 && addr < 0x10402000)
-        return gpu.read32(addr);
-    if (addr >= 0x18000000 && addr < 0x18600000)
-        return gpu.read_vram<uint32_t>(addr);
-    if (addr >= 0x10202000 && addr < 0x10203000)
-    {
-        printf("[LCD] Unrecognized read $%08X\n", addr);
-        return 0;
-    }
-    switch (addr)
-    {
-        case 0x10141200:
-            return 0; //GPU power config
-        case 0x10163000:
-            return pxi.read_sync11();
-        case 0x1016300C:
-            return pxi.read_msg11();
-    }
-    EmuException::die("[ARM9] Invalid read32 $%08X\n");
-    return 0;
+    uint8_t* page = arm11_map.get_read_page(addr);
+    if (page)
+        return *(uint32_t*)&page[addr & MEMMAP_PAGE_MASK];
+
+    Bus_Lock bus = lock_bus(arm11);
+    return arm11_mmio.read<uint32_t>(addr);
 }
 
 void Emulator::arm11_write8(uint32_t addr, uint8_t value)
 {
-    if (addr >= 0x1FF80000 && addr < 0x20000000)
-    {
-        axi_RAM[addr & 0x7FFFF] = value;
-        return;
-    }
-    if (addr >= 0x17E00000 && addr < 0x17E02000)
-    {
-        mpcore_pmr.write8(addr, value);
-        return;
-    }
-
-    //Mapping data to DSP
-    if (addr >= 0x10140000 && addr < 0x10140010)
-        return;
-
-    if (addr >= 0x10144000 && addr < 0x10145000)
-    {
-        i2c.write8(addr, value);
-        return;
-    }
-    if (addr >= 0x10161000 && addr < 0x10162000)
+    uint8_t* page = arm11_map.get_write_page(addr);
+    if (page)
     {
-        i2c.write8(addr, value);
+        page[addr & MEMMAP_PAGE_MASK] = value;
+        guest_memory.mark_dirty(page);
+        invalidate_code(arm11, addr);
         return;
     }
 
-    switch (addr)
-    {
-        case 0x10141204:
-            return;
-        case 0x10141208:
-            return;
-        case 0x10141220:
-            return;
-        case 0x10163001:
-        {
-            uint32_t sync = pxi.read_sync11() & 0xFFFF00FF;
-            pxi.write_sync11(sync | (value << 8));
-        }
-            return;
-        case 0x10163003:
-        {
-            uint32_t sync = pxi.read_sync11() & 0x00FFFFFF;
-            pxi.write_sync11(sync | (value << 24));
-        }
-            return;
-    }
-    EmuException::die("[ARM11] Invalid write8 $%08X: $%02X\n", addr, value);
+    Bus_Lock bus = lock_bus(arm11);
+    arm11_mmio.write<uint8_t>(addr, value);
 }
 
 void Emulator::arm11_write16(uint32_t addr, uint16_t value)
 {
-    if (addr >= 0x1FF80000 && addr < 0x20000000)
-    {
-        *(uint16_t*)&axi_RAM[addr & 0x7FFFF] = value;
-        return;
-    }
-    if (addr >= 0x17E00000 && addr < 0x17E02000)
-    {
-        mpcore_pmr.write16(addr, value);
-        return;
-    }
-    if (addr >= 0x10144000 && addr < 0x10145000)
-    {
-        printf("[I2C] Unrecognized write16 $%08X: $%04X\n", addr, value);
-        return;
-    }
-    if (addr >= 0x10161000 && addr < 0x10162000)
+    uint8_t* page = arm11_map.get_write_page(addr);
+    if (page)
     {
-        printf("[I2C] Unrecognized write16 $%08X: $%04X\n", addr, value);
+        *(uint16_t*)&page[addr & MEMMAP_PAGE_MASK] = value;
+        guest_memory.mark_dirty(page);
+        invalidate_code(arm11, addr);
         return;
     }
-    switch (addr)
-    {
-        case 0x10163004:
-            pxi.write_cnt11(value);
-            return;
-    }
-    EmuException::die("[ARM11] Invalid write16 $%08X: $%04X\n", addr, value);
+
+    Bus_Lock bus = lock_bus(arm11);
+    arm11_mmio.write<uint16_t>(addr, value);
 }
 
 void Emulator::arm11_write32(uint32_t addr, uint32_t value)
 {
-    if (addr >= 0x1FF80000 && addr < 0x20000000)
+    uint8_t* page = arm11_map.get_write_page(addr);
+    if (page)
     {
-        *(uint32_t*)&axi_RAM[addr & 0x7FFFF] = value;
+        *(uint32_t*)&page[addr & MEMMAP_PAGE_MASK] = value;
+        guest_memory.mark_dirty(page);
+        invalidate_code(arm11, addr);
         return;
     }
-    if (addr >= 0x17E00000 && addr < 0x17E02000)
-    {
-        mpcore_pmr.write32(addr, value);
-        return;
-    }
-    if (addr >= 0x10200000 && addr < 0x10201000)
-    {
-        printf("[CDMA] Unrecognized write32 $%08X: $%08X\n", addr, value);
-        return;
-    }
-    if (addr >= 0x10202000 && addr < 0x10203000)
-    {
-        printf("[LCD] Unrecognized write32 $%08X: $%08X\n", addr, value);
-        return;
-    }
-    if (addr >= 0x10400000 && addr < 0x10402000)
-    {
-        gpu.write32(addr, value);
-        return;
-    }
-    if (addr >= 0x18000000 && addr < 0x18600000)
-    {
-        gpu.write_vram<uint32_t>(addr, value);
-        return;
-    }
-    switch (addr)
-    {
-        case 0x10141200:
-            return;
-        case 0x10163000:
-            pxi.write_sync11(value);
-            return;
-        case 0x10202014:
-            return;
-    }
-    EmuException::die("[ARM11] Invalid write32 $%08X: $%08X\n", addr, value);
+
+    Bus_Lock bus = lock_bus(arm11);
+    arm11_mmio.write<uint32_t>(addr, value);
 }
 
 uint8_t* Emulator::get_top_buffer()
@@ -1,6 +1,8 @@
 #ifndef EMULATOR_HPP
 #define EMULATOR_HPP
 #include <cstdint>
+#include <mutex>
+#include <vector>
 #include "arm9/aes.hpp"
 #include "arm9/dma9.hpp"
 #include "arm9/emmc.hpp"
@@ -14,20 +16,72 @@
 #include "cpu/arm.hpp"
 #include "cpu/cp15.hpp"
 
+#include "fastmem.hpp"
 #include "i2c.hpp"
+#include "memmap.hpp"
+#include "mmio.hpp"
 #include "pxi.hpp"
 #include "timers.hpp"
 
+//The ARM11 runs at twice the ARM9's clock
+#define ARM11_CLOCK_RATIO 2
+
+//The ARM11 runs at 268,111,856 Hz and the screens refresh at about 59.83 Hz. The scheduler counts in ARM9
+//cycles, derived from this so the two can't drift apart.
+#define ARM11_CYCLES_PER_FRAME 4481136
+#define CYCLES_PER_FRAME (ARM11_CYCLES_PER_FRAME / ARM11_CLOCK_RATIO)
+
+//Default sync quantum in ARM9 cycles. The CPUs only return to the scheduler at block boundaries,
+//so a slice can overrun by one block.
+#define CYCLES_PER_SLICE 64
+
+//Where each region lives in guest memory
+#define FCRAM_OFFSET 0
+#define FCRAM_SIZE (1024 * 1024 * 128)
+#define VRAM_OFFSET (FCRAM_OFFSET + FCRAM_SIZE)
+#define VRAM_SIZE (1024 * 1024 * 6)
+#define ARM9_RAM_OFFSET (VRAM_OFFSET + VRAM_SIZE)
+#define ARM9_RAM_SIZE (1024 * 1024)
+#define AXI_RAM_OFFSET (ARM9_RAM_OFFSET + ARM9_RAM_SIZE)
+#define AXI_RAM_SIZE (1024 * 512)
+#define ITCM_OFFSET (AXI_RAM_OFFSET + AXI_RAM_SIZE)
+#define DTCM_OFFSET (ITCM_OFFSET + CP15_ITCM_SIZE)
+#define BOOT_ROM_SIZE (1024 * 64)
+#define BOOT9_FREE_OFFSET (DTCM_OFFSET + CP15_DTCM_SIZE)
+#define BOOT9_LOCKED_OFFSET (BOOT9_FREE_OFFSET + BOOT_ROM_SIZE)
+#define BOOT11_FREE_OFFSET (BOOT9_LOCKED_OFFSET + BOOT_ROM_SIZE)
+#define BOOT11_LOCKED_OFFSET (BOOT11_FREE_OFFSET + BOOT_ROM_SIZE)
+#define OTP_FREE_OFFSET (BOOT11_LOCKED_OFFSET + BOOT_ROM_SIZE)
+#define OTP_LOCKED_OFFSET (OTP_FREE_OFFSET + MEMMAP_PAGE_SIZE)
+#define GUEST_MEMORY_SIZE (OTP_LOCKED_OFFSET + MEMMAP_PAGE_SIZE)
+#define GUEST_MEMORY_PAGES (GUEST_MEMORY_SIZE >> MEMMAP_PAGE_SHIFT)
+
+//Queued in place of a page number to drop all of a core's cached code, and its TLB with it, as a remapped
+//bus leaves stale host pointers in both
+#define ALL_CODE_PAGES 0xFFFFFFFF
+
+//Bytes of each RAM region the host has actually backed. Pages the guest never touched don't count.
+struct Guest_RAM_Usage
+{
+    size_t fcram, vram;
+    size_t arm9_ram, axi_ram;
+};
+
+class Core_Thread;
+
+//Held while a core touches anything other than plain RAM. Empty unless the cores run on separate threads.
+typedef std::unique_lock<std::recursive_mutex> Bus_Lock;
+
 class Emulator
 {
     private:
-        //ROMs
-        uint8_t* boot9;
-        uint8_t* boot11;
-        uint8_t* otp;
-        uint8_t otp_free[256], otp_locked[256];
-        uint8_t boot9_free[1024 * 64], boot11_free[1024 * 64];
-        uint8_t boot9_locked[1024 * 64], boot11_locked[1024 * 64];
+        //Every RAM and ROM region, laid out as above, so save states can take it as one range
+        Shared_Memory guest_memory;
+
+        //ROMs. OTP only takes 256 bytes, but gets a whole page so locking it can remap the page.
+        uint8_t* otp_free, *otp_locked;
+        uint8_t* boot9_free, *boot11_free;
+        uint8_t* boot9_locked, *boot11_locked;
 
         uint8_t twl_consoleid[8];
 
@@ -35,6 +89,12 @@ class Emulator
         uint8_t* axi_RAM;
         uint8_t* fcram;
 
+        Memory_Map arm9_map, arm11_map;
+        Fastmem arm9_fastmem, arm11_fastmem;
+
+        //Everything else on each bus
+        MMIO_Bus arm9_mmio, arm11_mmio;
+
         ARM_CPU arm9, arm11;
         CP15 arm9_cp15, app_cp15, sys_cp15;
         AES aes;
@@ -51,9 +111,32 @@ class Emulator
 
         uint32_t config_bootenv;
 
+        //ARM9 cycles each core runs before the other one and the devices get to catch up
+        int sync_quantum;
+
         uint16_t HID_PAD;
 
         uint8_t sysprot9, sysprot11;
+
+        //Null unless the ARM11 runs on its own host thread, while the ARM9 and the devices stay on the caller's
+        Core_Thread* arm11_thread;
+
+        //Serializes I/O between the two threads. Recursive, as devices can access memory on a core's behalf.
+        std::recursive_mutex bus_lock;
+
+        //Code pages written by the other core, for the ARM9 and ARM11 respectively to drop when they next
+        //take the bus lock. Only used while threaded, as each core's cache is only touched by its own thread.
+        std::vector<uint32_t> remote_code_writes[2];
+
+        void map_memory();
+        void map_mmio();
+        void map_pages(int core, uint32_t start, uint32_t size, uint8_t* mem, uint32_t mem_size, bool writable);
+
+        void run_cores_threaded(int slice);
+        Bus_Lock lock_bus(ARM_CPU& core);
+        std::vector<uint32_t>& get_remote_code_writes(ARM_CPU& core);
+        void apply_remote_code_writes(ARM_CPU& core);
+        void invalidate_remote_code(ARM_CPU& core, uint32_t page);
     public:
         Emulator();
         ~Emulator();
@@ -61,6 +144,15 @@ class Emulator
         void reset(bool cold_boot = true);
         void run();
         void print_state();
+        void set_jit_enabled(bool enabled);
+        void set_fastmem_enabled(bool enabled);
+        void set_huge_pages_enabled(bool enabled);
+        void set_threaded(bool enabled);
+        void set_sync_quantum(int cycles);
+        void add_trace_trigger(int core, uint32_t addr);
+        Guest_RAM_Usage get_ram_usage();
+        uint8_t* get_guest_memory();
+        void take_dirty_pages(uint8_t* bitmap);
 
         void load_roms(uint8_t* boot9, uint8_t* boot11, uint8_t* otp, uint8_t* cid);
         bool mount_nand(std::string file_name);
@@ -80,9 +172,27 @@ class Emulator
         void arm11_write16(uint32_t addr, uint16_t value);
         void arm11_write32(uint32_t addr, uint32_t value);
 
+        void invalidate_code(ARM_CPU& writer, uint32_t addr);
+        void mark_dirty(uint8_t* ptr);
+
         uint8_t* get_top_buffer();
         uint8_t* get_bottom_buffer();
         void set_pad(uint16_t pad);
 };
 
+//Both cores can fetch from shared RAM, so a write must drop stale predecoded code on each of them
+inline void Emulator::invalidate_code(ARM_CPU& writer, uint32_t addr)
+{
+    ARM_CPU& other = (&writer == &arm9) ? arm11 : arm9;
+    writer.invalidate_code(addr);
+    if (other.has_code(addr))
+        invalidate_remote_code(other, addr >> 12);
+}
+
+//For anything writing guest memory through a host pointer
+inline void Emulator::mark_dirty(uint8_t* ptr)
+{
+    guest_memory.mark_dirty(ptr);
+}
+
 #endif // EMULATOR_HPP
@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "common/common.hpp"
+#include "fastmem.hpp"
+#include "memmap.hpp"
+
+#ifdef LAZY_MEMORY_SUPPORTED
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define FASTMEM_SIZE (1ULL << 32)
+
+#ifdef LAZY_MEMORY_SUPPORTED
+//Address space for size bytes starting on a huge page, or null. The slack used to align it is given back.
+static uint8_t* reserve_aligned(size_t size)
+{
+    size_t padded = size + HUGE_PAGE_SIZE;
+    void* area = mmap(nullptr, padded, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (area == MAP_FAILED)
+        return nullptr;
+
+    uintptr_t start = ((uintptr_t)area + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1);
+    uintptr_t end = start + size;
+    if (start > (uintptr_t)area)
+        munmap(area, start - (uintptr_t)area);
+    if ((uintptr_t)area + padded > end)
+        munmap((void*)end, (uintptr_t)area + padded - end);
+    return (uint8_t*)start;
+}
+
+//The bracketed choice in one of the host's transparent huge page settings, or empty if it doesn't have it
+static std::string read_thp_setting(const std::string& name)
+{
+    FILE* file = fopen(("/sys/kernel/mm/transparent_hugepage/" + name).c_str(), "r");
+    if (!file)
+        return "";
+    char buffer[128];
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+    fclose(file);
+    buffer[length] = 0;
+
+    char* start = strchr(buffer, '[');
+    char* end = start ? strchr(start, ']') : nullptr;
+    if (!end)
+        return "";
+    return std::string(start + 1, end);
+}
+
+//Whether memory advised with MADV_HUGEPAGE actually gets huge pages. Shared memory, memfds included, has its own
+//setting, and newer kernels set each page size apart, deferring to the global setting with "inherit".
+static bool host_allows_huge_pages(bool shmem)
+{
+    std::string name = shmem ? "shmem_enabled" : "enabled";
+    std::string setting = read_thp_setting("hugepages-2048kB/" + name);
+    if (setting.empty() || setting == "inherit")
+        setting = read_thp_setting(name);
+    if (shmem)
+        return setting == "always" || setting == "within_size" || setting == "advise" || setting == "force";
+    return setting == "always" || setting == "madvise";
+}
+#endif
+
+//A memfd grows its pages on first touch, as does the anonymous fallback, so most of FCRAM never costs anything
+Shared_Memory::Shared_Memory(size_t size) : size(size)
+{
+    page_count = (size + MEMMAP_PAGE_SIZE - 1) >> MEMMAP_PAGE_SHIFT;
+    dirty_pages = new uint8_t[page_count]();
+    mem = nullptr;
+    fd = -1;
+    mapped = false;
+    huge_pages = false;
+    huge_pages_backed = false;
+#ifdef LAZY_MEMORY_SUPPORTED
+    uint8_t* area = reserve_aligned(size);
+    if (!area)
+    {
+        mem = new uint8_t[size]();
+        return;
+    }
+#endif
+#ifdef FASTMEM_SUPPORTED
+    fd = memfd_create("guest_memory", 0);
+    if (fd >= 0 && ftruncate(fd, size) == 0)
+    {
+        void* view = mmap(area, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        if (view != MAP_FAILED)
+        {
+            mem = (uint8_t*)view;
+            return;
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+#endif
+#ifdef LAZY_MEMORY_SUPPORTED
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED;
+    void* view = mmap(area, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (view != MAP_FAILED)
+    {
+        mem = (uint8_t*)view;
+        mapped = true;
+        return;
+    }
+    munmap(area, size);
+#endif
+    mem = new uint8_t[size]();
+}
+
+Shared_Memory::~Shared_Memory()
+{
+    delete[] dirty_pages;
+#ifdef LAZY_MEMORY_SUPPORTED
+    if (fd >= 0 || mapped)
+    {
+        munmap(mem, size);
+        if (fd >= 0)
+            close(fd);
+        return;
+    }
+#endif
+    delete[] mem;
+}
+
+//Moves the memory between a memfd, which fastmem views can map, and a private anonymous mapping, which doesn't
+//depend on the host's shmem setting for huge pages. Its address and contents stay the same, so nothing pointing
+//into it needs updating, but no fastmem views may be mapped while it changes. Returns whether it ended up shareable.
+bool Shared_Memory::set_shareable(bool shareable)
+{
+    if (shareable == (fd >= 0) || (fd < 0 && !mapped))
+        return fd >= 0;
+#ifdef FASTMEM_SUPPORTED
+    //Built elsewhere and moved over the old mapping once filled, so a failure leaves the old one untouched
+    int new_fd = -1;
+    void* area;
+    if (shareable)
+    {
+        new_fd = memfd_create("guest_memory", 0);
+        if (new_fd < 0)
+            return false;
+        area = MAP_FAILED;
+        if (ftruncate(new_fd, size) == 0)
+            area = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, new_fd, 0);
+    }
+    else
+        area = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (area != MAP_FAILED)
+    {
+        copy_resident((uint8_t*)area);
+        if (mremap(area, size, size, MREMAP_MAYMOVE | MREMAP_FIXED, mem) != MAP_FAILED)
+        {
+            if (fd >= 0)
+                close(fd);
+            fd = new_fd;
+            mapped = !shareable;
+            apply_huge_pages();
+            return shareable;
+        }
+        munmap(area, size);
+    }
+    if (new_fd >= 0)
+        close(new_fd);
+#endif
+    return fd >= 0;
+}
+
+//Copies every host page of the memory that's backed into dest, leaving the rest of dest untouched
+void Shared_Memory::copy_resident(uint8_t* dest)
+{
+#ifdef LAZY_MEMORY_SUPPORTED
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t count = (size + page_size - 1) / page_size;
+    std::vector<unsigned char> pages(count);
+    if (mincore(mem, size, pages.data()) == 0)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!(pages[i] & 0x1))
+                continue;
+            size_t offset = i * page_size;
+            memcpy(dest + offset, mem + offset, std::min(page_size, size - offset));
+        }
+        return;
+    }
+#endif
+    memcpy(dest, mem, size);
+}
+
+//Only advice, which the host may ignore. uses_huge_pages reports what it does with it.
+void Shared_Memory::set_huge_pages(bool enabled)
+{
+    huge_pages = enabled;
+    apply_huge_pages();
+}
+
+void Shared_Memory::apply_huge_pages()
+{
+    huge_pages_backed = false;
+#ifdef LAZY_MEMORY_SUPPORTED
+    if (fd >= 0 || mapped)
+    {
+        madvise(mem, size, huge_pages ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+        huge_pages_backed = huge_pages && host_allows_huge_pages(fd >= 0);
+    }
+#endif
+}
+
+//Zeroes [offset, offset + size), handing its pages back to the host where possible. Fastmem views of a memfd
+//see the hole as well, so nothing needs remapping.
+void Shared_Memory::discard(size_t offset, size_t size)
+{
+    mark_dirty(mem + offset, size);
+#ifdef LAZY_MEMORY_SUPPORTED
+    if (fd >= 0 && fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offset, size) == 0)
+        return;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    if (mapped && !((offset | size) % page_size) && madvise(mem + offset, size, MADV_DONTNEED) == 0)
+        return;
+#endif
+    memset(mem + offset, 0, size);
+}
+
+void Shared_Memory::mark_dirty(uint8_t* ptr, size_t size)
+{
+    if (!size)
+        return;
+    size_t first = (ptr - mem) >> MEMMAP_PAGE_SHIFT;
+    size_t last = (ptr + size - 1 - mem) >> MEMMAP_PAGE_SHIFT;
+    memset(dirty_pages + first, 1, last - first + 1);
+}
+
+//Packs which pages were written since the last call into bitmap, one bit per page, and starts over
+void Shared_Memory::take_dirty_pages(uint8_t* bitmap)
+{
+    memset(bitmap, 0, (page_count + 7) / 8);
+    for (size_t i = 0; i < page_count; i++)
+        bitmap[i >> 3] |= dirty_pages[i] << (i & 0x7);
+    memset(dirty_pages, 0, page_count);
+}
+
+//Bytes of [offset, offset + size) the host has actually backed. Counted in host pages, so on hosts with pages
+//larger than 4 KB, neighbouring regions can share some.
+size_t Shared_Memory::get_resident_size(size_t offset, size_t size)
+{
+#ifdef LAZY_MEMORY_SUPPORTED
+    if (fd >= 0 || mapped)
+    {
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        size_t start = offset & ~(page_size - 1);
+        size_t count = (offset + size - start + page_size - 1) / page_size;
+        std::vector<unsigned char> pages(count);
+        if (mincore(mem + start, count * page_size, pages.data()) == 0)
+        {
+            size_t resident = 0;
+            for (size_t i = 0; i < count; i++)
+                resident += pages[i] & 0x1;
+            return std::min(resident * page_size, size);
+        }
+    }
+#endif
+    return size;
+}
+
+Fastmem::Fastmem()
+{
+    base = nullptr;
+    mapped_pages = new uint8_t[MEMMAP_PAGES / 8];
+    memset(mapped_pages, 0, MEMMAP_PAGES / 8);
+}
+
+Fastmem::~Fastmem()
+{
+    release();
+    delete[] mapped_pages;
+}
+
+//Returns false if the host can't spare the address space, leaving fastmem off
+bool Fastmem::reserve()
+{
+#ifdef FASTMEM_SUPPORTED
+    if (base)
+        return true;
+    base = reserve_aligned(FASTMEM_SIZE);
+    return base != nullptr;
+#else
+    return false;
+#endif
+}
+
+void Fastmem::release()
+{
+#ifdef FASTMEM_SUPPORTED
+    if (base)
+        munmap(base, FASTMEM_SIZE);
+#endif
+    base = nullptr;
+    memset(mapped_pages, 0, MEMMAP_PAGES / 8);
+}
+
+//Makes the whole bus inaccessible again
+void Fastmem::clear()
+{
+#ifdef FASTMEM_SUPPORTED
+    if (!base)
+        return;
+    mmap(base, FASTMEM_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    memset(mapped_pages, 0, MEMMAP_PAGES / 8);
+#endif
+}
+
+//Same arguments as Memory_Map::map, with ptr pointing into mem. Replaces whatever was mapped there before.
+void Fastmem::map(uint32_t start, uint32_t size, Shared_Memory& mem, uint8_t* ptr, uint32_t mem_size, bool writable)
+{
+#ifdef FASTMEM_SUPPORTED
+    if (!base || !mem.is_shareable())
+        return;
+
+    off_t offset = ptr - mem.get_ptr();
+    int prot = writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    for (uint32_t mirror = 0; mirror < size; mirror += mem_size)
+    {
+        void* view = mmap(base + start + mirror, mem_size, prot, MAP_SHARED | MAP_FIXED, mem.get_fd(), offset);
+        if (view == MAP_FAILED)
+            EmuException::die("[Fastmem] Failed to map $%08X", start + mirror);
+        if (mem.uses_huge_pages())
+            madvise(view, mem_size, MADV_HUGEPAGE);
+    }
+
+    uint32_t first = start >> MEMMAP_PAGE_SHIFT;
+    for (uint32_t page = first; page < first + (size >> MEMMAP_PAGE_SHIFT); page++)
+        mapped_pages[page >> 3] |= 1 << (page & 0x7);
+#else
+    (void)start;
+    (void)size;
+    (void)mem;
+    (void)ptr;
+    (void)mem_size;
+    (void)writable;
+#endif
+}
+
+//Whether any page of [start, start + size) is mapped
+bool Fastmem::is_mapped(uint32_t start, uint32_t size)
+{
+    if (!size)
+        return false;
+    uint32_t last = (start + size - 1) >> MEMMAP_PAGE_SHIFT;
+    for (uint32_t page = start >> MEMMAP_PAGE_SHIFT; page <= last; page++)
+    {
+        if (mapped_pages[page >> 3] & (1 << (page & 0x7)))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,124 @@
+#ifndef FASTMEM_HPP
+#define FASTMEM_HPP
+#include <cstddef>
+#include <cstdint>
+#include "memmap.hpp"
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(_M_X64))
+#define FASTMEM_SUPPORTED
+#endif
+
+//Hosts that only back memory with pages once it's touched, handing them out zeroed
+#if defined(__linux__)
+#define LAZY_MEMORY_SUPPORTED
+#endif
+
+//Mappings are aligned to the host's transparent huge pages, so they can be backed by them
+#define HUGE_PAGE_SIZE (1024 * 1024 * 2)
+
+//Guest memory the host can map more than once, so the buses' fastmem views see the same bytes as everything
+//else. Falls back to a private allocation, with fastmem unavailable, where the host can't share memory, and can
+//be made private when fastmem is off. Either way it starts out zeroed and, where the host allows, costs nothing
+//until touched.
+class Shared_Memory
+{
+    private:
+        uint8_t* mem;
+        size_t size;
+        int fd;
+
+        //Set when mem is a private anonymous mapping rather than a plain allocation
+        bool mapped;
+
+        //What was asked for, and whether the host actually backs the memory with huge pages because of it
+        bool huge_pages;
+        bool huge_pages_backed;
+
+        //One byte per 4 KB page, set once the page is written. Bytes rather than bits, so both cores' threads
+        //can mark pages without racing on a shared byte.
+        uint8_t* dirty_pages;
+        size_t page_count;
+
+        void copy_resident(uint8_t* dest);
+        void apply_huge_pages();
+    public:
+        Shared_Memory(size_t size);
+        ~Shared_Memory();
+
+        uint8_t* get_ptr();
+        bool is_shareable();
+        int get_fd();
+        bool set_shareable(bool shareable);
+
+        void set_huge_pages(bool enabled);
+        bool uses_huge_pages();
+
+        void discard(size_t offset, size_t size);
+        size_t get_resident_size(size_t offset, size_t size);
+
+        void mark_dirty(uint8_t* ptr);
+        void mark_dirty(uint8_t* ptr, size_t size);
+        void take_dirty_pages(uint8_t* bitmap);
+};
+
+//A 4 GB host reservation mirroring one bus, so generated code can reach guest memory at base + addr without
+//range checks. Everything left unmapped is inaccessible, and faults on it go to the recompiler's slow path.
+class Fastmem
+{
+    private:
+        uint8_t* base;
+
+        //One bit per page, set where guest memory is mapped
+        uint8_t* mapped_pages;
+    public:
+        Fastmem();
+        ~Fastmem();
+
+        bool reserve();
+        void release();
+        void clear();
+        void map(uint32_t start, uint32_t size, Shared_Memory& mem, uint8_t* ptr, uint32_t mem_size, bool writable);
+
+        uint8_t* get_base();
+        bool is_mapped(uint32_t start, uint32_t size);
+        bool contains(void* host_addr);
+};
+
+inline uint8_t* Shared_Memory::get_ptr()
+{
+    return mem;
+}
+
+inline bool Shared_Memory::is_shareable()
+{
+    return fd >= 0;
+}
+
+inline int Shared_Memory::get_fd()
+{
+    return fd;
+}
+
+inline bool Shared_Memory::uses_huge_pages()
+{
+    return huge_pages_backed;
+}
+
+//ptr must point into the memory
+inline void Shared_Memory::mark_dirty(uint8_t* ptr)
+{
+    dirty_pages[(ptr - mem) >> MEMMAP_PAGE_SHIFT] = 1;
+}
+
+//Null unless reserved
+inline uint8_t* Fastmem::get_base()
+{
+    return base;
+}
+
+inline bool Fastmem::contains(void* host_addr)
+{
+    return base && (uint8_t*)host_addr >= base && (uint8_t*)host_addr < base + (1ULL << 32);
+}
+
+#endif // FASTMEM_HPP
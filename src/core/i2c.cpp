@@ -3,6 +3,7 @@
 #include <ctime>
 #include "common/common.hpp"
 #include "i2c.hpp"
+#include "mmio.hpp"
 
 #define itob(i) ((i)/10*16 + (i)%10)    /* u_char to BCD */
 
@@ -17,6 +18,33 @@ void I2C::reset()
     memset(devices, 0, sizeof(devices));
 }
 
+//The three buses are shared by both CPUs. Only byte accesses are implemented.
+void I2C::register_mmio(MMIO_Bus& arm9_bus, MMIO_Bus& arm11_bus)
+{
+    const uint32_t bus_addrs[] = {0x10161000, 0x10144000, 0x10148000};
+    MMIO_Bus* buses[] = {&arm9_bus, &arm11_bus};
+    for (int i = 0; i < 2; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            buses[i]->on_read<uint8_t>(bus_addrs[j], 0x1000, [this](uint32_t addr) { return read8(addr); });
+            buses[i]->on_read<uint16_t>(bus_addrs[j], 0x1000, [this](uint32_t addr)
+            {
+                printf("[I2C%d] Unrecognized read16 $%08X\n", get_id(addr), addr);
+                return 0;
+            });
+            buses[i]->on_write<uint8_t>(bus_addrs[j], 0x1000, [this](uint32_t addr, uint32_t value)
+            {
+                write8(addr, value);
+            });
+            buses[i]->on_write<uint16_t>(bus_addrs[j], 0x1000, [this](uint32_t addr, uint32_t value)
+            {
+                printf("[I2C%d] Unrecognized write16 $%08X: $%04X\n", get_id(addr), addr, value);
+            });
+        }
+    }
+}
+
 uint8_t I2C::read8(uint32_t addr)
 {
     int id = get_id(addr);
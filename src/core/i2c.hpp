@@ -19,6 +19,7 @@ struct I2C_Device
 };
 
 class Emulator;
+class MMIO_Bus;
 
 class I2C
 {
@@ -43,6 +44,7 @@ class I2C
         I2C();
 
         void reset();
+        void register_mmio(MMIO_Bus& arm9_bus, MMIO_Bus& arm11_bus);
         void update_time();
 
         uint8_t read8(uint32_t addr);
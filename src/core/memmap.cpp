@@ -0,0 +1,66 @@
+#include <cstring>
+#include "memmap.hpp"
+
+Memory_Map::Memory_Map()
+{
+    read_pages = new uint8_t*[MEMMAP_PAGES];
+    write_pages = new uint8_t*[MEMMAP_PAGES];
+    clear();
+}
+
+Memory_Map::~Memory_Map()
+{
+    delete[] read_pages;
+    delete[] write_pages;
+}
+
+void Memory_Map::clear()
+{
+    for (int i = 0; i < MEMMAP_PAGES; i++)
+    {
+        read_pages[i] = nullptr;
+        write_pages[i] = nullptr;
+    }
+}
+
+//Maps [start, start + size) to mem, mirroring it every mem_size bytes. Both sizes must be multiples of a page.
+//Read-only mappings leave writes to the device handlers, which is also what a previous writable mapping gets.
+void Memory_Map::map(uint32_t start, uint32_t size, uint8_t* mem, uint32_t mem_size, bool writable)
+{
+    uint32_t first = start >> MEMMAP_PAGE_SHIFT;
+    uint32_t count = size >> MEMMAP_PAGE_SHIFT;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint8_t* page = mem + ((i << MEMMAP_PAGE_SHIFT) % mem_size);
+        read_pages[first + i] = page;
+        write_pages[first + i] = writable ? page : nullptr;
+    }
+}
+
+void Memory_Map::copy(const Memory_Map& other)
+{
+    memcpy(read_pages, other.read_pages, MEMMAP_PAGES * sizeof(uint8_t*));
+    memcpy(write_pages, other.write_pages, MEMMAP_PAGES * sizeof(uint8_t*));
+}
+
+//Takes over other's mapping of [start, start + size), which must be a multiple of a page
+void Memory_Map::copy(const Memory_Map& other, uint32_t start, uint32_t size)
+{
+    uint32_t first = start >> MEMMAP_PAGE_SHIFT;
+    uint32_t count = size >> MEMMAP_PAGE_SHIFT;
+    memcpy(read_pages + first, other.read_pages + first, count * sizeof(uint8_t*));
+    memcpy(write_pages + first, other.write_pages + first, count * sizeof(uint8_t*));
+}
+
+//Drops write access to [start, start + size), and read access too unless readable, so those accesses miss
+void Memory_Map::protect(uint32_t start, uint32_t size, bool readable)
+{
+    uint32_t first = start >> MEMMAP_PAGE_SHIFT;
+    uint32_t count = size >> MEMMAP_PAGE_SHIFT;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!readable)
+            read_pages[first + i] = nullptr;
+        write_pages[first + i] = nullptr;
+    }
+}
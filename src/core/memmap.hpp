@@ -0,0 +1,58 @@
+#ifndef MEMMAP_HPP
+#define MEMMAP_HPP
+#include <cstdint>
+
+#define MEMMAP_PAGE_SHIFT 12
+#define MEMMAP_PAGE_SIZE (1 << MEMMAP_PAGE_SHIFT)
+#define MEMMAP_PAGE_MASK (MEMMAP_PAGE_SIZE - 1)
+#define MEMMAP_PAGES (1 << (32 - MEMMAP_PAGE_SHIFT))
+
+//Host memory behind every 4 KB page of one bus, so RAM and ROM accesses skip address decoding.
+//Pages without a pointer are I/O or unmapped, and go through the bus's device handlers instead.
+class Memory_Map
+{
+    private:
+        uint8_t** read_pages;
+        uint8_t** write_pages;
+    public:
+        Memory_Map();
+        ~Memory_Map();
+
+        void clear();
+        void map(uint32_t start, uint32_t size, uint8_t* mem, uint32_t mem_size, bool writable);
+        void copy(const Memory_Map& other);
+        void copy(const Memory_Map& other, uint32_t start, uint32_t size);
+        void protect(uint32_t start, uint32_t size, bool readable);
+
+        uint8_t* get_read_page(uint32_t addr);
+        uint8_t* get_write_page(uint32_t addr);
+        uint8_t* get_block(uint32_t addr, uint32_t size, bool write);
+};
+
+inline uint8_t* Memory_Map::get_read_page(uint32_t addr)
+{
+    return read_pages[addr >> MEMMAP_PAGE_SHIFT];
+}
+
+inline uint8_t* Memory_Map::get_write_page(uint32_t addr)
+{
+    return write_pages[addr >> MEMMAP_PAGE_SHIFT];
+}
+
+//Host memory backing [addr, addr + size), or nullptr if it isn't contiguous there. size may not exceed a page.
+inline uint8_t* Memory_Map::get_block(uint32_t addr, uint32_t size, bool write)
+{
+    uint8_t** pages = write ? write_pages : read_pages;
+    uint32_t end = addr + size - 1;
+    if (end < addr)
+        return nullptr;
+
+    uint8_t* start_page = pages[addr >> MEMMAP_PAGE_SHIFT];
+    if (!start_page)
+        return nullptr;
+    if ((addr ^ end) >> MEMMAP_PAGE_SHIFT && pages[end >> MEMMAP_PAGE_SHIFT] != start_page + MEMMAP_PAGE_SIZE)
+        return nullptr;
+    return start_page + (addr & MEMMAP_PAGE_MASK);
+}
+
+#endif // MEMMAP_HPP
@@ -0,0 +1,84 @@
+#include <cstring>
+#include "mmio.hpp"
+
+static uint8_t unhandled_table[MEMMAP_PAGE_SIZE];
+
+MMIO_Page::MMIO_Page()
+{
+    //Handler 0 is reserved for "unhandled"
+    reads.push_back(nullptr);
+    writes.push_back(nullptr);
+
+    for (int i = 0; i < 5; i++)
+    {
+        read_index[i] = unhandled_table;
+        write_index[i] = unhandled_table;
+    }
+}
+
+MMIO_Page::~MMIO_Page()
+{
+    for (int i = 0; i < 5; i++)
+    {
+        if (read_index[i] != unhandled_table)
+            delete[] read_index[i];
+        if (write_index[i] != unhandled_table)
+            delete[] write_index[i];
+    }
+}
+
+//The index table of one width, allocated the first time a handler is added at that width
+uint8_t* MMIO_Page::get_table(int width, bool write)
+{
+    uint8_t*& table = write ? write_index[width] : read_index[width];
+    if (table == unhandled_table)
+    {
+        table = new uint8_t[MEMMAP_PAGE_SIZE / width];
+        memset(table, 0, MEMMAP_PAGE_SIZE / width);
+    }
+    return table;
+}
+
+MMIO_Bus::MMIO_Bus(const char* name) : name(name)
+{
+    page_index = new uint16_t[MEMMAP_PAGES];
+    memset(page_index, 0, MEMMAP_PAGES * sizeof(uint16_t));
+}
+
+MMIO_Bus::~MMIO_Bus()
+{
+    clear();
+    delete[] page_index;
+}
+
+void MMIO_Bus::clear()
+{
+    for (unsigned int i = 0; i < pages.size(); i++)
+        delete pages[i];
+    pages.clear();
+    memset(page_index, 0, MEMMAP_PAGES * sizeof(uint16_t));
+}
+
+MMIO_Page* MMIO_Bus::get_page(uint32_t addr)
+{
+    uint16_t& index = page_index[addr >> MEMMAP_PAGE_SHIFT];
+    if (!index)
+    {
+        pages.push_back(new MMIO_Page());
+        index = pages.size();
+    }
+    return pages[index - 1];
+}
+
+//Points every width-sized unit of [start, start + size), which lies within one page, at the given handler
+void MMIO_Bus::add(uint32_t start, uint32_t size, int width, bool write, int handler_index)
+{
+    if (handler_index > 0xFF)
+        EmuException::die("[%s] Too many handlers in page $%08X\n", name, start & ~MEMMAP_PAGE_MASK);
+    if ((start | size) & (width - 1))
+        EmuException::die("[%s] Misaligned %d-bit registers at $%08X\n", name, width * 8, start);
+
+    uint8_t* table = get_page(start)->get_table(width, write);
+    uint32_t offset = (start & MEMMAP_PAGE_MASK) / width;
+    memset(table + offset, handler_index, size / width);
+}
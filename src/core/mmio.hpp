@@ -0,0 +1,114 @@
+#ifndef MMIO_HPP
+#define MMIO_HPP
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "common/exceptions.hpp"
+#include "memmap.hpp"
+
+//Narrower reads are truncated, and narrower writes are zero-extended
+typedef std::function<uint32_t(uint32_t addr)> MMIO_Read;
+typedef std::function<void(uint32_t addr, uint32_t value)> MMIO_Write;
+
+//Handlers of one I/O page. The index tables have an entry per aligned unit of their width, numbering the
+//handler in reads/writes, with 0 meaning nothing is there. A page holds at most 255 handlers each way.
+//Tables for widths nothing was registered at share one all-zero table.
+struct MMIO_Page
+{
+    std::vector<MMIO_Read> reads;
+    std::vector<MMIO_Write> writes;
+
+    //By access size in bytes
+    uint8_t* read_index[5];
+    uint8_t* write_index[5];
+
+    MMIO_Page();
+    ~MMIO_Page();
+
+    uint8_t* get_table(int width, bool write);
+};
+
+//Device registers of one bus. Devices register the ranges and widths they handle, which are compiled into a flat
+//table per page, so dispatch costs the same however many devices there are. Later registrations take precedence.
+class MMIO_Bus
+{
+    private:
+        const char* name;
+
+        //Per guest page, one more than the index in pages, or 0 if no device is there
+        uint16_t* page_index;
+        std::vector<MMIO_Page*> pages;
+
+        MMIO_Page* get_page(uint32_t addr);
+        void add(uint32_t start, uint32_t size, int width, bool write, int handler_index);
+    public:
+        MMIO_Bus(const char* name);
+        ~MMIO_Bus();
+
+        void clear();
+
+        template <typename T> void on_read(uint32_t start, uint32_t size, MMIO_Read func);
+        template <typename T> void on_write(uint32_t start, uint32_t size, MMIO_Write func);
+
+        template <typename T> T read(uint32_t addr);
+        template <typename T> void write(uint32_t addr, T value);
+};
+
+template <typename T>
+void MMIO_Bus::on_read(uint32_t start, uint32_t size, MMIO_Read func)
+{
+    for (uint32_t addr = start; addr < start + size; addr = (addr & ~MEMMAP_PAGE_MASK) + MEMMAP_PAGE_SIZE)
+    {
+        MMIO_Page* page = get_page(addr);
+        page->reads.push_back(func);
+        uint32_t end = std::min(start + size, (addr & ~MEMMAP_PAGE_MASK) + MEMMAP_PAGE_SIZE);
+        add(addr, end - addr, sizeof(T), false, page->reads.size() - 1);
+    }
+}
+
+template <typename T>
+void MMIO_Bus::on_write(uint32_t start, uint32_t size, MMIO_Write func)
+{
+    for (uint32_t addr = start; addr < start + size; addr = (addr & ~MEMMAP_PAGE_MASK) + MEMMAP_PAGE_SIZE)
+    {
+        MMIO_Page* page = get_page(addr);
+        page->writes.push_back(func);
+        uint32_t end = std::min(start + size, (addr & ~MEMMAP_PAGE_MASK) + MEMMAP_PAGE_SIZE);
+        add(addr, end - addr, sizeof(T), true, page->writes.size() - 1);
+    }
+}
+
+template <typename T>
+inline T MMIO_Bus::read(uint32_t addr)
+{
+    uint16_t index = page_index[addr >> MEMMAP_PAGE_SHIFT];
+    if (index)
+    {
+        MMIO_Page* page = pages[index - 1];
+        uint8_t handler = page->read_index[sizeof(T)][(addr & MEMMAP_PAGE_MASK) / sizeof(T)];
+        if (handler)
+            return page->reads[handler](addr);
+    }
+    EmuException::die("[%s] Invalid read%d $%08X\n", name, (int)sizeof(T) * 8, addr);
+    return 0;
+}
+
+template <typename T>
+inline void MMIO_Bus::write(uint32_t addr, T value)
+{
+    uint16_t index = page_index[addr >> MEMMAP_PAGE_SHIFT];
+    if (index)
+    {
+        MMIO_Page* page = pages[index - 1];
+        uint8_t handler = page->write_index[sizeof(T)][(addr & MEMMAP_PAGE_MASK) / sizeof(T)];
+        if (handler)
+        {
+            page->writes[handler](addr, value);
+            return;
+        }
+    }
+    EmuException::die("[%s] Invalid write%d $%08X: $%0*X\n", name, (int)sizeof(T) * 8, addr, (int)sizeof(T) * 2, value);
+}
+
+#endif // MMIO_HPP
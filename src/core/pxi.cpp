@@ -2,6 +2,7 @@
 #include <cstring>
 #include "arm11/mpcore_pmr.hpp"
 #include "arm9/interrupt9.hpp"
+#include "mmio.hpp"
 #include "pxi.hpp"
 
 PXI::PXI(MPCore_PMR* mpcore, Interrupt9* int9) : mpcore(mpcore), int9(int9)
@@ -23,6 +24,36 @@ void PXI::reset()
         recv11.pop();
 }
 
+//Byte writes to SYNC go through a read-modify-write of the whole register
+void PXI::register_mmio(MMIO_Bus& arm9_bus, MMIO_Bus& arm11_bus)
+{
+    arm9_bus.on_read<uint8_t>(0x10008000, 4, [this](uint32_t addr) { return read_sync9() >> ((addr & 0x3) * 8); });
+    arm9_bus.on_read<uint16_t>(0x10008004, 2, [this](uint32_t) { return read_cnt9(); });
+    arm9_bus.on_read<uint32_t>(0x10008000, 4, [this](uint32_t) { return read_sync9(); });
+    arm9_bus.on_read<uint32_t>(0x1000800C, 4, [this](uint32_t) { return read_msg9(); });
+    arm9_bus.on_write<uint8_t>(0x10008000, 4, [this](uint32_t addr, uint32_t value)
+    {
+        int shift = (addr & 0x3) * 8;
+        write_sync9((read_sync9() & ~(0xFF << shift)) | (value << shift));
+    });
+    arm9_bus.on_write<uint16_t>(0x10008004, 2, [this](uint32_t, uint32_t value) { write_cnt9(value); });
+    arm9_bus.on_write<uint32_t>(0x10008000, 4, [this](uint32_t, uint32_t value) { write_sync9(value); });
+    arm9_bus.on_write<uint32_t>(0x10008008, 4, [this](uint32_t, uint32_t value) { send_to_11(value); });
+
+    arm11_bus.on_read<uint8_t>(0x10163000, 4, [this](uint32_t addr) { return read_sync11() >> ((addr & 0x3) * 8); });
+    arm11_bus.on_read<uint16_t>(0x10163004, 2, [this](uint32_t) { return read_cnt11(); });
+    arm11_bus.on_read<uint32_t>(0x10163000, 4, [this](uint32_t) { return read_sync11(); });
+    arm11_bus.on_read<uint32_t>(0x1016300C, 4, [this](uint32_t) { return read_msg11(); });
+    arm11_bus.on_write<uint8_t>(0x10163000, 4, [this](uint32_t addr, uint32_t value)
+    {
+        int shift = (addr & 0x3) * 8;
+        write_sync11((read_sync11() & ~(0xFF << shift)) | (value << shift));
+    });
+    arm11_bus.on_write<uint16_t>(0x10163004, 2, [this](uint32_t, uint32_t value) { write_cnt11(value); });
+    arm11_bus.on_write<uint32_t>(0x10163000, 4, [this](uint32_t, uint32_t value) { write_sync11(value); });
+    arm11_bus.on_write<uint32_t>(0x10163008, 4, [this](uint32_t, uint32_t value) { send_to_9(value); });
+}
+
 uint32_t PXI::read_sync9()
 {
     uint32_t reg = sync9.recv_data;
@@ -19,6 +19,7 @@ struct PXI_CNT
 
 class MPCore_PMR;
 class Interrupt9;
+class MMIO_Bus;
 
 class PXI
 {
@@ -36,6 +37,7 @@ class PXI
         PXI(MPCore_PMR* mpcore, Interrupt9* int9);
 
         void reset();
+        void register_mmio(MMIO_Bus& arm9_bus, MMIO_Bus& arm11_bus);
 
         uint32_t read_sync9();
         uint32_t read_sync11();
@@ -1,5 +1,6 @@
 #include <cstdio>
 #include "arm9/interrupt9.hpp"
+#include "mmio.hpp"
 #include "timers.hpp"
 
 Timers::Timers(Interrupt9* int9) : int9(int9)
@@ -17,26 +18,48 @@ void Timers::reset()
     }
 }
 
-void Timers::run()
+void Timers::register_mmio(MMIO_Bus& bus)
+{
+    bus.on_read<uint16_t>(0x10003000, 0x1000, [this](uint32_t addr) { return arm9_read16(addr); });
+    bus.on_write<uint16_t>(0x10003000, 0x1000, [this](uint32_t addr, uint32_t value) { arm9_write16(addr, value); });
+}
+
+void Timers::run(int cycles)
 {
     for (int i = 0; i < 4; i++)
     {
         if (arm9_timers[i].enabled && !arm9_timers[i].countup)
         {
-            arm9_timers[i].clocks++;
-            if (arm9_timers[i].clocks >= arm9_timers[i].prescalar)
+            uint32_t period = arm9_timers[i].prescalar * TIMER_CLOCK_DIVIDER;
+            arm9_timers[i].clocks += cycles;
+            if (arm9_timers[i].clocks >= period)
             {
-                arm9_timers[i].counter++;
-                arm9_timers[i].clocks -= arm9_timers[i].prescalar;
-                if (arm9_timers[i].counter >= 0x10000)
-                {
+                arm9_timers[i].counter += arm9_timers[i].clocks / period;
+                arm9_timers[i].clocks %= period;
+                while (arm9_timers[i].counter >= 0x10000)
                     handle_overflow(i);
-                }
             }
         }
     }
 }
 
+//In ARM9 cycles. Count-up timers only move when the timer before them overflows, so only prescaled timers are checked
+int Timers::cycles_until_overflow()
+{
+    int64_t cycles = 0x7FFFFFFF;
+    for (int i = 0; i < 4; i++)
+    {
+        if (arm9_timers[i].enabled && !arm9_timers[i].countup)
+        {
+            int64_t left = (int64_t)(0x10000 - arm9_timers[i].counter) * arm9_timers[i].prescalar * TIMER_CLOCK_DIVIDER;
+            left -= arm9_timers[i].clocks;
+            if (left < cycles)
+                cycles = left;
+        }
+    }
+    return (int)cycles;
+}
+
 void Timers::handle_overflow(int index)
 {
     arm9_timers[index].counter -= 0x10000;
@@ -2,6 +2,9 @@
 #define TIMERS_HPP
 #include <cstdint>
 
+//The timers count at the system bus clock, half the ARM9's
+#define TIMER_CLOCK_DIVIDER 2
+
 struct Timer9
 {
     uint32_t counter;
@@ -13,6 +16,7 @@ struct Timer9
 };
 
 class Interrupt9;
+class MMIO_Bus;
 
 class Timers
 {
@@ -29,7 +33,9 @@ class Timers
         Timers(Interrupt9* int9);
 
         void reset();
-        void run();
+        void register_mmio(MMIO_Bus& bus);
+        void run(int cycles);
+        int cycles_until_overflow();
 
         uint16_t arm9_read16(uint32_t addr);
         void arm9_write16(uint32_t addr, uint16_t value);
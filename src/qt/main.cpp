@@ -1,3 +1,5 @@
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <QApplication>
 #include "../core/emulator.hpp"
@@ -10,7 +12,7 @@ int main(int argc, char** argv)
 {
     if (argc < 7)
     {
-        printf("Args: [boot9] [boot11] [OTP] [NAND] [NAND CID] [SD]\n");
+        printf("Args: [boot9] [boot11] [OTP] [NAND] [NAND CID] [SD] [--interpreter] [--no-fastmem] [--threaded] [--quantum=cycles] [--trace9=addr] [--trace11=addr]\n");
         return 1;
     }
 
@@ -53,6 +55,22 @@ int main(int argc, char** argv)
     EmuWindow* emuwindow = new EmuWindow();
 
     Emulator e;
+    for (int i = 7; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--interpreter"))
+            e.set_jit_enabled(false);
+        else if (!strcmp(argv[i], "--no-fastmem"))
+            e.set_fastmem_enabled(false);
+        else if (!strcmp(argv[i], "--threaded"))
+            e.set_threaded(true);
+        else if (!strncmp(argv[i], "--quantum=", 10))
+            e.set_sync_quantum(atoi(argv[i] + 10));
+        else if (!strncmp(argv[i], "--trace9=", 9))
+            e.add_trace_trigger(9, strtoul(argv[i] + 9, nullptr, 16));
+        else if (!strncmp(argv[i], "--trace11=", 10))
+            e.add_trace_trigger(11, strtoul(argv[i] + 10, nullptr, 16));
+    }
+
     if (!e.mount_nand(argv[4]))
     {
         printf("Failed to open %s\n", argv[4]);